@@ -0,0 +1,167 @@
+//
+// Created by Nikita Matrosov on 04/01/2026.
+//
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include "Arena.h"
+
+// ==================================================================================
+//                                Allocation Counting
+// ==================================================================================
+// The replaceable global operator new, counting before it calls malloc. A relaxed
+// increment is all it adds, and it covers every container and string in the shell.
+
+namespace {
+
+std::atomic<unsigned long> g_heapAllocations(0);
+
+void *countedAlloc(std::size_t size) {
+    g_heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    return malloc(size ? size : 1);
+}
+
+}
+
+unsigned long heapAllocations() {
+    return g_heapAllocations.load(std::memory_order_relaxed);
+}
+
+void *operator new(std::size_t size) {
+    void *p = countedAlloc(size);
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](std::size_t size) {
+    void *p = countedAlloc(size);
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept { return countedAlloc(size); }
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept { return countedAlloc(size); }
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { free(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { free(p); }
+
+// ==================================================================================
+//                                Class: Arena
+// ==================================================================================
+
+namespace {
+
+// BLOCK_SIZE blocks given back by finished arenas
+void *g_freeBlocks = nullptr;
+
+}
+
+Arena::~Arena() {
+    while (m_blocks != nullptr) {
+        Block *next = m_blocks->next;
+        if (m_blocks->size == BLOCK_SIZE - sizeof(Block)) {
+            *reinterpret_cast<void**>(m_blocks) = g_freeBlocks;
+            g_freeBlocks = m_blocks;
+        } else {
+            ::operator delete(m_blocks);
+        }
+        m_blocks = next;
+    }
+}
+
+void *Arena::allocate(std::size_t size, std::size_t align) {
+    uintptr_t at = (reinterpret_cast<uintptr_t>(m_cur) + align - 1) & ~(uintptr_t) (align - 1);
+    if (at + size > reinterpret_cast<uintptr_t>(m_end)) {
+        // A new block; a request too big for a standard one gets a block of its own
+        std::size_t need = size + align + sizeof(Block);
+        Block *block;
+        if (need <= BLOCK_SIZE && g_freeBlocks != nullptr) {
+            block = static_cast<Block*>(g_freeBlocks);
+            g_freeBlocks = *static_cast<void**>(g_freeBlocks);
+        } else {
+            block = static_cast<Block*>(::operator new((need <= BLOCK_SIZE) ? BLOCK_SIZE : need));
+        }
+        block->size = (need <= BLOCK_SIZE) ? BLOCK_SIZE - sizeof(Block) : need - sizeof(Block);
+        block->next = m_blocks;
+        m_blocks = block;
+        m_cur = reinterpret_cast<char*>(block + 1);
+        m_end = m_cur + block->size;
+        at = (reinterpret_cast<uintptr_t>(m_cur) + align - 1) & ~(uintptr_t) (align - 1);
+    }
+    m_cur = reinterpret_cast<char*>(at + size);
+    return reinterpret_cast<void*>(at);
+}
+
+char *Arena::copy(const char *text, std::size_t len) {
+    char *out = static_cast<char*>(allocate(len + 1, 1));
+    memcpy(out, text, len);
+    out[len] = '\0';
+    return out;
+}
+
+// ==================================================================================
+//                                Class: SlabPool
+// ==================================================================================
+
+SlabPool::SlabPool(std::size_t objectSize, std::size_t perSlab)
+        : m_objectSize(objectSize < sizeof(void*) ? sizeof(void*) : objectSize),
+          m_perSlab(perSlab), m_free(nullptr) {
+    std::size_t align = alignof(std::max_align_t);
+    m_objectSize = (m_objectSize + align - 1) / align * align;
+}
+
+void *SlabPool::allocate() {
+    if (m_free == nullptr) {
+        char *slab = static_cast<char*>(::operator new(m_objectSize * m_perSlab));
+        for (std::size_t i = m_perSlab; i-- > 0;) release(slab + i * m_objectSize);
+    }
+    void *object = m_free;
+    m_free = *static_cast<void**>(object);
+    return object;
+}
+
+void SlabPool::release(void *object) {
+    *static_cast<void**>(object) = m_free;
+    m_free = object;
+}
+
+// ------------------------------ size classes ------------------------------------
+
+namespace {
+
+const std::size_t CLASS_STEP = 64;
+const std::size_t MAX_POOLED = 1024;
+
+SlabPool &sizeClass(std::size_t size) {
+    // Built on first use: Commands are created from static initializers as well
+    static SlabPool *pools[MAX_POOLED / CLASS_STEP];
+    std::size_t index = (size - 1) / CLASS_STEP;
+    if (pools[index] == nullptr) pools[index] = new SlabPool((index + 1) * CLASS_STEP, 16);
+    return *pools[index];
+}
+
+}
+
+void *poolAllocate(std::size_t size) {
+    if (size == 0 || size > MAX_POOLED) return ::operator new(size);
+    return sizeClass(size).allocate();
+}
+
+void poolRelease(void *object, std::size_t size) {
+    if (object == nullptr) return;
+    if (size == 0 || size > MAX_POOLED) ::operator delete(object);
+    else sizeClass(size).release(object);
+}
+
+// ==================================================================================
+//                                Class: ArgRef
+// ==================================================================================
+
+std::ostream &operator<<(std::ostream &os, const ArgRef &arg) {
+    return os << arg.c_str(); // keeps setw() and friends working, unlike write()
+}
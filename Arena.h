@@ -0,0 +1,156 @@
+#ifndef SMASH_ARENA_H_
+#define SMASH_ARENA_H_
+
+#include <cstddef>
+#include <cstring>
+#include <iosfwd>
+#include <string>
+
+// ==================================================================================
+//                                Class: Arena
+// ==================================================================================
+// Bump allocator for the parse-time data of one command: the copy of its line and
+// its argument words. It starts in a buffer supplied by the owner, inside the
+// Command object itself. A longer line continues in 4 KiB blocks. Those come
+// from a shared free list and go back to it with the arena, so after the first
+// few commands parsing does not reach malloc at all. Nothing is freed on its own;
+// everything goes when the arena does.
+class Arena {
+public:
+    static const std::size_t BLOCK_SIZE = 4096;
+
+private:
+    struct Block {
+        Block *next;
+        std::size_t size;       // usable bytes after the header
+    };
+
+    char *m_cur;
+    char *m_end;
+    Block *m_blocks;            // taken from the heap, newest first
+
+public:
+    Arena(char *buffer, std::size_t size) : m_cur(buffer), m_end(buffer + size), m_blocks(nullptr) {}
+    ~Arena();
+
+    Arena(Arena const &) = delete;
+    void operator=(Arena const &) = delete;
+
+    void *allocate(std::size_t size, std::size_t align = alignof(std::max_align_t));
+
+    // NUL-terminated copy of [text, text + len)
+    char *copy(const char *text, std::size_t len);
+};
+
+// ==================================================================================
+//                                Class: SlabPool
+// ==================================================================================
+// Fixed-size objects carved out of slabs of 'perSlab' at a time. Released objects
+// go on a free list and are handed out again; slabs are never returned. Used for
+// JobEntry, and (one pool per 64-byte size class, see poolAllocate) for Command.
+class SlabPool {
+private:
+    std::size_t m_objectSize;
+    std::size_t m_perSlab;
+    void *m_free;               // singly linked through the objects themselves
+
+public:
+    SlabPool(std::size_t objectSize, std::size_t perSlab);
+
+    SlabPool(SlabPool const &) = delete;
+    void operator=(SlabPool const &) = delete;
+
+    void *allocate();
+    void release(void *object);
+};
+
+// Size-class pools behind Command::operator new/delete; sizes over 1 KiB use the heap
+void *poolAllocate(std::size_t size);
+void poolRelease(void *object, std::size_t size);
+
+// Heap allocations (operator new, any thread) since startup. 'time -v' shows the
+// shell's own share, which is 0 for a builtin once the pools are warm
+unsigned long heapAllocations();
+
+// ==================================================================================
+//                                Class: ArgRef
+// ==================================================================================
+// One word of a parsed command line, pointing into its command's arena (a
+// string_view for C++11). It is NUL-terminated, compares with strings and
+// literals, and converts to std::string only where a caller needs a copy.
+class ArgRef {
+private:
+    const char *m_data;
+    std::size_t m_size;
+
+public:
+    ArgRef() : m_data(""), m_size(0) {}
+    ArgRef(const char *data, std::size_t size) : m_data(data), m_size(size) {}
+
+    const char *c_str() const { return m_data; }
+    const char *data() const { return m_data; }
+    std::size_t size() const { return m_size; }
+    std::size_t length() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    char operator[](std::size_t i) const { return m_data[i]; }
+    const char *begin() const { return m_data; }
+    const char *end() const { return m_data + m_size; }
+
+    std::string str() const { return std::string(m_data, m_size); }
+    operator std::string() const { return str(); }
+
+    std::string substr(std::size_t pos, std::size_t len = std::string::npos) const {
+        return std::string(m_data + pos, (len > m_size - pos) ? m_size - pos : len);
+    }
+    std::size_t find(char c, std::size_t pos = 0) const {
+        const void *hit = (pos < m_size) ? memchr(m_data + pos, c, m_size - pos) : nullptr;
+        return hit ? static_cast<const char*>(hit) - m_data : std::string::npos;
+    }
+    // Same as std::string::compare(pos, len, text) == 0 for the common prefix test
+    bool startsWith(const char *prefix) const {
+        std::size_t n = strlen(prefix);
+        return n <= m_size && memcmp(m_data, prefix, n) == 0;
+    }
+
+    bool operator==(const char *text) const { return strlen(text) == m_size && memcmp(m_data, text, m_size) == 0; }
+    bool operator!=(const char *text) const { return !(*this == text); }
+    bool operator==(const std::string &text) const {
+        return text.size() == m_size && memcmp(m_data, text.data(), m_size) == 0;
+    }
+    bool operator!=(const std::string &text) const { return !(*this == text); }
+    bool operator==(const ArgRef &other) const {
+        return other.m_size == m_size && memcmp(m_data, other.m_data, m_size) == 0;
+    }
+    bool operator!=(const ArgRef &other) const { return !(*this == other); }
+};
+
+inline bool operator==(const char *text, const ArgRef &arg) { return arg == text; }
+inline bool operator!=(const char *text, const ArgRef &arg) { return arg != text; }
+inline bool operator==(const std::string &text, const ArgRef &arg) { return arg == text; }
+inline bool operator!=(const std::string &text, const ArgRef &arg) { return arg != text; }
+
+std::ostream &operator<<(std::ostream &os, const ArgRef &arg);
+
+// ==================================================================================
+//                                Class: ArgList
+// ==================================================================================
+// The words of a command, in its arena. Indexable and iterable like the
+// vector<string> it replaces.
+class ArgList {
+private:
+    const ArgRef *m_args;
+    std::size_t m_size;
+
+public:
+    ArgList() : m_args(nullptr), m_size(0) {}
+    ArgList(const ArgRef *args, std::size_t size) : m_args(args), m_size(size) {}
+
+    std::size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    const ArgRef &operator[](std::size_t i) const { return m_args[i]; }
+    const ArgRef &back() const { return m_args[m_size - 1]; }
+    const ArgRef *begin() const { return m_args; }
+    const ArgRef *end() const { return m_args + m_size; }
+};
+
+#endif //SMASH_ARENA_H_
@@ -0,0 +1,366 @@
+//
+// Created by Nikita Matrosov on 20/12/2025.
+//
+
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include "Arithmetic.h"
+#include "SmallShell.h"
+
+// ==================================================================================
+//                                Class: Evaluator
+// ==================================================================================
+
+namespace {
+
+// Nested evaluations of variable values ("a=b", "b=a+1") stop here
+const int MAX_VALUE_DEPTH = 32;
+
+/**
+ * Recursive descent over the expression text, one method per precedence level.
+ * The first error is kept in m_error; everything after it only unwinds.
+ */
+class Evaluator {
+private:
+    const std::string &m_expr;
+    std::size_t m_pos;
+    int m_depth;
+    int m_skip;             // > 0 inside a branch that is not taken: no assignments
+    std::string m_error;
+
+    void skipBlanks() {
+        while (m_pos < m_expr.size() && isspace((unsigned char) m_expr[m_pos])) ++m_pos;
+    }
+
+    /**
+     * Consumes 'op' if it comes next and is not the start of a longer operator
+     * (one of the characters in 'notFollowedBy').
+     */
+    bool match(const char *op, const char *notFollowedBy = "") {
+        skipBlanks();
+        std::size_t len = strlen(op);
+        if (m_expr.compare(m_pos, len, op) != 0) return false;
+        if (m_pos + len < m_expr.size() && *notFollowedBy != '\0' &&
+            strchr(notFollowedBy, m_expr[m_pos + len]) != nullptr) {
+            return false;
+        }
+        m_pos += len;
+        return true;
+    }
+
+    bool failed() const { return !m_error.empty(); }
+
+    long long fail(const std::string &reason) {
+        if (m_error.empty()) m_error = reason;
+        return 0;
+    }
+
+    std::string readName() {
+        skipBlanks();
+        std::size_t start = m_pos;
+        if (m_pos < m_expr.size() && (isalpha((unsigned char) m_expr[m_pos]) || m_expr[m_pos] == '_')) {
+            while (m_pos < m_expr.size() && (isalnum((unsigned char) m_expr[m_pos]) || m_expr[m_pos] == '_')) ++m_pos;
+        }
+        return m_expr.substr(start, m_pos - start);
+    }
+
+    long long valueOf(const std::string &name) {
+        const std::string *value = SmallShell::getInstance().lookupVariable(name);
+        if (value == nullptr || value->empty()) return 0;
+
+        // The common case, a plain number, without a nested evaluation
+        char *end = nullptr;
+        errno = 0;
+        long long number = strtoll(value->c_str(), &end, 0);
+        if (errno == 0 && *end == '\0') return number;
+
+        if (m_depth >= MAX_VALUE_DEPTH) return fail(name + ": expression recursion level exceeded");
+        Evaluator nested(*value, m_depth + 1);
+        if (!nested.evaluate(number)) return fail(nested.m_error);
+        return number;
+    }
+
+    void assign(const std::string &name, long long value) {
+        if (m_skip > 0) return;
+        SmallShell::getInstance().assignVariable(name, std::to_string(value));
+    }
+
+    static long long wrapAdd(long long a, long long b) {
+        return (long long) ((unsigned long long) a + (unsigned long long) b);
+    }
+    static long long wrapSub(long long a, long long b) {
+        return (long long) ((unsigned long long) a - (unsigned long long) b);
+    }
+    static long long wrapMul(long long a, long long b) {
+        return (long long) ((unsigned long long) a * (unsigned long long) b);
+    }
+
+    /**
+     * Applies the binary operator 'op' ("+", "<<", ...) - shared by the
+     * precedence levels and the compound assignments.
+     */
+    long long apply(const std::string &op, long long a, long long b) {
+        if (op == "+") return wrapAdd(a, b);
+        if (op == "-") return wrapSub(a, b);
+        if (op == "*") return wrapMul(a, b);
+        if (op == "/" || op == "%") {
+            if (b == 0) return (m_skip > 0) ? 0 : fail("division by 0");
+            if (a == LLONG_MIN && b == -1) return (op == "/") ? LLONG_MIN : 0;
+            return (op == "/") ? a / b : a % b;
+        }
+        if (op == "<<") return (long long) ((unsigned long long) a << (b & 63));
+        if (op == ">>") return a >> (b & 63);
+        if (op == "&") return a & b;
+        if (op == "^") return a ^ b;
+        if (op == "|") return a | b;
+        return fail("unknown operator " + op);
+    }
+
+    // ------------------------------ Precedence Levels -----------------------------
+
+    long long comma() {
+        long long value = assignment();
+        while (!failed() && match(",")) value = assignment();
+        return value;
+    }
+
+    long long assignment() {
+        skipBlanks();
+        std::size_t start = m_pos;
+        std::string name = readName();
+        if (!name.empty()) {
+            static const char *const OPS[] = {"<<=", ">>=", "+=", "-=", "*=", "/=", "%=", "&=", "^=", "|=", nullptr};
+            for (int i = 0; OPS[i] != nullptr; ++i) {
+                if (match(OPS[i])) {
+                    long long rhs = assignment();
+                    std::string op(OPS[i], strlen(OPS[i]) - 1);
+                    long long value = apply(op, valueOf(name), rhs);
+                    if (!failed()) assign(name, value);
+                    return value;
+                }
+            }
+            if (match("=", "=")) {
+                long long value = assignment();
+                if (!failed()) assign(name, value);
+                return value;
+            }
+        }
+        m_pos = start;
+        return conditional();
+    }
+
+    long long conditional() {
+        long long cond = logicalOr();
+        if (failed() || !match("?")) return cond;
+
+        if (!cond) ++m_skip;
+        long long whenTrue = comma();
+        if (!cond) --m_skip;
+        if (!match(":")) return fail("expected ':' in conditional expression");
+
+        if (cond) ++m_skip;
+        long long whenFalse = conditional();
+        if (cond) --m_skip;
+        return cond ? whenTrue : whenFalse;
+    }
+
+    long long logicalOr() {
+        long long value = logicalAnd();
+        while (!failed() && match("||")) {
+            if (value) ++m_skip;
+            long long rhs = logicalAnd();
+            if (value) --m_skip;
+            value = (value || rhs) ? 1 : 0;
+        }
+        return value;
+    }
+
+    long long logicalAnd() {
+        long long value = bitOr();
+        while (!failed() && match("&&")) {
+            if (!value) ++m_skip;
+            long long rhs = bitOr();
+            if (!value) --m_skip;
+            value = (value && rhs) ? 1 : 0;
+        }
+        return value;
+    }
+
+    long long bitOr() {
+        long long value = bitXor();
+        while (!failed() && match("|", "|=")) value = apply("|", value, bitXor());
+        return value;
+    }
+
+    long long bitXor() {
+        long long value = bitAnd();
+        while (!failed() && match("^", "=")) value = apply("^", value, bitAnd());
+        return value;
+    }
+
+    long long bitAnd() {
+        long long value = equality();
+        while (!failed() && match("&", "&=")) value = apply("&", value, equality());
+        return value;
+    }
+
+    long long equality() {
+        long long value = relational();
+        while (!failed()) {
+            if (match("==")) value = (value == relational());
+            else if (match("!=")) value = (value != relational());
+            else break;
+        }
+        return value;
+    }
+
+    long long relational() {
+        long long value = shift();
+        while (!failed()) {
+            if (match("<=")) value = (value <= shift());
+            else if (match(">=")) value = (value >= shift());
+            else if (match("<", "<")) value = (value < shift());
+            else if (match(">", ">")) value = (value > shift());
+            else break;
+        }
+        return value;
+    }
+
+    long long shift() {
+        long long value = additive();
+        while (!failed()) {
+            if (match("<<", "=")) value = apply("<<", value, additive());
+            else if (match(">>", "=")) value = apply(">>", value, additive());
+            else break;
+        }
+        return value;
+    }
+
+    long long additive() {
+        long long value = multiplicative();
+        while (!failed()) {
+            if (match("+", "+=")) value = apply("+", value, multiplicative());
+            else if (match("-", "-=")) value = apply("-", value, multiplicative());
+            else break;
+        }
+        return value;
+    }
+
+    long long multiplicative() {
+        long long value = power();
+        while (!failed()) {
+            if (match("*", "*=")) value = apply("*", value, power());
+            else if (match("/", "=")) value = apply("/", value, power());
+            else if (match("%", "=")) value = apply("%", value, power());
+            else break;
+        }
+        return value;
+    }
+
+    long long power() {
+        long long base = unary();
+        if (failed() || !match("**")) return base;
+
+        long long exponent = power(); // right-associative
+        if (exponent < 0) return fail("exponent less than 0");
+        long long result = 1;
+        while (exponent > 0) {
+            if (exponent & 1) result = wrapMul(result, base);
+            base = wrapMul(base, base);
+            exponent >>= 1;
+        }
+        return result;
+    }
+
+    long long unary() {
+        if (match("++") || match("--")) {
+            bool increment = (m_expr[m_pos - 1] == '+');
+            std::string name = readName();
+            if (name.empty()) return fail("attempted assignment to non-variable");
+            long long value = wrapAdd(valueOf(name), increment ? 1 : -1);
+            assign(name, value);
+            return value;
+        }
+        if (match("!", "=")) return !unary();
+        if (match("~")) return ~unary();
+        if (match("-")) return wrapSub(0, unary());
+        if (match("+")) return unary();
+        return postfix();
+    }
+
+    long long postfix() {
+        skipBlanks();
+        std::size_t start = m_pos;
+        std::string name = readName();
+        if (name.empty()) {
+            m_pos = start;
+            return primary();
+        }
+
+        long long value = valueOf(name);
+        if (match("++")) assign(name, wrapAdd(value, 1));
+        else if (match("--")) assign(name, wrapSub(value, 1));
+        return value;
+    }
+
+    long long primary() {
+        if (failed()) return 0;
+        if (match("(")) {
+            long long value = comma();
+            if (!failed() && !match(")")) return fail("missing ')'");
+            return value;
+        }
+
+        skipBlanks();
+        if (m_pos >= m_expr.size()) return fail("operand expected");
+        if (!isdigit((unsigned char) m_expr[m_pos])) {
+            return fail(std::string("syntax error: operand expected (error token is \"") +
+                        m_expr.substr(m_pos) + "\")");
+        }
+
+        // 0x1f, 017 and 42 - as in C
+        const char *begin = m_expr.c_str() + m_pos;
+        char *end = nullptr;
+        errno = 0;
+        long long value = strtoll(begin, &end, 0);
+        if (errno == ERANGE) value = (long long) strtoull(begin, &end, 0);
+        if (end != nullptr && (isalnum((unsigned char) *end) || *end == '_')) {
+            return fail(std::string("value too great for base (error token is \"") + begin + "\")");
+        }
+        m_pos += end - begin;
+        return value;
+    }
+
+public:
+    Evaluator(const std::string &expr, int depth) : m_expr(expr), m_pos(0), m_depth(depth), m_skip(0) {}
+
+    bool evaluate(long long &result) {
+        skipBlanks();
+        result = (m_pos == m_expr.size()) ? 0 : comma(); // '$(( ))' is 0
+        skipBlanks();
+        if (!failed() && m_pos < m_expr.size()) {
+            fail(std::string("syntax error in expression (error token is \"") + m_expr.substr(m_pos) + "\")");
+        }
+        return !failed();
+    }
+
+    const std::string &error() const { return m_error; }
+};
+
+}
+
+// ==================================================================================
+//                                Arithmetic
+// ==================================================================================
+
+bool evaluateArithmetic(const std::string &expr, long long &result) {
+    Evaluator evaluator(expr, 0);
+    if (evaluator.evaluate(result)) return true;
+
+    std::cerr << "smash error: " << expr << ": " << evaluator.error() << std::endl;
+    return false;
+}
@@ -0,0 +1,27 @@
+#ifndef SMASH_ARITHMETIC_H_
+#define SMASH_ARITHMETIC_H_
+
+#include <string>
+
+// ==================================================================================
+//                                Arithmetic
+// ==================================================================================
+// Integer arithmetic for '$(( ))' and the '(( ))' command. The expression is
+// evaluated on 64-bit signed integers with C precedence and associativity:
+//
+//   ( )   ++ -- (pre/post)   + - ! ~ (unary)   **   * / %   + -   << >>
+//   < <= > >=   == !=   &   ^   |   &&   ||   ?:   = += -= *= /= %= <<= >>= &= ^= |=   ,
+//
+// Variables are named without '$'. An unset or empty variable is 0, and a value
+// that is not a number is evaluated as an expression itself. Assignments go
+// through SmallShell::assignVariable(). The branches skipped by &&, || and ?:
+// have no side effects. Overflow wraps around, as in bash.
+
+/**
+ * Evaluates 'expr' (parameter expansion already done) into 'result'. Prints
+ * "smash error: <expr>: <reason>" and returns false on a syntax error or
+ * division by zero.
+ */
+bool evaluateArithmetic(const std::string &expr, long long &result);
+
+#endif //SMASH_ARITHMETIC_H_
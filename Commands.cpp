@@ -5,12 +5,16 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
 #include <signal.h>
 #include <ftw.h>
+#include <dirent.h>
 #include <limits.h>
 #include <ctime>
 #include <algorithm>
 #include <cstdlib>
+#include <cctype>
 #include <pwd.h>
 #include <net/if.h>
 #include <sys/ioctl.h>
@@ -22,9 +26,22 @@
 #include <iomanip>
 #include <regex>
 #include <cstring>
+#include <cerrno>
+#include <cmath>
+#include <new>
 
 #include "Commands.h"
 #include "SmallShell.h"
+#include "Trace.h"
+#include "Metrics.h"
+#include "JobJournal.h"
+#include "Expansion.h"
+#include "Quoting.h"
+#include "Script.h"
+#include "Output.h"
+#include "Relay.h"
+#include "TextScan.h"
+#include "PerfCounters.h"
 
 using namespace std;
 
@@ -36,52 +53,7 @@ extern char** environ;
 // ==================================================================================
 
 const std::string WHITESPACE = " \n\r\t\f\v";
-
-#if 0
-#define FUNC_ENTRY()  \
-  cout << __PRETTY_FUNCTION__ << " --> " << endl;
-
-#define FUNC_EXIT()  \
-  cout << __PRETTY_FUNCTION__ << " <-- " << endl;
-#else
-#define FUNC_ENTRY()
-#define FUNC_EXIT()
-#endif
-
-static bool deleteEntry(const char* name) {
-    size_t len = strlen(name);
-    char** currentEnvVar = environ;
-    while (*currentEnvVar) {
-        if (strncmp(*currentEnvVar, name, len) == 0 && (*currentEnvVar)[len] == '=') {
-            char** remainingEnvVars = currentEnvVar;
-            while (*remainingEnvVars) {
-                *remainingEnvVars = *(remainingEnvVars + 1);
-                ++remainingEnvVars;
-            }
-            return true;
-        }
-        ++currentEnvVar;
-    }
-    return false;
-}
-
-static bool envExistsProcfs(const char* name) {
-    std::string env;
-    std::string path = "/proc/self/environ";
-    int fd = open(path.c_str(), O_RDONLY);
-    if (fd < 0) return false;
-    char buf[4096]; ssize_t n;
-    while ((n = read(fd, buf, sizeof(buf))) > 0) env.append(buf,n);
-    close(fd);
-    size_t len = strlen(name);
-    size_t pos = 0;
-    while (pos < env.size()) {
-        const char* p = env.c_str() + pos;
-        if (strncmp(p, name, len) == 0 && p[len] == '=') return true;
-        pos += strlen(p) + 1;
-    }
-    return false;
-}
+static const char *const WHITESPACE_CHARS = " \n\r\t\f\v";
 
 static bool isNumber(const std::string &s,int *num = nullptr) {
     if (s.empty()) {return false;}
@@ -97,6 +69,11 @@ static bool isNumber(const std::string &s,int *num = nullptr) {
     }
 }
 
+// A builtin that reports an error exits with status 1 ($?)
+static void builtinFailed() {
+    SmallShell::getInstance().setLastStatus(1);
+}
+
 // ------------------------ String Manipulation Helpers -------------------------
 
 string _ltrim(const std::string &s) {
@@ -115,85 +92,158 @@ string _trim(const std::string &s) {
 
 // ------------------------ Command Parsing Helpers -----------------------------
 
+void tokenizeCommandLine(const std::string &cmd_line, std::vector<std::string> &words,
+                         std::vector<WordSpan> *spans) {
+    bool inWord = false;
+    QuoteScan scan;
+    for (std::size_t i = 0; i < cmd_line.size(); ++i) {
+        char c = cmd_line[i];
+        QuoteScan::Kind kind = scan.at(cmd_line, i);
+        if (kind == QuoteScan::PLAIN && WHITESPACE.find(c) != std::string::npos) {
+            inWord = false;
+            continue;
+        }
+        if (!inWord) {
+            words.emplace_back();
+            if (spans != nullptr) spans->push_back(WordSpan{i, false});
+            inWord = true;
+        }
+        if (kind != QuoteScan::SYNTAX) words.back() += c;
+        else if (spans != nullptr) spans->back().quoted = true;
+    }
+}
+
+ArgList tokenizeCommandLine(Arena &arena, const char *cmd_line, std::size_t len) {
+    // The words never need more room than the line: each one ends where a blank (or
+    // the end of the line) was, and quotes only make it shorter
+    char *out = static_cast<char*>(arena.allocate(len + 1, 1));
+    char *end = out;
+    std::size_t count = 0;
+    bool inWord = false;
+    QuoteScan scan;
+    for (std::size_t i = 0; i < len; ++i) {
+        char c = cmd_line[i];
+        QuoteScan::Kind kind = scan.next(c, i + 1 < len ? cmd_line[i + 1] : '\0');
+        if (kind == QuoteScan::PLAIN && c != '\0' && strchr(WHITESPACE_CHARS, c) != nullptr) {
+            if (inWord) *end++ = '\0';
+            inWord = false;
+            continue;
+        }
+        if (!inWord) {
+            ++count;
+            inWord = true;
+        }
+        if (kind != QuoteScan::SYNTAX) *end++ = c;
+    }
+    if (inWord) *end = '\0';
+
+    ArgRef *args = static_cast<ArgRef*>(arena.allocate(sizeof(ArgRef) * (count ? count : 1), alignof(ArgRef)));
+    const char *word = out;
+    for (std::size_t i = 0; i < count; ++i) {
+        std::size_t n = strlen(word);
+        new (&args[i]) ArgRef(word, n);
+        word += n + 1;
+    }
+    return ArgList(args, count);
+}
+
 int _parseCommandLine(const char *cmd_line, char **args) {
     FUNC_ENTRY()
+    std::vector<std::string> words;
+    tokenizeCommandLine(string(cmd_line), words);
+
+    // callers pass COMMAND_MAX_ARGS slots - extra words are dropped
     int i = 0;
-    std::istringstream iss(_trim(string(cmd_line)).c_str());
-    for (std::string s; iss >> s;) {
-        args[i] = (char *) malloc(s.length() + 1);
-        memset(args[i], 0, s.length() + 1);
-        strcpy(args[i], s.c_str());
-        args[++i] = NULL;
+    for (; i < (int) words.size() && i < COMMAND_MAX_ARGS - 1; ++i) {
+        args[i] = strdup(words[i].c_str());
     }
-    return i;
+    args[i] = NULL;
     FUNC_EXIT()
+    return i;
 }
 
 std::vector<std::string> splitCommandLine(const std::string &cmd_line) {
-    std::istringstream iss(cmd_line);
     std::vector<std::string> args;
-    std::string word;
-    while (iss >> word) {
-        args.push_back(word);
-    }
+    tokenizeCommandLine(cmd_line, args);
     return args;
 }
 
+int _waitStatusToExitStatus(int status) {
+    if (WIFEXITED(status)) return WEXITSTATUS(status);
+    if (WIFSIGNALED(status)) return 128 + WTERMSIG(status);
+    if (WIFSTOPPED(status)) return 128 + WSTOPSIG(status);
+    return 0;
+}
+
+bool _isAssignmentWord(const char *word, std::size_t len) {
+    if (len == 0 || !(isalpha((unsigned char) word[0]) || word[0] == '_')) return false;
+    for (std::size_t i = 1; i < len; ++i) {
+        if (word[i] == '=') return true;
+        if (!(isalnum((unsigned char) word[i]) || word[i] == '_')) return false;
+    }
+    return false;
+}
+
+bool _isAssignmentWord(const std::string &word) {
+    return _isAssignmentWord(word.data(), word.size());
+}
+
+/**
+ * Index of the last non-blank character in 'text' before 'end', or -1.
+ */
+static long lastNonBlank(const char *text, std::size_t end) {
+    long i = (long) end - 1;
+    while (i >= 0 && strchr(WHITESPACE_CHARS, text[i]) != nullptr) --i;
+    return i;
+}
+
+/**
+ * True if cmd_line[idx] is an '&' that is neither quoted nor escaped.
+ */
+static bool isUnquotedAmpersand(const char *cmd_line, long idx) {
+    if (idx < 0 || cmd_line[idx] != '&') return false;
+    QuoteScan scan;
+    for (long i = 0; i < idx; ++i) scan.at(cmd_line, i);
+    return scan.at(cmd_line, idx) == QuoteScan::PLAIN;
+}
+
 bool _isBackgroundComamnd(const char *cmd_line) {
-    const string str(cmd_line);
-    if(str.empty()) return false;
-    return str[str.find_last_not_of(WHITESPACE)] == '&';
+    return isUnquotedAmpersand(cmd_line, lastNonBlank(cmd_line, strlen(cmd_line)));
 }
 
 void _removeBackgroundSign(char *cmd_line) {
-    const string str(cmd_line);
     // find last character other than spaces
-    size_t idx = str.find_last_not_of(WHITESPACE);
-    // if all characters are spaces then return
-    if (idx == string::npos) {
-        return;
-    }
-    // if the command line does not end with & then return
-    if (cmd_line[idx] != '&') {
+    long idx = lastNonBlank(cmd_line, strlen(cmd_line));
+    // if all characters are spaces, or the command line does not end with &, then return
+    if (!isUnquotedAmpersand(cmd_line, idx)) {
         return;
     }
-    // replace the & (background sign) with space and then remove all tailing spaces.
-    cmd_line[idx] = ' ';
-    // truncate the command line string up to the last non-space character
-    cmd_line[str.find_last_not_of(WHITESPACE, idx) + 1] = 0;
+    // drop the & (background sign) and the spaces before it
+    cmd_line[lastNonBlank(cmd_line, idx) + 1] = 0;
 }
 
 // ==================================================================================
 //                                Class: Command
 // ==================================================================================
 
-Command::Command(const char *cmd_line) {
+Command::Command(const char *cmd_line) : m_arena(m_inline, sizeof(m_inline)) {
     // 1. Check if command is background
     m_isBackground = _isBackgroundComamnd(cmd_line);
 
     // 2. Copy the raw command line
-    m_cmd_line = strdup(cmd_line);
+    m_cmd_line = m_arena.copy(cmd_line, strlen(cmd_line));
 
     // 3. Process background sign if needed
     if (m_isBackground){
         _removeBackgroundSign(m_cmd_line);
-        _trim(m_cmd_line);
     }
 
-    // 4. Parse arguments
-    char* temp_arg[COMMAND_MAX_LENGTH];
-    m_args_num = _parseCommandLine(m_cmd_line, temp_arg);
-
-    // 5. Store arguments in vector
-    for (int i = 0; i < m_args_num; i++) {
-        m_args.push_back(string(temp_arg[i]));
-        free(temp_arg[i]);
-    }
+    // 4. Parse arguments (quotes removed) into the arena
+    m_args = tokenizeCommandLine(m_arena, m_cmd_line, strlen(m_cmd_line));
+    m_args_num = m_args.size();
 }
 
-Command::~Command() {
-    free(m_cmd_line);
-}
+Command::~Command() {}
 
 // ==================================================================================
 //                           Class: BuiltInCommand
@@ -209,44 +259,155 @@ BuiltInCommand::BuiltInCommand(const char* cmd_line)
 ExternalCommand::ExternalCommand(const char* cmd_line)
         : Command(cmd_line){}
 
-void ExternalCommand::execute()
+/**
+ * execvp() against the shell's environment table. execvp()/execvpe() search the
+ * process's own getenv("PATH"), and 'environ' is never updated (see Environment.h),
+ * so an exported PATH would be ignored. Returns only on failure, with errno set
+ * the way execvp() would: EACCES if a match was found but could not run, else the
+ * last error (ENOENT when nothing matched).
+ */
+static void execFromTable(char *const argv[], char *const *envp, const std::string *path)
 {
-    SmallShell &smash = SmallShell::getInstance();
+    const char *name = argv[0];
+    std::vector<std::string> candidates;
+    if (strchr(name, '/') != nullptr) {
+        candidates.push_back(name);
+    } else {
+        // Unset PATH: the same default as execvp()
+        std::string dirs = (path != nullptr) ? *path : "/bin:/usr/bin";
+        std::size_t begin = 0;
+        while (true) {
+            std::size_t end = dirs.find(':', begin);
+            std::string dir = dirs.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+            candidates.push_back((dir.empty() ? std::string(".") : dir) + "/" + name);
+            if (end == std::string::npos) break;
+            begin = end + 1;
+        }
+    }
+
+    bool denied = false;
+    int lastErrno = ENOENT;
+    for (const std::string &file : candidates) {
+        execve(file.c_str(), argv, envp);
+        if (errno == ENOEXEC) {
+            // No #! line: a shell script, run by /bin/sh like execvp() does
+            std::vector<char*> shArgv;
+            shArgv.push_back(const_cast<char*>("sh"));
+            shArgv.push_back(const_cast<char*>(file.c_str()));
+            for (std::size_t i = 1; argv[i] != nullptr; ++i) shArgv.push_back(argv[i]);
+            shArgv.push_back(nullptr);
+            execve("/bin/sh", shArgv.data(), envp);
+            return;
+        }
+        if (errno == EACCES) denied = true;
+        else if (errno != ENOENT && errno != ENOTDIR) lastErrno = errno;
+    }
+    errno = denied ? EACCES : lastErrno;
+}
 
+void ExternalCommand::execInChild(int execErrorFd)
+{
+    SmallShell &smash = SmallShell::getInstance();
     std::string cmdTxt = std::string(getCmdLine());
 
     // Check for wildcards to determine if bash is needed
     bool complex = (cmdTxt.find('*') != std::string::npos ||
                     cmdTxt.find('?') != std::string::npos);
 
+    setpgrp(); // Create new process group
+
+    // Limits (and a cgroup of its own for a background job) before anything runs
+    if (!ResourceLimits::applyInChild(isBackground()) || !applyRedirections(m_redirections)) {
+        _exit(EXIT_FAILURE);
+    }
+
+    char *const *envp = smash.getEnvironment().envp();
+
+    if (complex) {
+        // Complex command: let /bin/bash handle it
+        TRACE_BEFORE_EXEC();
+        char *const bashArgv[] = {const_cast<char*>("bash"), const_cast<char*>("-c"),
+                                  const_cast<char*>(cmdTxt.c_str()), nullptr};
+        execve("/bin/bash", bashArgv, envp);
+    } else {
+        // Simple command: argv points straight into the parsed arguments.
+        // Leading NAME=value words only apply to this command's environment
+        // (the table is the child's own copy of the shell's).
+        const ArgList &args = getArgs();
+        std::size_t first = 0;
+        for (; first < args.size() && _isAssignmentWord(args[first].data(), args[first].size()); ++first) {
+            std::size_t eq = args[first].find('=');
+            smash.getEnvironment().set(args[first].substr(0, eq), args[first].substr(eq + 1));
+        }
+        if (first > 0) envp = smash.getEnvironment().envp();
+
+        std::vector<char*> argv;
+        for (std::size_t i = first; i < args.size(); ++i) {
+            argv.push_back(const_cast<char*>(args[i].c_str()));
+        }
+        argv.push_back(nullptr);
+        if (argv[0] == nullptr) _exit(0);
+
+        TRACE_BEFORE_EXEC();
+        execFromTable(argv.data(), envp, smash.getEnvironment().find("PATH"));
+    }
+
+    int execErrno = errno;
+    perror(complex ? "smash error: execve failed" : "smash error: execvp failed");
+    if (execErrorFd != -1 && write(execErrorFd, &execErrno, sizeof(execErrno)) == -1) {
+        // parent will see EOF and count a spawn instead - nothing else to do
+    }
+    // Ensure child exits if exec fails (126/127 like other shells, for $?)
+    _exit(execErrno == ENOENT ? 127 : 126);
+}
+
+void ExternalCommand::execute()
+{
+    SmallShell &smash = SmallShell::getInstance();
+
+    std::string cmdTxt = std::string(getCmdLine());
     bool bg = this->isBackground();
 
+    // With metrics on, a close-on-exec pipe tells the parent when the exec happened
+    // (EOF) or why it failed (errno) - this is what spawn latency is measured on
+    int execPipe[2] = {-1, -1};
+    bool measureSpawn = Metrics::isEnabled() && pipe2(execPipe, O_CLOEXEC) == 0;
+    double forkStart = measureSpawn ? monotonicSeconds() : 0.0;
+
+    // The cached envp is refreshed here, in the parent, only if the table changed
+    smash.getEnvironment().envp();
+
     // Fork Process
-    pid_t cpid = fork();
+    pid_t cpid = TRACE_FORK();
 
     if (cpid == -1) {
         perror("smash error: fork failed");
+        Metrics::countForkFailure();
+        smash.setLastStatus(1);
+        if (measureSpawn) {
+            close(execPipe[0]);
+            close(execPipe[1]);
+        }
         return;
     }
 
     // Child Process Logic
     if (cpid == 0) {
-        setpgrp(); // Create new process group
-
-        if (complex) {
-            // Complex command: let /bin/bash handle it
-            execl("/bin/bash", "bash", "-c", cmdTxt.c_str(), (char*)nullptr);
-            perror("smash error: execl failed");
-        } else {
-            // Simple command: parse and execute directly
-            char *argv[COMMAND_MAX_ARGS];
-            _parseCommandLine(cmdTxt.c_str(), argv);
-
-            execvp(argv[0], argv);
-            perror("smash error: execvp failed");
-        }
+        if (measureSpawn) close(execPipe[0]);
+        execInChild(execPipe[1]);
+    }
 
-        _exit(EXIT_FAILURE); // Ensure child exits if exec fails
+    if (measureSpawn) {
+        close(execPipe[1]);
+        int execErrno;
+        ssize_t n;
+        do {
+            n = read(execPipe[0], &execErrno, sizeof(execErrno));
+        } while (n == -1 && errno == EINTR);
+        close(execPipe[0]);
+
+        if (n == (ssize_t) sizeof(execErrno)) Metrics::countExecFailure();
+        else Metrics::observeSpawnLatency(monotonicSeconds() - forkStart);
     }
 
     // Parent Process Logic
@@ -259,13 +420,16 @@ void ExternalCommand::execute()
             printTxt = _trim(std::string(getCmdLine())) + " &";
 
         int jobId = smash.getNextFreeJobId();
+        JobJournal::jobStarted(cpid, jobId, printTxt);
+        smash.setLastBgPid(cpid);
 
         // Add to job list
         smash.addBGJob(cpid,
                        cmdTxt,
                        false,
                        jobId,
-                       printTxt);
+                       printTxt,
+                       smash.takeNextJobHelpers());
 
         smash.setJobIdUsed(jobId);
 
@@ -275,16 +439,19 @@ void ExternalCommand::execute()
         smash.setCJPid(cpid);
         smash.setCJobId(smash.getNextFreeJobId());
         smash.setCJCommandLine(cmdTxt);
+        JobJournal::jobStarted(cpid, smash.getCJobId(), cmdTxt);
 
         int status;
         // Wait for the child process
-        waitpid(cpid, &status, WUNTRACED);
+        smash.waitForChild(cpid, &status, WUNTRACED);
+        smash.setLastStatus(_waitStatusToExitStatus(status));
 
         if (WIFSTOPPED(status)) {
             // Process was stopped (Ctrl-Z)
             smash.setCJisStopped(true);
             smash.setCJinsertionTime(time(nullptr));
-            smash.addBGJob(cpid, cmdTxt, true, smash.getCJobId(), smash.getCJPrintCommandLine());
+            smash.addBGJob(cpid, cmdTxt, true, smash.getCJobId(), smash.getCJPrintCommandLine(),
+                           smash.takeNextJobHelpers());
         } else {
             // Process finished normally
             smash.updateSmashAfterCjFinished();
@@ -296,71 +463,44 @@ void ExternalCommand::execute()
 // ==================================================================================
 
 RedirectionCommand::RedirectionCommand(const char* cmd_line)
-        : Command(cmd_line){}
+        : Command(cmd_line), m_innerCmdLine(""), m_valid(false)
+{
+    m_valid = parseRedirections(std::string(getCmdLine()), m_innerCmdLine, m_ops);
+    m_innerCmdLine = _trim(m_innerCmdLine);
+}
 
 void RedirectionCommand::execute()
 {
-    std::string line = std::string(getCmdLine());
-    bool append = false;
-
-    // 1. Parse Redirection Type (Overwrite '>' or Append '>>')
-    std::size_t arrow = line.find(">>");
-    if (arrow != std::string::npos) {
-        append = true;
-    } else {
-        arrow = line.find('>');
-        if (arrow == std::string::npos) {
-            std::cerr << "smash error: redirection: invalid command" << std::endl;
-            return;
-        }
-    }
-
-    // Split Command: Left (Action) & Right (File)
-    std::string leftPart = _trim(line.substr(0, arrow));
-    std::string filePart = _trim(line.substr(arrow + (append ? 2 : 1)));
-
-    if (filePart.empty()) {
-        std::cerr << "smash error: redirection: missing output file" << std::endl;
-        return;
-    }
-
-    //  Open Output File
-    int flags = O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC);
-    // Mode 0666 allows read/write for owner/group/others (modified by umask)
-    int fd = open(filePart.c_str(), flags, 0666);
-    if (fd == -1) {
-        perror("smash error: open failed");
-        return;
-    }
-
-    //  Redirect stdout
-    int saved_stdout = dup(STDOUT_FILENO); // Backup original stdout
-
-
-    if (saved_stdout == -1) {
-        perror("smash error: dup failed");
-        close(fd);
+    if (!m_valid) {
+        builtinFailed();
         return;
     }
+    SmallShell &smash = SmallShell::getInstance();
 
-    if (dup2(fd, STDOUT_FILENO) == -1) {
-        perror("smash error: dup2 failed");
-        close(saved_stdout);
-        close(fd);
+    // A bare "> file" just creates/truncates the file
+    if (m_innerCmdLine.empty()) {
+        FdSaver saver(m_ops);
+        if (!saver.apply()) builtinFailed();
         return;
     }
 
-    // File descriptor is now duplicated to stdout, we can close the original file fd
-    close(fd);
-
-    // Execute the command (recursively)
-    SmallShell::getInstance().executeCommand(leftPart.c_str());
+    std::string inner = m_innerCmdLine + (isBackground() ? " &" : "");
+    Command *cmd = smash.CreateCommand(inner.c_str());
+    if (!cmd) return;
 
-    // Restore stdout
-    if (dup2(saved_stdout, STDOUT_FILENO) == -1) {
-        perror("smash error: dup2 failed");
+    ExternalCommand *external = dynamic_cast<ExternalCommand*>(cmd);
+    if (external != nullptr) {
+        // The child redirects itself - the shell's descriptors stay as they are
+        external->setRedirections(m_ops);
+        cmd->execute();
+    } else {
+        // In-process commands never become jobs, and only they pay for save/restore
+        smash.takeNextBGPrint();
+        FdSaver saver(m_ops);
+        if (saver.apply()) cmd->execute();
+        else builtinFailed();
     }
-    close(saved_stdout);
+    delete cmd;
 }
 
 // ==================================================================================
@@ -375,17 +515,23 @@ static pid_t launchProcessWithPipe(const std::string& cmd,
                                    bool connect_stdin,
                                    bool connect_stdout,
                                    int fds[2],
-                                   bool use_stderr)
+                                   bool use_stderr,
+                                   const std::vector<int> *closeInChild = nullptr,
+                                   Command *prepared = nullptr)
 {
-    pid_t cpid = fork();
+    pid_t cpid = TRACE_FORK();
     if (cpid == -1) {
         perror("smash error: fork failed");
+        Metrics::countForkFailure();
         return -1;
     }
 
     // --- Child Process ---
     if (cpid == 0) {
         setpgrp(); // Set process group
+        if (!ResourceLimits::applyInChild(false)) {
+            _exit(EXIT_FAILURE);
+        }
 
         // Connect Input (if needed)
         if (connect_stdin && dup2(read_end, STDIN_FILENO) == -1) {
@@ -403,16 +549,87 @@ static pid_t launchProcessWithPipe(const std::string& cmd,
         // Close raw pipe descriptors (child has its own copies now)
         close(fds[0]);
         close(fds[1]);
+        if (closeInChild != nullptr) {
+            for (int fd : *closeInChild) close(fd);
+        }
 
-        // Execute logic
-        SmallShell::getInstance().executeCommand(cmd.c_str());
-        exit(EXIT_SUCCESS);
+        // An external command the parent already parsed execs right here, without a
+        // second fork from this copy of the shell
+        ExternalCommand *external = dynamic_cast<ExternalCommand*>(prepared);
+        if (external != nullptr) external->execInChild();
+
+        // Execute logic - the stage's exit status is that of the command it ran
+        SmallShell &smash = SmallShell::getInstance();
+        smash.executeCommand(cmd.c_str());
+
+        // _exit: exit() would also settle the stdin FILE it shares with the shell,
+        // seeking a script the shell is still reading back to this child's position
+        std::cout.flush();
+        std::cerr.flush();
+        fflush(nullptr);
+        _exit(smash.getLastStatus());
     }
 
     // --- Parent Process returns child PID ---
     return cpid;
 }
 
+// --- Static Helpers for In-Process Stages ---
+
+/**
+ * Builds the Command for one pipeline stage the way executeCommand() would
+ * (alias, then expansion). nullptr for an empty stage or a failed expansion.
+ */
+static Command *createStageCommand(const std::string &stage)
+{
+    SmallShell &smash = SmallShell::getInstance();
+    std::string line = smash.reproduceWithAlias(_trim(stage).c_str());
+    if (!expandCommandLine(line)) {
+        smash.setLastStatus(1);
+        return nullptr;
+    }
+    smash.setLastStatus(0);
+    return smash.CreateCommand(line.c_str());
+}
+
+/**
+ * The text filters: in-process only as the right-most stage, reading the pipe.
+ * Anywhere else their output has to stream, so they get a child like any program.
+ */
+static bool readsPipelineInput(Command *cmd)
+{
+    return dynamic_cast<WcCommand*>(cmd) != nullptr ||
+           dynamic_cast<GrepCommand*>(cmd) != nullptr ||
+           dynamic_cast<HeadCommand*>(cmd) != nullptr ||
+           dynamic_cast<TailCommand*>(cmd) != nullptr;
+}
+
+/**
+ * Builtins that only print a little and change nothing in the shell. Inside a
+ * pipeline they run in the shell itself, their output collected whole; everything
+ * else keeps the forked copy, so e.g. 'cd /tmp | cat' still leaves the shell where
+ * it was.
+ */
+static bool runsAsPipelineStage(Command *cmd)
+{
+    if (dynamic_cast<AliasCommand*>(cmd) != nullptr ||
+        dynamic_cast<ExportCommand*>(cmd) != nullptr) {
+        return cmd->getArgsNum() == 1; // the listing forms only
+    }
+    return dynamic_cast<JobsCommand*>(cmd) != nullptr ||
+           dynamic_cast<JobLogCommand*>(cmd) != nullptr ||
+           dynamic_cast<ShowPidCommand*>(cmd) != nullptr ||
+           dynamic_cast<GetCurrDirCommand*>(cmd) != nullptr ||
+           dynamic_cast<EnvCommand*>(cmd) != nullptr ||
+           dynamic_cast<EchoCommand*>(cmd) != nullptr ||
+           dynamic_cast<PrintfCommand*>(cmd) != nullptr ||
+           dynamic_cast<TestCommand*>(cmd) != nullptr ||
+           dynamic_cast<StatusCommand*>(cmd) != nullptr ||
+           dynamic_cast<WhoAmICommand*>(cmd) != nullptr ||
+           dynamic_cast<DiskUsageCommand*>(cmd) != nullptr ||
+           dynamic_cast<NetInfo*>(cmd) != nullptr;
+}
+
 // --- PipeCommand Implementation ---
 
 PipeCommand::PipeCommand(const char* cmd_line)
@@ -435,6 +652,7 @@ void PipeCommand::execute()
 
     if (bar == std::string::npos) {
         std::cerr << "smash error: pipe: invalid syntax\n";
+        builtinFailed();
         return;
     }
 
@@ -446,422 +664,2924 @@ void PipeCommand::execute()
     if (_isBackgroundComamnd(left.c_str()))  _removeBackgroundSign(&left[0]);
     if (_isBackgroundComamnd(right.c_str())) _removeBackgroundSign(&right[0]);
 
-    // 3. Create Pipe
-    int fds[2];
-    if (pipe(fds) == -1) {
-        perror("smash error: pipe failed");
-        return;
-    }
+    SmallShell &smash = SmallShell::getInstance();
 
-    // Fork Children
+    // 3. Left Stage: a builtin prints into a buffer right here, which then becomes
+    // the right stage's input (pipe or memfd - it never waits for a reader).
+    // Anything else gets a child writing into a pipe.
+    int read_end = -1;
+    pid_t left_pid = -1;
+    Command *leftCmd = createStageCommand(left);
+
+    if (leftCmd == nullptr || runsAsPipelineStage(leftCmd)) {
+        std::ostringstream captured;
+        std::ostream &stream = use_stderr ? std::cerr : std::cout;
+        stream.flush();
+        std::streambuf *previous = stream.rdbuf(captured.rdbuf());
+        if (leftCmd != nullptr) leftCmd->execute();
+        stream.rdbuf(previous);
+        delete leftCmd;
+
+        read_end = makePayloadFd(captured.str());
+        if (read_end == -1) {
+            builtinFailed();
+            return;
+        }
+    } else {
+        int fds[2];
+        if (pipe(fds) == -1) {
+            perror("smash error: pipe failed");
+            delete leftCmd;
+            builtinFailed();
+            return;
+        }
 
-    // Left Child: Writes to pipe (fds[1])
-    // connect_stdin=false, connect_stdout=true
-    pid_t left_pid = launchProcessWithPipe(left, -1, fds[1], false, true, fds, use_stderr);
+        // Left Child: Writes to pipe (fds[1])
+        // connect_stdin=false, connect_stdout=true
+        left_pid = launchProcessWithPipe(left, -1, fds[1], false, true, fds, use_stderr, nullptr, leftCmd);
+        delete leftCmd;
 
-    if (left_pid == -1) {
-        close(fds[0]);
+        // Only the child writes - the right stage gets EOF once it is done
         close(fds[1]);
-        return;
+        if (left_pid == -1) {
+            close(fds[0]);
+            builtinFailed();
+            return;
+        }
+        read_end = fds[0];
     }
 
-    // Right Child: Reads from pipe (fds[0])
-    // connect_stdin=true, connect_stdout=false
-    pid_t right_pid = launchProcessWithPipe(right, fds[0], -1, true, false, fds, use_stderr);
-
-    if (right_pid == -1) {
-        close(fds[0]);
-        close(fds[1]);
-        return;
+    // 4. Right Stage: its exit status is the pipeline's
+    Command *rightCmd = createStageCommand(right);
+    pid_t right_pid = -1;
+
+    if (rightCmd == nullptr || runsAsPipelineStage(rightCmd)) {
+        // None of these builtins read their input - it only stays open while they
+        // run, as it would in a child
+        if (rightCmd != nullptr) rightCmd->execute();
+    } else if (dynamic_cast<PipeCommand*>(rightCmd) != nullptr || readsPipelineInput(rightCmd)) {
+        // 'a | b | c': the rest of the pipeline runs here as well, reading the pipe.
+        // So does a text filter ('... | wc -l')
+        FdOp input;
+        input.kind = FdOp::DUP;
+        input.targetFd = STDIN_FILENO;
+        input.sourceFd = read_end;
+        input.flags = 0;
+        std::vector<FdOp> ops(1, input);
+
+        FdSaver saver(ops);
+        if (saver.apply()) rightCmd->execute();
+        else builtinFailed();
+    } else {
+        // Right Child: Reads from the pipe
+        // connect_stdin=true, connect_stdout=false
+        int fds[2] = {read_end, -1};
+        right_pid = launchProcessWithPipe(right, read_end, -1, true, false, fds, use_stderr, nullptr, rightCmd);
+        if (right_pid == -1) builtinFailed();
     }
+    delete rightCmd;
 
     // 5. Parent Cleanup & Wait
-    // Close pipe ends in parent so children get EOF/SIGPIPE correctly
-    close(fds[0]);
-    close(fds[1]);
-
-    waitpid(left_pid, nullptr, 0);
-    waitpid(right_pid, nullptr, 0);
+    // Close the read end so a left child still writing gets SIGPIPE correctly
+    close(read_end);
+
+    if (left_pid != -1) smash.waitForChild(left_pid, nullptr, 0);
+    if (right_pid != -1) {
+        int status = 0;
+        smash.waitForChild(right_pid, &status, 0);
+        smash.setLastStatus(_waitStatusToExitStatus(status));
+    }
 }
 
 // ==================================================================================
-//                            Job Control Commands
+//                           Class: FanOutCommand
 // ==================================================================================
 
-void JobsCommand::execute() {
-    SmallShell &smash = SmallShell::getInstance();
-    smash.printJobsList();
+FanOutCommand::FanOutCommand(const char* cmd_line)
+        : Command(cmd_line)
+{
 }
 
-void ForegroundCommand::execute() {
-    SmallShell &smash = SmallShell::getInstance();
+void FanOutCommand::execute()
+{
+    std::string text = _trim(std::string(getCmdLine()));
+    if (_isBackgroundComamnd(text.c_str())) {
+        _removeBackgroundSign(&text[0]);
+        text = _trim(text.c_str());
+    }
 
-    //  Validate Arguments
-    if (this->getArgsNum() > 2) {
-        cerr << "smash error: fg: invalid arguments" << endl;
+    // 1. Parse: producer '|>' then '(cmd)' groups, then at most one '> file' / '>> file'
+    std::size_t op = std::string::npos;
+    QuoteScan scan;
+    for (std::size_t i = 0; i + 1 < text.size() && op == std::string::npos; ++i) {
+        if (scan.at(text, i) == QuoteScan::PLAIN && text[i] == '|' && text[i + 1] == '>')  op = i;
+    }
+    if (op == std::string::npos) {
+        std::cerr << "smash error: |>: invalid syntax" << std::endl;
+        builtinFailed();
         return;
     }
-
-    int jobId = -1;
-
-    //  Determine Job ID to bring to foreground
-    if (this->getArgsNum() == 2) {
-        // Case: Specific Job ID requested
-        string arg = this->getArg(1);
-        if (!isNumber(arg, &jobId)) {
-            cerr << "smash error: fg: invalid arguments" << endl;
+    std::string producer = _trim(text.substr(0, op));
+
+    std::vector<std::string> consumers;
+    std::size_t pos = text.find_first_not_of(WHITESPACE, op + 2);
+    while (pos != std::string::npos && text[pos] == '(') {
+        std::size_t closing = findClosingParen(text, pos);
+        if (closing == std::string::npos) {
+            std::cerr << "smash error: |>: missing ')'" << std::endl;
+            builtinFailed();
             return;
         }
-        if (!smash.isBGNotEmpty()){
-            cerr << "smash error: fg: job-id " << jobId << " does not exist" << endl;
+        consumers.push_back(_trim(text.substr(pos + 1, closing - pos - 1)));
+        pos = text.find_first_not_of(WHITESPACE, closing + 1);
+    }
+
+    std::vector<FdOp> ops;
+    bool valid = !producer.empty() && !consumers.empty();
+    if (pos != std::string::npos) {
+        std::string rest;
+        if (!parseRedirections(text.substr(pos), rest, ops)) {
+            builtinFailed();
             return;
         }
-        if (!smash.isContainsBGJob(jobId)) {
-            cerr << "smash error: fg: job-id " << jobId << " does not exist" << endl;
+        valid = valid && _trim(rest).empty() && ops.size() == 1 &&
+                ops[0].kind == FdOp::OPEN && ops[0].targetFd == STDOUT_FILENO;
+    }
+    for (const auto &consumer : consumers) valid = valid && !consumer.empty();
+    if (!valid) {
+        std::cerr << "smash error: |>: invalid syntax" << std::endl;
+        builtinFailed();
+        return;
+    }
+
+    // 2. The file sink, opened here so a bad path fails before anything runs.
+    // splice() refuses O_APPEND files, so '>>' opens plainly and starts at the end
+    int sink = -1;
+    if (!ops.empty()) {
+        sink = open(ops[0].path.c_str(), (ops[0].flags & ~O_APPEND) | O_CLOEXEC, 0666);
+        if (sink == -1) {
+            perror("smash error: open failed");
+            builtinFailed();
             return;
         }
+        if (ops[0].flags & O_APPEND) lseek(sink, 0, SEEK_END);
+    }
 
-    } else {
-        // Case: No argument provided -> take the last job (maximal ID)
-        if (smash.isBGNotEmpty()){
-            jobId = smash.getLastJobJId();
-        } else {
-            cerr << "smash error: fg: jobs list is empty"<< endl;
-            return;
+    // 3. Pipes: one the producer writes, one per consumer. Every child closes all of
+    // them but its own, so each reader sees EOF as soon as its writer is done
+    std::vector<int> all;
+    int input[2];
+    std::vector<int> outs;
+    std::vector<int> readEnds;
+    bool failed = (pipe(input) == -1);
+    if (!failed) {
+        all.push_back(input[0]);
+        all.push_back(input[1]);
+    }
+    for (std::size_t i = 0; i < consumers.size() && !failed; ++i) {
+        int fds[2];
+        if (pipe(fds) == -1) {
+            failed = true;
+            break;
         }
+        all.push_back(fds[0]);
+        all.push_back(fds[1]);
+        readEnds.push_back(fds[0]);
+        outs.push_back(fds[1]);
+    }
+    if (sink != -1) {
+        all.push_back(sink);
+        outs.push_back(sink); // a file may only be the relay's last output
+    }
+    if (failed) {
+        perror("smash error: pipe failed");
+        for (int fd : all) close(fd);
+        builtinFailed();
+        return;
     }
 
-    // Bring Job to Foreground
-    smash.setBGJobToFGbyJID(jobId);
+    SmallShell &smash = SmallShell::getInstance();
+    std::vector<pid_t> pids;
+
+    // 4. Producer and consumers - the same stages a pipeline would start
+    Command *producerCmd = createStageCommand(producer);
+    pid_t producerPid = launchProcessWithPipe(producer, -1, input[1], false, true, input, false, &all, producerCmd);
+    delete producerCmd;
+    if (producerPid != -1) pids.push_back(producerPid);
+    else failed = true;
+
+    pid_t lastPid = -1;
+    for (std::size_t i = 0; i < consumers.size() && !failed; ++i) {
+        int fds[2] = {readEnds[i], outs[i]};
+        Command *consumerCmd = createStageCommand(consumers[i]);
+        lastPid = launchProcessWithPipe(consumers[i], readEnds[i], -1, true, false, fds, false, &all, consumerCmd);
+        delete consumerCmd;
+        if (lastPid != -1) pids.push_back(lastPid);
+        else failed = true;
+    }
 
-    // Continue process if it was stopped
-    if (smash.isCJisStopped()) {
-        kill(smash.getCJPid(), SIGCONT);
+    // 5. Relay child: producer's pipe -> every consumer (and the file)
+    if (!failed) {
+        pid_t relayPid = TRACE_FORK();
+        if (relayPid == -1) {
+            perror("smash error: fork failed");
+            Metrics::countForkFailure();
+            failed = true;
+        } else if (relayPid == 0) {
+            setpgrp();
+            signal(SIGPIPE, SIG_IGN); // a consumer that exits early is dropped, not fatal
+            close(input[1]);
+            for (int fd : readEnds) close(fd);
+            Relay::fanOut(input[0], outs);
+            _exit(0);
+        } else {
+            pids.push_back(relayPid);
+        }
     }
 
-    // Print command line and PID
-    cout << smash.getCJPrintCommandLine() << " " << smash.getCJPid() << endl;
+    // 6. Parent Cleanup & Wait
+    for (int fd : all) close(fd);
+    int status = 0;
+    for (pid_t pid : pids) {
+        if (pid == lastPid) smash.waitForChild(pid, &status, 0);
+        else smash.waitForChild(pid, nullptr, 0);
+    }
+    if (failed) builtinFailed();
+    else smash.setLastStatus(_waitStatusToExitStatus(status));
+}
 
-    // Remove from background list (since it's now FG)
-    smash.removeBGjobByJID(jobId);
+// ==================================================================================
+//                           Class: ProcessSubstitutions
+// ==================================================================================
 
-    //  Wait for the process to finish or stop
-    int status;
-    pid_t finishedPid = waitpid(smash.getCJPid(), &status, WUNTRACED);
+// Descriptors handed out as /dev/fd/N stay clear of the ones users redirect
+#define SUBSTITUTION_FD_BASE (10)
 
-    if (finishedPid == -1) {
-        perror("smash error: waitpid failed");
-        smash.updateSmashAfterCjFinished();
-        return;
-    }
+bool ProcessSubstitutions::resolve(std::string &line)
+{
+    if (line.find("<(") == std::string::npos && line.find(">(") == std::string::npos) return true;
+    std::string out;
+    QuoteScan scan;
+    std::size_t i = 0;
+    while (i < line.size()) {
+        char c = line[i];
+        bool wordStart = (i == 0 || WHITESPACE.find(line[i - 1]) != std::string::npos);
+
+        if (scan.at(line, i) != QuoteScan::PLAIN) {
+            // quoted or escaped: copied as is
+        } else if (line.compare(i, 2, "$(") == 0) {
+            // A command or arithmetic substitution is expansion's: '$(sort <(ls))' stays as is
+            std::size_t closing = findClosingParen(line, i + 1);
+            std::size_t end = (closing == std::string::npos) ? line.size() : closing + 1;
+            out.append(line, i, end - i);
+            i = end;
+            continue;
+        } else if (wordStart && (c == '<' || c == '>') && i + 1 < line.size() && line[i + 1] == '(') {
+            TRACE_SCOPE("process-substitution");
+            std::size_t closing = findClosingParen(line, i + 1);
+            if (closing == std::string::npos) {
+                std::cerr << "smash error: process substitution: missing ')'" << std::endl;
+                return false;
+            }
+            std::string inner = _trim(line.substr(i + 2, closing - i - 2));
+            bool reading = (c == '<'); // <(cmd): the outer command reads what cmd writes
 
-    // Handle Post-Wait Status
-    if (WIFSTOPPED(status)) {
-        // Process stopped (Ctrl-Z) -> Move back to background
-        smash.setCJisStopped(true);
-        smash.setCJinsertionTime(time(nullptr));
-        smash.addBGJob(smash.getCJPid(), smash.getCJCommandLine(), true, smash.getCJobId(), smash.getCJPrintCommandLine().c_str());
-    } else {
-        // Process finished -> Cleanup
-        smash.updateSmashAfterCjFinished();
+            int fds[2];
+            if (pipe(fds) == -1) {
+                perror("smash error: pipe failed");
+                return false;
+            }
+
+            // Same machinery as a pipeline stage; the child must not keep earlier substitutions' ends
+            pid_t pid = reading
+                        ? launchProcessWithPipe(inner, -1, fds[1], false, true, fds, false, &m_fds)
+                        : launchProcessWithPipe(inner, fds[0], -1, true, false, fds, false, &m_fds);
+            if (pid == -1) {
+                close(fds[0]);
+                close(fds[1]);
+                return false;
+            }
+            m_pids.push_back(pid);
+            SmallShell::getInstance().setNextJobHelpers(m_pids);
+
+            // Keep our end, without close-on-exec so the outer command inherits it
+            int keep = reading ? fds[0] : fds[1];
+            close(reading ? fds[1] : fds[0]);
+            int high = fcntl(keep, F_DUPFD, SUBSTITUTION_FD_BASE);
+            if (high != -1) {
+                close(keep);
+                keep = high;
+            }
+            m_fds.push_back(keep);
+
+            out += "/dev/fd/" + std::to_string(keep);
+            i = closing + 1;
+            continue;
+        }
+        out += c;
+        ++i;
     }
+
+    line = out;
+    return true;
 }
 
-void QuitCommand::execute(){
+ProcessSubstitutions::~ProcessSubstitutions()
+{
+    if (m_pids.empty()) return;
     SmallShell &smash = SmallShell::getInstance();
 
-    // Kill Foreground Process if exists
-    pid_t fg_pid = smash.isFGrunning() ? smash.getCJPid() : -1;
-    if (fg_pid > 0) {
-        kill(fg_pid, SIGKILL);
-    }
+    // Our ends go first: the children see EOF / SIGPIPE once the outer command is done
+    for (int fd : m_fds) close(fd);
 
-    // Check for "kill" argument
-    if ((this->getArgsNum() >= 2) && (this->getArg(1) == "kill")) {
+    // Helpers still here were not adopted by a job - they belong to the finished command
+    std::vector<pid_t> helpers = smash.takeNextJobHelpers();
+    for (pid_t pid : helpers) smash.waitForChild(pid, nullptr, 0);
+}
 
-        // Calculate total running jobs (including FG if it was running)
+// ==================================================================================
+//                           Command Substitution
+// ==================================================================================
+
+#define CAPTURE_INITIAL_SIZE (4096)
+
+/**
+ * Reads 'fd' to EOF into 'output', doubling the buffer as it fills.
+ */
+static void readAllInto(int fd, std::string &output)
+{
+    std::size_t used = 0;
+    output.resize(CAPTURE_INITIAL_SIZE);
+    while (true) {
+        if (used == output.size()) output.resize(output.size() * 2);
+        ssize_t n = read(fd, &output[used], output.size() - used);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) break;
+        used += n;
+    }
+    output.resize(used);
+}
+
+void captureCommandOutput(const std::string &cmd_line, std::string &output, int *status)
+{
+    TRACE_SCOPE("command-substitution");
+    SmallShell &smash = SmallShell::getInstance();
+    output.clear();
+    if (status) *status = 0;
+
+    // Same preparation executeCommand() does, so the command can be inspected first.
+    // The outer line's scans left this span alone: here-strings and <(...) resolve here
+    std::string inner = _trim(cmd_line);
+    InlineInputs inlineInputs;
+    ProcessSubstitutions substitutions;
+    if (!inlineInputs.resolve(inner, nullptr) || !substitutions.resolve(inner)) {
+        if (status) *status = 1 << 8;
+        return;
+    }
+    std::string line = smash.reproduceWithAlias(inner.c_str());
+
+    // A list or loop ('a && b', 'for ...') is never made into one Command: the child
+    // runs it through executeCommand(), which expands each part as it runs
+    bool script = Script::isScript(line);
+    if (!script && !expandCommandLine(line)) {
+        if (status) *status = 1 << 8;
+        return;
+    }
+
+    Command *cmd = script ? nullptr : smash.CreateCommand(line.c_str());
+    if (!script && !cmd) return;
+
+    // $(...) is a subshell: only builtins that just print may skip the fork. Anything
+    // else ('cd', 'quit', assignments, aliases...) must not reach this shell
+    if (cmd != nullptr && runsAsPipelineStage(cmd)) {
+        // They print through cout - point it at a string buffer instead of forking
+        std::ostringstream captured;
+        std::cout.flush();
+        std::streambuf *previous = std::cout.rdbuf(captured.rdbuf());
+        cmd->execute();
+        std::cout.rdbuf(previous);
+        delete cmd;
+
+        output = captured.str();
+        return;
+    }
+
+    int fds[2];
+    if (pipe(fds) == -1) {
+        perror("smash error: pipe failed");
+        delete cmd;
+        return;
+    }
+
+    // The child must not take further lines of the shell's input (an open 'for' would)
+    std::istream *input = smash.getInputStream();
+    smash.setInputStream(nullptr);
+    pid_t pid = launchProcessWithPipe(line, -1, fds[1], false, true, fds, false, nullptr, cmd);
+    smash.setInputStream(input);
+    delete cmd;
+    close(fds[1]);
+    if (pid == -1) {
+        close(fds[0]);
+        return;
+    }
+
+    readAllInto(fds[0], output);
+    close(fds[0]);
+    smash.waitForChild(pid, status, 0);
+}
+
+// ==================================================================================
+//                           Class: TimeCommand
+// ==================================================================================
+
+TimeCommand::TimeCommand(const char *cmd_line)
+        : Command(cmd_line), m_innerCmdLine(""), m_verbose(false)
+{
+    // Strip the 'time' keyword (and '-v') but keep the rest of the line verbatim,
+    // so quoting, pipes and redirections reach the inner command untouched
+    std::string line = _trim(string(getCmdLine()));
+    std::size_t pos = line.find_first_of(WHITESPACE);
+    std::string rest = (pos == std::string::npos) ? "" : _trim(line.substr(pos));
+
+    if (rest == "-v" || rest.compare(0, 3, "-v ") == 0 || rest.compare(0, 3, "-v\t") == 0) {
+        m_verbose = true;
+        rest = _trim(rest.substr(2));
+    }
+
+    m_innerCmdLine = rest;
+    if (!m_innerCmdLine.empty() && isBackground()) {
+        m_innerCmdLine += " &";
+    }
+}
+
+void TimeCommand::execute()
+{
+    SmallShell &smash = SmallShell::getInstance();
+
+    if (m_innerCmdLine.empty()) {
+        std::cerr << "smash error: time: missing command" << std::endl;
+        builtinFailed();
+        return;
+    }
+
+    ResourceUsage usage = smash.executeMeasured(m_innerCmdLine.c_str());
+    usage.print(std::cerr, m_verbose);
+}
+
+// ==================================================================================
+//                              Class: LimitCommand
+// ==================================================================================
+
+LimitCommand::LimitCommand(const char *cmd_line)
+        : Command(cmd_line), m_innerCmdLine(""), m_valid(true)
+{
+    // Options are plain words; the command line after them is kept verbatim
+    std::string line = _trim(string(getCmdLine()));
+    std::size_t pos = line.find_first_of(WHITESPACE);
+    std::string rest = (pos == std::string::npos) ? "" : _trim(line.substr(pos));
+
+    while (m_valid && rest.compare(0, 2, "--") == 0) {
+        std::size_t end = rest.find_first_of(WHITESPACE);
+        std::string option = rest.substr(0, end);
+        rest = (end == std::string::npos) ? "" : _trim(rest.substr(end));
+
+        end = rest.find_first_of(WHITESPACE);
+        std::string value = rest.substr(0, end);
+        rest = (end == std::string::npos) ? "" : _trim(rest.substr(end));
+
+        m_valid = ResourceLimits::parseOption(option, value, m_limits);
+    }
+
+    m_innerCmdLine = rest;
+    if (!m_innerCmdLine.empty() && isBackground()) {
+        m_innerCmdLine += " &";
+    }
+}
+
+void LimitCommand::execute()
+{
+    if (!m_valid) {
+        builtinFailed();
+        return;
+    }
+    if (m_innerCmdLine.empty() || m_limits.empty()) {
+        std::cerr << "smash error: limit: invalid arguments" << std::endl;
+        builtinFailed();
+        return;
+    }
+    if (m_limits.cpuPercent > 0 && !ResourceLimits::hasCpuController()) {
+        std::cerr << "smash error: limit: --cpu " << m_limits.cpuPercent
+                  << "% needs the cgroup v2 cpu controller, ignored" << std::endl;
+    }
+
+    // Picked up by the children forked for the inner line; builtins run unlimited
+    ResourceLimits::setPending(&m_limits);
+    SmallShell::getInstance().executeCommand(m_innerCmdLine.c_str());
+    ResourceLimits::setPending(nullptr);
+}
+
+// ==================================================================================
+//                              Class: SubmitCommand
+// ==================================================================================
+
+SubmitCommand::SubmitCommand(const char *cmd_line)
+        : Command(cmd_line), m_innerCmdLine(""), m_valid(true)
+{
+    // Default: one running submitted job per CPU, no load limit, FIFO
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    m_limits.maxRunning = (cpus > 0) ? (int) cpus : 1;
+    m_limits.maxLoad = 0;
+    m_limits.priority = 0;
+
+    // Options are plain words; the command line after them is kept verbatim
+    std::string line = _trim(string(getCmdLine()));
+    std::size_t pos = line.find_first_of(WHITESPACE);
+    std::string rest = (pos == std::string::npos) ? "" : _trim(line.substr(pos));
+
+    while (m_valid && rest.compare(0, 2, "--") == 0) {
+        std::size_t end = rest.find_first_of(WHITESPACE);
+        std::string option = rest.substr(0, end);
+        rest = (end == std::string::npos) ? "" : _trim(rest.substr(end));
+        if (option == "--") break;
+
+        end = rest.find_first_of(WHITESPACE);
+        std::string value = rest.substr(0, end);
+        rest = (end == std::string::npos) ? "" : _trim(rest.substr(end));
+
+        char *stop = nullptr;
+        double number = strtod(value.c_str(), &stop);
+        bool whole = value.find_first_not_of("-0123456789") == std::string::npos;
+        bool ok = !value.empty() && *stop == '\0';
+        if (option == "--max-running") {
+            ok = ok && whole && number >= 1 && number <= JobQueue::CAPACITY;
+            m_limits.maxRunning = (int) number;
+        } else if (option == "--max-load") {
+            ok = ok && number > 0;
+            m_limits.maxLoad = number;
+        } else if (option == "--priority") {
+            ok = ok && whole && number >= -1000 && number <= 1000;
+            m_limits.priority = (int) number;
+        } else {
+            std::cerr << "smash error: submit: invalid option " << option << std::endl;
+            m_valid = false;
+            continue;
+        }
+        if (!ok) {
+            std::cerr << "smash error: submit: invalid " << option << " value " << value << std::endl;
+            m_valid = false;
+        }
+    }
+    m_innerCmdLine = rest;
+}
+
+void SubmitCommand::execute()
+{
+    SmallShell &smash = SmallShell::getInstance();
+    if (!m_valid) {
+        builtinFailed();
+        return;
+    }
+    if (m_innerCmdLine.empty()) {
+        std::cerr << "smash error: submit: invalid arguments" << std::endl;
+        builtinFailed();
+        return;
+    }
+    if (smash.isSubmitQueueFull()) {
+        std::cerr << "smash error: submit: queue is full" << std::endl;
+        builtinFailed();
+        return;
+    }
+    if (m_limits.maxLoad > 0 && JobQueue::loadAverage() < 0) {
+        std::cerr << "smash error: submit: /proc/loadavg unavailable, --max-load ignored" << std::endl;
+        m_limits.maxLoad = 0;
+    }
+
+    // The job starts now, blocked on 'gate' until the queue writes to it
+    int gate[2];
+    if (pipe2(gate, O_CLOEXEC) == -1) {
+        perror("smash error: pipe failed");
+        builtinFailed();
+        return;
+    }
+    Command *prepared = createStageCommand(m_innerCmdLine);
+    if (prepared == nullptr) {
+        close(gate[0]);
+        close(gate[1]);
+        return;
+    }
+    pid_t child = TRACE_FORK();
+    if (child == -1) {
+        perror("smash error: fork failed");
+        Metrics::countForkFailure();
+        close(gate[0]);
+        close(gate[1]);
+        delete prepared;
+        builtinFailed();
+        return;
+    }
+    if (child == 0) {
+        setpgrp();
+        close(gate[1]);
+        // Earlier jobs' gates: holding their write ends would keep them from seeing EOF
+        smash.closeSubmitGatesInChild();
+
+        // Admission is the one byte; EOF means the shell is gone and the job never runs
+        char byte;
+        ssize_t n;
+        do {
+            n = read(gate[0], &byte, 1);
+        } while (n == -1 && errno == EINTR);
+        close(gate[0]);
+        if (n != 1) {
+            _exit(EXIT_FAILURE);
+        }
+        if (!ResourceLimits::applyInChild(true)) {
+            _exit(EXIT_FAILURE);
+        }
+        ExternalCommand *external = dynamic_cast<ExternalCommand*>(prepared);
+        if (external != nullptr) external->execInChild();
+
+        smash.executeCommand(m_innerCmdLine.c_str());
+        std::cout.flush();
+        std::cerr.flush();
+        fflush(nullptr);
+        _exit(smash.getLastStatus());
+    }
+    delete prepared;
+
+    // A background job from the start; 'jobs' shows it as queued until admitted
+    std::string printTxt = m_innerCmdLine + " &";
+    int jobId = smash.getNextFreeJobId();
+    JobJournal::jobStarted(child, jobId, printTxt);
+    smash.setLastBgPid(child);
+    smash.addBGJob(child, m_innerCmdLine, false, jobId, printTxt);
+    smash.setJobIdUsed(jobId);
+
+    if (!smash.queueBGJob(jobId, gate, m_limits)) {
+        close(gate[0]);
+        close(gate[1]);
+        kill(child, SIGKILL);
+        std::cerr << "smash error: submit: failed to queue job " << jobId << std::endl;
+        builtinFailed();
+    }
+}
+
+// ==================================================================================
+//                              Class: PipeStatCommand
+// ==================================================================================
+
+PipeStatCommand::PipeStatCommand(const char *cmd_line)
+        : Command(cmd_line), m_innerCmdLine(""), m_pipeSize(-1), m_valid(true)
+{
+    std::string line = _trim(string(getCmdLine()));
+    if (isBackground()) {
+        _removeBackgroundSign(&line[0]); // a pipeline runs in the foreground anyway
+        line = _trim(line.c_str());
+    }
+    std::size_t pos = line.find_first_of(WHITESPACE);
+    std::string rest = (pos == std::string::npos) ? "" : _trim(line.substr(pos));
+
+    if (rest.compare(0, 7, "--size ") == 0 || rest.compare(0, 7, "--size\t") == 0) {
+        rest = _trim(rest.substr(7));
+        std::size_t end = rest.find_first_of(WHITESPACE);
+        std::string value = rest.substr(0, end);
+        rest = (end == std::string::npos) ? "" : _trim(rest.substr(end));
+
+        // Bytes, or K/M multiples
+        char *suffix = nullptr;
+        m_pipeSize = strtoll(value.c_str(), &suffix, 10);
+        std::string unit(suffix);
+        if (unit == "K" || unit == "k") m_pipeSize <<= 10;
+        else if (unit == "M" || unit == "m") m_pipeSize <<= 20;
+        else if (!unit.empty()) m_pipeSize = 0;
+        if (suffix == value.c_str() || m_pipeSize <= 0) {
+            std::cerr << "smash error: pipestat: invalid size " << value << std::endl;
+            m_valid = false;
+        }
+    }
+    m_innerCmdLine = rest;
+}
+
+void PipeStatCommand::execute()
+{
+    if (!m_valid) {
+        builtinFailed();
+        return;
+    }
+
+    // 1. Stages, split at '|' and '|&' outside quotes
+    std::vector<std::string> stages;
+    std::vector<bool> toStderr;     // per edge: '|&' carries the stage's stderr
+    std::string text = m_innerCmdLine;
+    std::size_t begin = 0;
+    QuoteScan scan;
+    bool valid = true;
+    for (std::size_t i = 0; i <= text.size(); ++i) {
+        if (i < text.size()) {
+            if (scan.at(text, i) != QuoteScan::PLAIN || text[i] != '|') continue;
+        }
+        stages.push_back(_trim(text.substr(begin, i - begin)));
+        if (stages.back().empty()) valid = false;
+        if (i == text.size()) break;
+
+        bool errPipe = (i + 1 < text.size() && text[i + 1] == '&');
+        if (i + 1 < text.size() && text[i + 1] == '|') valid = false; // '||' is a list, not a pipe
+        toStderr.push_back(errPipe);
+        if (errPipe) ++i;
+        begin = i + 1;
+    }
+    if (!valid || stages.size() < 2) {
+        std::cerr << "smash error: pipestat: expected a pipeline" << std::endl;
+        builtinFailed();
+        return;
+    }
+    std::size_t edges = stages.size() - 1;
+
+    // 2. Two pipes per edge: stage -> relay and relay -> next stage
+    std::vector<int> all;
+    std::vector<int> up(edges * 2, -1), down(edges * 2, -1);
+    bool failed = false;
+    for (std::size_t e = 0; e < edges && !failed; ++e) {
+        failed = (pipe(&up[e * 2]) == -1);
+        if (!failed) {
+            all.push_back(up[e * 2]);
+            all.push_back(up[e * 2 + 1]);
+            failed = (pipe(&down[e * 2]) == -1);
+        }
+        if (!failed) {
+            all.push_back(down[e * 2]);
+            all.push_back(down[e * 2 + 1]);
+        }
+    }
+    if (failed) {
+        perror("smash error: pipe failed");
+        for (int fd : all) close(fd);
+        builtinFailed();
+        return;
+    }
+
+    long long pipeSize = -1;
+#ifdef F_SETPIPE_SZ
+    if (m_pipeSize > 0) {
+        for (std::size_t i = 1; i < all.size(); i += 2) {
+            if (fcntl(all[i], F_SETPIPE_SZ, (int) std::min<long long>(m_pipeSize, INT_MAX)) == -1) {
+                perror("smash error: pipestat: F_SETPIPE_SZ failed");
+                break;
+            }
+        }
+    }
+    pipeSize = fcntl(down[1], F_GETPIPE_SZ);
+#endif
+
+    // Written by the relay children, read here once they are done
+    void *shared = mmap(nullptr, sizeof(EdgeStats) * edges, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        perror("smash error: mmap failed");
+        for (int fd : all) close(fd);
+        builtinFailed();
+        return;
+    }
+    EdgeStats *stats = static_cast<EdgeStats*>(shared);
+    memset(stats, 0, sizeof(EdgeStats) * edges);
+
+    SmallShell &smash = SmallShell::getInstance();
+    std::vector<pid_t> pids;
+    pid_t lastPid = -1;
+    double start = monotonicSeconds();
+
+    // 3. Stages - started like a pipeline's, each child keeps only its own ends
+    for (std::size_t k = 0; k < stages.size() && !failed; ++k) {
+        int fds[2] = {k > 0 ? down[(k - 1) * 2] : -1, k < edges ? up[k * 2 + 1] : -1};
+        Command *cmd = createStageCommand(stages[k]);
+        pid_t pid = launchProcessWithPipe(stages[k], fds[0], fds[1], k > 0, k < edges, fds,
+                                          k < edges && toStderr[k], &all, cmd);
+        delete cmd;
+        if (pid == -1) failed = true;
+        else pids.push_back(pid);
+        lastPid = pid;
+    }
+
+    // 4. One relay child per edge
+    std::vector<pid_t> relays;
+    for (std::size_t e = 0; e < edges && !failed; ++e) {
+        pid_t pid = TRACE_FORK();
+        if (pid == -1) {
+            perror("smash error: fork failed");
+            Metrics::countForkFailure();
+            failed = true;
+        } else if (pid == 0) {
+            setpgrp();
+            signal(SIGPIPE, SIG_IGN); // a reader that exits ends the relay, not the process
+            for (int fd : all) {
+                if (fd != up[e * 2] && fd != down[e * 2 + 1]) close(fd);
+            }
+            Relay::measure(up[e * 2], down[e * 2 + 1], stats[e]);
+            _exit(0);
+        } else {
+            relays.push_back(pid);
+        }
+    }
+
+    // 5. Parent Cleanup & Wait
+    for (int fd : all) close(fd);
+    int status = 0;
+    for (pid_t pid : pids) {
+        if (pid == lastPid) smash.waitForChild(pid, &status, 0);
+        else smash.waitForChild(pid, nullptr, 0);
+    }
+    for (pid_t pid : relays) smash.waitForChild(pid, nullptr, 0);
+    double wall = monotonicSeconds() - start;
+
+    if (failed) {
+        munmap(shared, sizeof(EdgeStats) * edges);
+        builtinFailed();
+        return;
+    }
+
+    // 6. Report: a stage holds the pipeline up when the edge before it was full
+    // (its writer blocked) and the edge after it was empty (its reader waited).
+    // Each side counts as the share of its edge's time; the first stage never
+    // waits for input and the last never waits for room, so theirs count as 1
+    std::ostream &os = std::cerr;
+    os << "pipestat: " << stages.size() << " stages, ";
+    if (pipeSize > 0) os << (pipeSize >> 10) << " KiB pipes, ";
+    os << std::fixed << std::setprecision(3) << wall << "s\n";
+    os << std::left << std::setw(8) << "edge" << std::right
+       << std::setw(14) << "bytes" << std::setw(10) << "MB/s"
+       << std::setw(18) << "writer blocked" << std::setw(18) << "reader waiting" << "\n";
+
+    std::size_t bottleneck = 0;
+    double worst = -1;
+    for (std::size_t k = 0; k < stages.size(); ++k) {
+        double fedFull = 1, drainedEmpty = 1;
+        if (k > 0 && stats[k - 1].wallSeconds > 0) fedFull = stats[k - 1].fullSeconds / stats[k - 1].wallSeconds;
+        if (k < edges && stats[k].wallSeconds > 0) drainedEmpty = stats[k].emptySeconds / stats[k].wallSeconds;
+        double held = fedFull * drainedEmpty;
+        if (held > worst) {
+            worst = held;
+            bottleneck = k;
+        }
+    }
+    for (std::size_t e = 0; e < edges; ++e) {
+        const EdgeStats &edge = stats[e];
+        double rate = (edge.wallSeconds > 0) ? edge.bytes / 1e6 / edge.wallSeconds : 0;
+        std::ostringstream name;
+        name << (e + 1) << " -> " << (e + 2);
+        os << std::left << std::setw(8) << name.str() << std::right
+           << std::setw(14) << edge.bytes
+           << std::setw(10) << std::setprecision(1) << rate
+           << std::setw(17) << std::setprecision(3) << edge.fullSeconds << "s"
+           << std::setw(17) << edge.emptySeconds << "s\n";
+    }
+    if (worst < 0.05) os << "bottleneck: none (no stage kept another waiting)" << std::endl;
+    else os << "bottleneck: stage " << (bottleneck + 1) << " (" << stages[bottleneck] << ")" << std::endl;
+    os.unsetf(std::ios::floatfield);
+    os.unsetf(std::ios::adjustfield);
+    os.precision(6);
+
+    munmap(shared, sizeof(EdgeStats) * edges);
+    smash.setLastStatus(_waitStatusToExitStatus(status));
+}
+
+// ==================================================================================
+//                              Class: PerfStatCommand
+// ==================================================================================
+
+/**
+ * The threads of 'pid' (/proc/<pid>/task), or just 'pid' where that is not available.
+ */
+static std::vector<pid_t> listTasks(pid_t pid) {
+    std::vector<pid_t> tasks;
+    std::string dirName = "/proc/" + std::to_string(pid) + "/task";
+    DIR *dir = opendir(dirName.c_str());
+    if (dir != nullptr) {
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != nullptr) {
+            if (isdigit((unsigned char) entry->d_name[0])) tasks.push_back((pid_t) atoi(entry->d_name));
+        }
+        closedir(dir);
+    }
+    if (tasks.empty()) tasks.push_back(pid);
+    return tasks;
+}
+
+/**
+ * True while 'pid' exists and has not exited. A zombie (e.g. a job the shell has
+ * not reaped yet) counts as gone.
+ */
+static bool processRunning(pid_t pid) {
+    if (kill(pid, 0) == -1 && errno == ESRCH) return false;
+    std::string path = "/proc/" + std::to_string(pid) + "/stat";
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return true; // no /proc: kill() is all we can go by
+    char buf[512];
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0) return false;
+    buf[n] = '\0';
+    const char *paren = strrchr(buf, ')'); // the command name may contain anything
+    return !(paren != nullptr && (paren[2] == 'Z' || paren[2] == 'X'));
+}
+
+/**
+ * Sleeps up to 'seconds'; a signal (ctrl-C, a child exiting) cuts it short.
+ */
+static void napFor(double seconds) {
+    if (seconds <= 0) return;
+    struct timespec ts;
+    ts.tv_sec = (time_t) seconds;
+    ts.tv_nsec = (long) ((seconds - ts.tv_sec) * 1e9);
+    nanosleep(&ts, nullptr);
+}
+
+/**
+ * One '-i' line: the deltas since 'prev', which is then updated.
+ */
+static void printPerfInterval(const PerfCounters &counters, double elapsed, double prev[]) {
+    double now[PerfCounters::EVENT_COUNT];
+    counters.read(now);
+    std::ostream &os = std::cerr;
+    os << std::fixed << std::setprecision(3) << std::setw(10) << elapsed;
+    for (int event = 0; event < PerfCounters::EVENT_COUNT; ++event) {
+        int width = (int) strlen(PerfCounters::name(event)) + 2;
+        if (event == PerfCounters::TASK_CLOCK) width += 4;  // "(ms)"
+        if (now[event] < 0) {
+            os << std::setw(width) << "-";
+        } else if (event == PerfCounters::TASK_CLOCK) {
+            os << std::setw(width) << std::setprecision(2) << (now[event] - prev[event]) / 1e6;
+        } else {
+            os << std::setw(width) << std::setprecision(0) << (now[event] - prev[event]);
+        }
+        prev[event] = now[event];
+    }
+    os << std::endl;
+    os.unsetf(std::ios::floatfield);
+    os.precision(6);
+}
+
+/**
+ * The closing summary, laid out like 'perf stat'.
+ */
+static void printPerfSummary(const PerfCounters &counters, const std::string &target, double elapsed) {
+    double values[PerfCounters::EVENT_COUNT];
+    counters.read(values);
+    std::ostream &os = std::cerr;
+    os << "\n Performance counter stats for " << target;
+    if (counters.userOnly()) os << " (user space only)";
+    os << ":\n\n" << std::fixed;
+    for (int event = 0; event < PerfCounters::EVENT_COUNT; ++event) {
+        const char *name = PerfCounters::name(event);
+        if (values[event] < 0) {
+            os << std::setw(18) << "<not supported>" << "      " << name << "\n";
+            continue;
+        }
+        if (event == PerfCounters::TASK_CLOCK) {
+            os << std::setw(18) << std::setprecision(2) << values[event] / 1e6 << " msec " << name;
+            if (elapsed > 0) {
+                os << std::setw(22 - (int) strlen(name)) << "#  " << std::setprecision(3)
+                   << values[event] / 1e9 / elapsed << " CPUs utilized";
+            }
+        } else {
+            os << std::setw(18) << std::setprecision(0) << values[event] << "      " << name;
+            if (event == PerfCounters::INSTRUCTIONS && values[PerfCounters::CYCLES] > 0) {
+                os << std::setw(22 - (int) strlen(name)) << "#  " << std::setprecision(2)
+                   << values[event] / values[PerfCounters::CYCLES] << " insn per cycle";
+            }
+        }
+        os << "\n";
+    }
+    os << "\n" << std::setw(14) << std::setprecision(6) << elapsed << " seconds time elapsed\n" << std::endl;
+    os.unsetf(std::ios::floatfield);
+    os.precision(6);
+}
+
+PerfStatCommand::PerfStatCommand(const char *cmd_line)
+        : Command(cmd_line), m_innerCmdLine(""), m_interval(0), m_pid(-1), m_jobId(-1), m_valid(true)
+{
+    std::string line = _trim(string(getCmdLine()));
+    if (isBackground()) {
+        _removeBackgroundSign(&line[0]); // the counted command runs in the foreground
+        line = _trim(line.c_str());
+    }
+    std::size_t pos = line.find_first_of(WHITESPACE);
+    std::string rest = (pos == std::string::npos) ? "" : _trim(line.substr(pos));
+
+    // Options are plain words; the command line after them is kept verbatim
+    while (m_valid && !rest.empty()) {
+        std::size_t end = rest.find_first_of(WHITESPACE);
+        std::string word = rest.substr(0, end);
+        std::string after = (end == std::string::npos) ? "" : _trim(rest.substr(end));
+
+        if (word == "--") {
+            rest = after;
+            break;
+        }
+        if (word == "-i" || word == "-p") {
+            end = after.find_first_of(WHITESPACE);
+            std::string value = after.substr(0, end);
+            rest = (end == std::string::npos) ? "" : _trim(after.substr(end));
+
+            char *stop = nullptr;
+            double number = strtod(value.c_str(), &stop);
+            bool ok = !value.empty() && *stop == '\0' && number > 0;
+            if (word == "-i") m_interval = number;
+            else {
+                ok = ok && value.find_first_not_of("0123456789") == std::string::npos;
+                m_pid = (pid_t) number;
+            }
+            if (!ok) {
+                std::cerr << "smash error: perfstat: invalid " << word << " value " << value << std::endl;
+                m_valid = false;
+            }
+            continue;
+        }
+        if (word[0] == '%') {
+            std::string id = word.substr(1);
+            if (id.empty() || id.find_first_not_of("0123456789") != std::string::npos) {
+                std::cerr << "smash error: perfstat: invalid job " << word << std::endl;
+                m_valid = false;
+            } else {
+                m_jobId = atoi(id.c_str());
+            }
+            rest = after;
+            continue;
+        }
+        break;
+    }
+    m_innerCmdLine = rest;
+
+    if (m_valid && (int) (m_pid != -1) + (int) (m_jobId != -1) + (int) !m_innerCmdLine.empty() != 1) {
+        std::cerr << "smash error: perfstat: expected one of -p PID, %JOB or a command" << std::endl;
+        m_valid = false;
+    }
+}
+
+void PerfStatCommand::execute()
+{
+    if (!m_valid) {
+        builtinFailed();
+        return;
+    }
+    SmallShell &smash = SmallShell::getInstance();
+    PerfCounters counters;
+    std::ostringstream target;
+    pid_t child = -1;
+
+    if (m_jobId != -1) {
+        if (!smash.isContainsBGJob(m_jobId)) {
+            std::cerr << "smash error: perfstat: job-id " << m_jobId << " does not exist" << std::endl;
+            builtinFailed();
+            return;
+        }
+        m_pid = smash.getBGjobPidById(m_jobId);
+    }
+
+    if (m_pid != -1) {
+        // 1a. An existing process: every thread it has now, and (inherit) everything it starts
+        if (!processRunning(m_pid)) {
+            std::cerr << "smash error: perfstat: pid " << m_pid << " does not exist" << std::endl;
+            builtinFailed();
+            return;
+        }
+        if (!counters.attach(listTasks(m_pid))) {
+            builtinFailed();
+            return;
+        }
+        if (m_jobId != -1) target << "job " << m_jobId << " (pid " << m_pid << ")";
+        else target << "process " << m_pid;
+    } else {
+        // 1b. A command line, in a child that waits on 'gate' until the counters are on
+        // it - so its own children, forked right away, are already counted
+        int gate[2];
+        if (pipe2(gate, O_CLOEXEC) == -1) {
+            perror("smash error: pipe failed");
+            builtinFailed();
+            return;
+        }
+        Command *prepared = createStageCommand(m_innerCmdLine);
+        if (prepared == nullptr) {
+            close(gate[0]);
+            close(gate[1]);
+            return;
+        }
+        child = TRACE_FORK();
+        if (child == -1) {
+            perror("smash error: fork failed");
+            Metrics::countForkFailure();
+            close(gate[0]);
+            close(gate[1]);
+            delete prepared;
+            builtinFailed();
+            return;
+        }
+        if (child == 0) {
+            setpgrp();
+            close(gate[1]);
+            char byte;
+            while (read(gate[0], &byte, 1) == -1 && errno == EINTR) {}
+            close(gate[0]);
+            if (!ResourceLimits::applyInChild(false)) {
+                _exit(EXIT_FAILURE);
+            }
+            ExternalCommand *external = dynamic_cast<ExternalCommand*>(prepared);
+            if (external != nullptr) external->execInChild();
+
+            smash.executeCommand(m_innerCmdLine.c_str());
+            std::cout.flush();
+            std::cerr.flush();
+            fflush(nullptr);
+            _exit(smash.getLastStatus());
+        }
+        delete prepared;
+        close(gate[0]);
+        bool attached = counters.attach(std::vector<pid_t>(1, child));
+        if (!attached) kill(child, SIGKILL);
+        close(gate[1]);
+        if (!attached) {
+            smash.waitForChild(child, nullptr, 0);
+            builtinFailed();
+            return;
+        }
+
+        // A foreground job like any other: ctrl-C kills it
+        smash.setCJPid(child);
+        smash.setCJobId(smash.getNextFreeJobId());
+        smash.setCJCommandLine(m_innerCmdLine);
+        JobJournal::jobStarted(child, smash.getCJobId(), m_innerCmdLine);
+        target << "'" << m_innerCmdLine << "'";
+    }
+
+    // 2. Wait for the end - the command exiting, the process going away, or ctrl-C
+    // for an attached process - printing a line per interval on the way
+    double start = monotonicSeconds();
+    double nextTick = start + m_interval;
+    double prev[PerfCounters::EVENT_COUNT] = {0};
+    double lastLine = 0;
+    int status = 0;
+    bool stopped = false;
+    smash.setInterrupted(false);
+    ShellOutput::flush();
+    if (m_interval > 0) {
+        std::cerr << "#" << std::setw(9) << "time";
+        for (int event = 0; event < PerfCounters::EVENT_COUNT; ++event) {
+            std::cerr << "  " << PerfCounters::name(event) << (event == PerfCounters::TASK_CLOCK ? "(ms)" : "");
+        }
+        std::cerr << std::endl;
+    }
+    while (true) {
+        if (child != -1) {
+            int options = WUNTRACED | (m_interval > 0 ? WNOHANG : 0);
+            pid_t res = smash.waitForChild(child, &status, options);
+            if (res == child || (res == -1 && errno != EINTR)) {
+                stopped = (res == child && WIFSTOPPED(status));
+                break;
+            }
+        } else if (smash.isInterrupted() || !processRunning(m_pid)) {
+            break;
+        }
+        double now = monotonicSeconds();
+        if (m_interval > 0 && now >= nextTick) {
+            lastLine = now - start;
+            printPerfInterval(counters, lastLine, prev);
+            nextTick += m_interval;
+            now = monotonicSeconds();
+        }
+        double wait = (m_interval > 0) ? std::min(nextTick - now, 0.05) : 0.05;
+        napFor(wait);
+    }
+    double elapsed = monotonicSeconds() - start;
+    if (m_interval > 0 && elapsed - lastLine > 1e-3) {
+        printPerfInterval(counters, elapsed, prev); // the partial last interval
+    }
+    printPerfSummary(counters, target.str(), elapsed);
+
+    if (child == -1) return;
+    smash.setLastStatus(_waitStatusToExitStatus(status));
+    if (stopped) {
+        smash.setCJisStopped(true);
+        smash.setCJinsertionTime(time(nullptr));
+        smash.addBGJob(child, m_innerCmdLine, true, smash.getCJobId(), smash.getCJPrintCommandLine(),
+                       smash.takeNextJobHelpers());
+    } else if (smash.getCJPid() == child) {
+        smash.updateSmashAfterCjFinished();
+    }
+}
+
+// ==================================================================================
+//                            Job Control Commands
+// ==================================================================================
+
+void JobsCommand::execute() {
+    SmallShell &smash = SmallShell::getInstance();
+    smash.printJobsList();
+}
+
+void ForegroundCommand::execute() {
+    SmallShell &smash = SmallShell::getInstance();
+
+    //  Validate Arguments
+    if (this->getArgsNum() > 2) {
+        cerr << "smash error: fg: invalid arguments" << endl;
+        builtinFailed();
+        return;
+    }
+
+    int jobId = -1;
+
+    //  Determine Job ID to bring to foreground
+    if (this->getArgsNum() == 2) {
+        // Case: Specific Job ID requested
+        string arg = this->getArg(1);
+        if (!isNumber(arg, &jobId)) {
+            cerr << "smash error: fg: invalid arguments" << endl;
+            builtinFailed();
+            return;
+        }
+        if (!smash.isBGNotEmpty()){
+            cerr << "smash error: fg: job-id " << jobId << " does not exist" << endl;
+            builtinFailed();
+            return;
+        }
+        if (!smash.isContainsBGJob(jobId)) {
+            cerr << "smash error: fg: job-id " << jobId << " does not exist" << endl;
+            builtinFailed();
+            return;
+        }
+
+    } else {
+        // Case: No argument provided -> take the last job (maximal ID)
+        if (smash.isBGNotEmpty()){
+            jobId = smash.getLastJobJId();
+        } else {
+            cerr << "smash error: fg: jobs list is empty"<< endl;
+            builtinFailed();
+            return;
+        }
+    }
+
+    // Bring Job to Foreground
+    smash.setBGJobToFGbyJID(jobId);
+
+    // Continue process if it was stopped
+    if (smash.isCJisStopped()) {
+        kill(smash.getCJPid(), SIGCONT);
+        JobJournal::jobContinued(smash.getCJPid());
+    }
+
+    // Print command line and PID
+    cout << smash.getCJPrintCommandLine() << " " << smash.getCJPid() << endl;
+
+    // Remove from background list (since it's now FG)
+    smash.removeBGjobByJID(jobId);
+
+    //  Wait for the process to finish or stop
+    int status;
+    pid_t finishedPid = smash.waitForChild(smash.getCJPid(), &status, WUNTRACED);
+
+    if (finishedPid == -1) {
+        perror("smash error: waitpid failed");
+        smash.updateSmashAfterCjFinished();
+        builtinFailed();
+        return;
+    }
+    smash.setLastStatus(_waitStatusToExitStatus(status));
+
+    // Handle Post-Wait Status
+    if (WIFSTOPPED(status)) {
+        // Process stopped (Ctrl-Z) -> Move back to background
+        smash.setCJisStopped(true);
+        smash.setCJinsertionTime(time(nullptr));
+        smash.addBGJob(smash.getCJPid(), smash.getCJCommandLine(), true, smash.getCJobId(), smash.getCJPrintCommandLine().c_str());
+    } else {
+        // Process finished -> Cleanup
+        smash.updateSmashAfterCjFinished();
+    }
+}
+
+/**
+ * Parses a --since value: "<N>s|m|h|d" means that long ago, a plain number is
+ * a Unix timestamp. Returns the time in microseconds, or -1 if invalid.
+ */
+static long long parseSinceMicros(const std::string &arg) {
+    if (arg.empty()) return -1;
+    char *end = nullptr;
+    long long value = strtoll(arg.c_str(), &end, 10);
+    if (end == arg.c_str() || value < 0) return -1;
+
+    if (*end == '\0') return value * 1000000LL;
+    if (end[1] != '\0') return -1;
+
+    long long unit;
+    switch (*end) {
+        case 's': unit = 1; break;
+        case 'm': unit = 60; break;
+        case 'h': unit = 3600; break;
+        case 'd': unit = 86400; break;
+        default: return -1;
+    }
+    return ((long long) time(nullptr) - value * unit) * 1000000LL;
+}
+
+void JobLogCommand::execute() {
+    JournalQuery query;
+
+    for (int i = 1; i < getArgsNum(); ++i) {
+        string arg = getArg(i);
+        if (arg == "--failed") {
+            query.failedOnly = true;
+        } else if (arg == "--since" && i + 1 < getArgsNum()) {
+            long long since = parseSinceMicros(getArg(++i));
+            if (since < 0) {
+                cerr << "smash error: joblog: invalid arguments" << endl;
+                builtinFailed();
+                return;
+            }
+            query.sinceUs = since;
+        } else if (arg == "--slowest" && i + 1 < getArgsNum()) {
+            if (!isNumber(getArg(++i), &query.slowest) || query.slowest <= 0) {
+                cerr << "smash error: joblog: invalid arguments" << endl;
+                builtinFailed();
+                return;
+            }
+        } else {
+            cerr << "smash error: joblog: invalid arguments" << endl;
+            builtinFailed();
+            return;
+        }
+    }
+
+    std::vector<JournalRecord> records;
+    if (!JobJournal::query(query, records)) {
+        cerr << "smash error: joblog: journal is disabled" << endl;
+        builtinFailed();
+        return;
+    }
+
+    for (const auto &rec : records) {
+        char when[32];
+        time_t started = (time_t) (rec.startUs / 1000000);
+        struct tm tmStarted;
+        localtime_r(&started, &tmStarted);
+        strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tmStarted);
+
+        char line[256];
+        snprintf(line, sizeof(line), "%s [%d] %d %s %d  wall %.3fs user %.3fs sys %.3fs rss %lldKB  ",
+                 when, rec.jobId, rec.pid,
+                 rec.event == JOURNAL_SIGNALED ? "signal" : "exit", rec.status,
+                 (rec.timeUs - rec.startUs) / 1e6, rec.userUs / 1e6, rec.sysUs / 1e6,
+                 (long long) rec.maxRssKb);
+        cout << line << rec.command << "\n";
+    }
+    cout.flush();
+}
+
+void QuitCommand::execute(){
+    SmallShell &smash = SmallShell::getInstance();
+
+    // Kill Foreground Process if exists
+    pid_t fg_pid = smash.isFGrunning() ? smash.getCJPid() : -1;
+    if (fg_pid > 0) {
+        kill(fg_pid, SIGKILL);
+    }
+
+    // Check for "kill" argument
+    if ((this->getArgsNum() >= 2) && (this->getArg(1) == "kill")) {
+
+        // Calculate total running jobs (including FG if it was running)
         int runningJobsNum = ((smash.isFGrunning() ? smash.getBGNumOfJobs() + 1 : smash.getBGNumOfJobs()));
         cout << "smash: sending SIGKILL signal to " << runningJobsNum << " jobs:" << endl;
 
-        // Iterate and print jobs to be killed
-        for (int i = 1; i < MAX_BG_JOBS; i++) {
-            if (!smash.isJobIdUsed(i)) { continue; }
+        // Iterate and print jobs to be killed
+        for (int i = 1; i < MAX_BG_JOBS; i++) {
+            if (!smash.isJobIdUsed(i)) { continue; }
+
+            if (smash.isContainsBGJob(i)) {
+                cout << smash.getBGjobPidById(i) << ": " << smash.getBGJobPrintMsgByJobId(i) << endl;
+                continue;
+            } else if (i == smash.getCJobId()) {
+                cout << smash.getCJPid() << ": " << smash.getCJPrintCommandLine() << endl;
+                continue;
+            }
+            throw (std::runtime_error("error accured in quit command"));
+        }
+
+        // Perform the actual killing
+        smash.killAllBGJobsWithoutPrint();
+    }
+
+    // 3. Exit the shell
+    exit(0);
+}
+
+void KillCommand::execute()
+{
+    SmallShell& smash = SmallShell::getInstance();
+
+    //  Validate Argument Count
+    if (getArgsNum() != 3) {
+        cerr << "smash error: kill: invalid arguments" << endl;
+        builtinFailed();
+        return;
+    }
+
+    // Parse Signal Argument
+    std::string sig_str = getArg(1);
+    if (sig_str.empty()) {
+        cerr << "smash error: kill: invalid arguments" << endl;
+        builtinFailed();
+        return;
+    } else if (sig_str[0] != '-') {
+        cerr << "smash error: kill: invalid arguments" << endl;
+        builtinFailed();
+        return;
+    }
+
+    int sig_num;
+    try {
+        sig_num = std::stoi(sig_str.substr(1));
+    } catch (...) {
+        cerr << "smash error: kill: invalid arguments" << endl;
+        builtinFailed();
+        return;
+    }
+
+    //  Parse Job ID Argument
+    int job_id;
+    try {
+        job_id = std::stoi(getArg(2));
+    } catch (...) {
+        cerr << "smash error: kill: invalid arguments" << endl;
+        builtinFailed();
+        return;
+    }
+
+    //  Validate Job Logic
+    if (job_id < 0) {
+        cerr << "smash error: kill: invalid arguments" << endl;
+        builtinFailed();
+        return;
+    }
+    if (job_id == 0) {
+        cerr << "smash error: kill: job-id " << job_id << " does not exist" << endl;
+        builtinFailed();
+        return;
+    }
+
+    if (!smash.isContainsBGJob(job_id)) {
+        cerr << "smash error: kill: job-id " << job_id << " does not exist" << endl;
+        builtinFailed();
+        return;
+    }
+
+    // 5. Send Signal
+    pid_t pid = smash.getBGjobPidById(job_id);
+    cout << "signal number " << sig_num << " was sent to pid " << pid << endl;
+
+    if (kill(pid, sig_num) == -1) {
+        perror("smash error: kill failed");
+        builtinFailed();
+        return;
+    }
+
+    if (sig_num == SIGCONT) {
+        JobJournal::jobContinued(pid);
+    } else if (sig_num == SIGSTOP || sig_num == SIGTSTP || sig_num == SIGTTIN || sig_num == SIGTTOU) {
+        JobJournal::jobStopped(pid);
+    }
+}
+// ==================================================================================
+//                        Shell Environment Commands
+// ==================================================================================
+
+// ==================================================================================
+//                           Class: ChpromtCommand
+// ==================================================================================
+
+ChpromtCommand::ChpromtCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {
+    if (getArgsNum() > 1) {
+        m_promptMsg = getArg(1);
+    } else {
+        m_promptMsg = "smash";
+    }
+}
+
+void ChpromtCommand::execute() {
+    SmallShell::getInstance().setPrompt(m_promptMsg + "> ");
+}
+
+// ==================================================================================
+//                           Class: ShowPidCommand
+// ==================================================================================
+
+ShowPidCommand::ShowPidCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {}
+
+void ShowPidCommand::execute() {
+    std::cout << "smash pid is " << getpid() << std::endl;
+}
+
+// ==================================================================================
+//                           Class: GetCurrDirCommand
+// ==================================================================================
+
+GetCurrDirCommand::GetCurrDirCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {}
+
+void GetCurrDirCommand::execute() {
+    SmallShell &smash = SmallShell::getInstance();
+    cout << smash.getCurrentPwd() << std::endl;
+}
+
+// ==================================================================================
+//                           Class: ChangeDirCommand
+// ==================================================================================
+
+ChangeDirCommand::ChangeDirCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {
+    int args_num = getArgsNum();
+
+    if (args_num > 2) {
+        cerr << "smash error: cd: too many arguments" << endl;
+        builtinFailed();
+        m_dir = "";
+    }
+    else if (args_num == 2) {
+        m_dir = getArg(1);
+    }
+    else {
+        m_dir = "";
+    }
+}
+
+void ChangeDirCommand::execute() {
+    SmallShell &smash = SmallShell::getInstance();
+
+    // Handle "-" argument (Previous Directory)
+    if (m_dir == "-") {
+        m_dir = smash.getLastPwd();
+        if (m_dir == NO_DIRECTORY_SET) {
+            cerr << "smash error: cd: OLDPWD not set" << endl;
+            builtinFailed();
+            return;
+        }
+    }
+
+    // Handle empty directory (no operation)
+    if (m_dir == "") {
+        return;
+    }
+
+    // Perform change directory syscall
+    if (chdir(m_dir.c_str()) != 0) {
+        perror("smash error: chdir failed");
+        builtinFailed();
+        return;
+    }
+
+    // Update PWD in shell state
+    char cwd[PATH_MAX];
+    if (getcwd(cwd, sizeof(cwd)) == NULL) {
+        perror("smash error: getcwd failed");
+        builtinFailed();
+        return;
+    }
+
+    smash.setLastPwd(smash.getCurrentPwd());
+    smash.setCurrentPwd(string(cwd));
+}
+
+// ==================================================================================
+//                            Alias & Environment Variables
+// ==================================================================================
+
+// ==================================================================================
+//                           Class: AliasCommand
+// ==================================================================================
+
+
+void AliasCommand::execute()
+{
+    SmallShell& smash = SmallShell::getInstance();
+
+    // If no arguments provided, print all aliases
+    if (this->getArgsNum() == 1) {
+        smash.printAllAliases();
+        return;
+    }
+
+    // Parse command using Regex to extract name and command
+    // Format: alias name='command'
+    static const std::regex re(R"(^\s*alias\s+([A-Za-z0-9_]+)='([^']*)'\s*$)");
+
+    std::smatch m;
+    std::string line = getCmdLine();
+
+    if (!std::regex_match(line, m, re)) {
+        std::cerr << "smash error: alias: invalid alias format" << std::endl;
+        builtinFailed();
+        return;
+    }
+
+    std::string name = m[1];
+    std::string body = m[2];
+
+    // Validation: Ensure name is not a reserved word or existing alias
+    if (smash.isReservedWord(name) || smash.isAlias(name)) {
+        std::cerr << "smash error: alias: " << name
+                  << " already exists or is a reserved command" << std::endl;
+        builtinFailed();
+        return;
+    }
+
+    // Add the new alias
+    smash.addAlias(name, body);
+}
+
+// ==================================================================================
+//                           Class: UnAliasCommand
+// ==================================================================================
+void UnAliasCommand::execute() {
+    SmallShell &smash = SmallShell::getInstance();
 
-            if (smash.isContainsBGJob(i)) {
-                cout << smash.getBGjobPidById(i) << ": " << smash.getBGJobPrintMsgByJobId(i) << endl;
-                continue;
-            } else if (i == smash.getCJobId()) {
-                cout << smash.getCJPid() << ": " << smash.getCJPrintCommandLine() << endl;
-                continue;
-            }
-            throw (std::runtime_error("error accured in quit command"));
+    // Validate arguments count
+    if (this->getArgsNum() <= 1) {
+        cerr << "smash error: unalias: not enough arguments" << endl;
+        builtinFailed();
+        return;
+    }
+
+    // Iterate over arguments and remove aliases
+    for (int i = 1; i < this->getArgsNum(); ++i) {
+        string aliasName = this->getArg(i);
+
+        if (smash.isAlias(aliasName)) {
+            smash.removeAlias(aliasName);
+        } else {
+            // Stop at first error as per assignment logic implies (or just report it)
+            cerr << "smash error: unalias: " << aliasName << " alias does not exist" << endl;
+            builtinFailed();
+            return;
         }
+    }
+}
 
-        // Perform the actual killing
-        smash.killAllBGJobsWithoutPrint();
+// ==================================================================================
+//                           Class: AssignmentCommand
+// ==================================================================================
+
+void AssignmentCommand::execute() {
+    SmallShell &smash = SmallShell::getInstance();
+
+    for (const auto &word : getArgs()) {
+        std::size_t eq = word.find('=');
+        smash.assignVariable(word.substr(0, eq), word.substr(eq + 1));
     }
+}
 
-    // 3. Exit the shell
-    exit(0);
+// ==================================================================================
+//                           Class: FunctionCommand
+// ==================================================================================
+
+void FunctionCommand::execute() {
+    Script::callFunction(getArgs());
 }
 
-void KillCommand::execute()
-{
-    SmallShell& smash = SmallShell::getInstance();
+// ==================================================================================
+//                           Class: UnSetEnvCommand
+// ==================================================================================
 
-    //  Validate Argument Count
-    if (getArgsNum() != 3) {
-        cerr << "smash error: kill: invalid arguments" << endl;
+UnSetEnvCommand::UnSetEnvCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {
+    // Constructor passthrough
+}
+
+void UnSetEnvCommand::execute() {
+    // Validate arguments count
+    if (getArgsNum() == 1) {
+        std::cerr << "smash error: unsetenv: not enough arguments\n";
+        builtinFailed();
         return;
     }
 
-    // Parse Signal Argument
-    std::string sig_str = getArg(1);
-    if (sig_str.empty()) {
-        cerr << "smash error: kill: invalid arguments" << endl;
+    Environment &env = SmallShell::getInstance().getEnvironment();
+    for (int i = 1; i < getArgsNum(); ++i) {
+        std::string varName = getArg(i);
+        if (!env.unset(varName)) {
+            std::cerr << "smash error: unsetenv: "
+                      << varName << " does not exist\n";
+            builtinFailed();
+            return;
+        }
+    }
+}
+
+// ==================================================================================
+//                           Class: SetEnvCommand
+// ==================================================================================
+
+void SetEnvCommand::execute() {
+    if (getArgsNum() < 2 || getArgsNum() > 3 || !_isAssignmentWord(getArg(1).str() + "=")) {
+        std::cerr << "smash error: setenv: invalid arguments\n";
+        builtinFailed();
         return;
-    } else if (sig_str[0] != '-') {
-        cerr << "smash error: kill: invalid arguments" << endl;
+    }
+
+    SmallShell &smash = SmallShell::getInstance();
+    std::string name = getArg(1);
+    smash.getEnvironment().set(name, getArgsNum() == 3 ? getArg(2).str() : "");
+    smash.unsetVariable(name);
+}
+
+// ==================================================================================
+//                           Class: ExportCommand
+// ==================================================================================
+
+void ExportCommand::execute() {
+    SmallShell &smash = SmallShell::getInstance();
+    Environment &env = smash.getEnvironment();
+
+    if (getArgsNum() == 1) {
+        env.print(std::cout);
         return;
     }
 
-    int sig_num;
-    try {
-        sig_num = std::stoi(sig_str.substr(1));
-    } catch (...) {
-        cerr << "smash error: kill: invalid arguments" << endl;
+    for (int i = 1; i < getArgsNum(); ++i) {
+        std::string word = getArg(i);
+        std::size_t eq = word.find('=');
+        std::string name = word.substr(0, eq);
+        if (!_isAssignmentWord(name + "=")) {
+            std::cerr << "smash error: export: " << word << ": not a valid identifier\n";
+            builtinFailed();
+            continue;
+        }
+
+        // 'export NAME' moves the shell variable (or an empty value) into the environment
+        if (eq != std::string::npos) {
+            env.set(name, word.substr(eq + 1));
+        } else if (const std::string *value = smash.findVariable(name)) {
+            env.set(name, *value);
+        } else if (env.find(name) == nullptr) {
+            env.set(name, "");
+        }
+        smash.unsetVariable(name);
+    }
+}
+
+// ==================================================================================
+//                           Class: EnvCommand
+// ==================================================================================
+
+void EnvCommand::execute() {
+    SmallShell::getInstance().getEnvironment().print(std::cout);
+}
+
+// ==================================================================================
+//                           Class: UlimitCommand
+// ==================================================================================
+
+struct UlimitResource {
+    char flag;
+    int resource;
+    rlim_t unit;        // bytes per displayed unit
+    const char *name;
+};
+
+static const UlimitResource ulimitResources[] = {
+    {'c', RLIMIT_CORE,    1024, "core file size          (kbytes, -c)"},
+    {'d', RLIMIT_DATA,    1024, "data seg size           (kbytes, -d)"},
+    {'f', RLIMIT_FSIZE,   1024, "file size               (kbytes, -f)"},
+    {'l', RLIMIT_MEMLOCK, 1024, "max locked memory       (kbytes, -l)"},
+    {'n', RLIMIT_NOFILE,  1,    "open files                      (-n)"},
+    {'s', RLIMIT_STACK,   1024, "stack size              (kbytes, -s)"},
+    {'t', RLIMIT_CPU,     1,    "cpu time               (seconds, -t)"},
+    {'u', RLIMIT_NPROC,   1,    "max user processes              (-u)"},
+    {'v', RLIMIT_AS,      1024, "virtual memory          (kbytes, -v)"},
+};
+
+static void printLimitValue(rlim_t value, rlim_t unit) {
+    if (value == RLIM_INFINITY) cout << "unlimited";
+    else cout << (unsigned long long) (value / unit);
+}
+
+void UlimitCommand::execute() {
+    bool hard = false, soft = false, all = false;
+    const UlimitResource *target = nullptr;
+    std::string value;
+    int values = 0;
+
+    for (int i = 1; i < getArgsNum(); ++i) {
+        std::string arg = getArg(i);
+        if (arg.size() < 2 || arg[0] != '-') {
+            value = arg;
+            ++values;
+            continue;
+        }
+        for (std::size_t j = 1; j < arg.size(); ++j) {
+            if (arg[j] == 'H') { hard = true; continue; }
+            if (arg[j] == 'S') { soft = true; continue; }
+            if (arg[j] == 'a') { all = true; continue; }
+
+            const UlimitResource *found = nullptr;
+            for (const auto &res : ulimitResources)
+                if (res.flag == arg[j]) found = &res;
+            if (found == nullptr || (target != nullptr && target != found)) {
+                cerr << "smash error: ulimit: invalid arguments" << endl;
+                builtinFailed();
+                return;
+            }
+            target = found;
+        }
+    }
+    if (values > 1 || (all && values > 0)) {
+        cerr << "smash error: ulimit: invalid arguments" << endl;
+        builtinFailed();
         return;
     }
 
-    //  Parse Job ID Argument
-    int job_id;
-    try {
-        job_id = std::stoi(getArg(2));
-    } catch (...) {
-        cerr << "smash error: kill: invalid arguments" << endl;
+    if (all) {
+        for (const auto &res : ulimitResources) {
+            struct rlimit rl;
+            if (getrlimit(res.resource, &rl) == -1) continue;
+            cout << res.name << " ";
+            printLimitValue(hard ? rl.rlim_max : rl.rlim_cur, res.unit);
+            cout << endl;
+        }
         return;
     }
 
-    //  Validate Job Logic
-    if (job_id < 0) {
-        cerr << "smash error: kill: invalid arguments" << endl;
+    // Like other shells: -f is the default resource
+    if (target == nullptr) target = &ulimitResources[2];
+
+    struct rlimit rl;
+    if (getrlimit(target->resource, &rl) == -1) {
+        perror("smash error: getrlimit failed");
+        builtinFailed();
         return;
     }
-    if (job_id == 0) {
-        cerr << "smash error: kill: job-id " << job_id << " does not exist" << endl;
+    if (value.empty()) {
+        printLimitValue(hard ? rl.rlim_max : rl.rlim_cur, target->unit);
+        cout << endl;
         return;
     }
 
-    if (!smash.isContainsBGJob(job_id)) {
-        cerr << "smash error: kill: job-id " << job_id << " does not exist" << endl;
+    rlim_t newValue = RLIM_INFINITY;
+    if (value != "unlimited") {
+        int number;
+        if (!isNumber(value, &number) || number < 0) {
+            cerr << "smash error: ulimit: " << value << ": invalid number" << endl;
+            builtinFailed();
+            return;
+        }
+        newValue = (rlim_t) number * target->unit;
+    }
+
+    // Neither -H nor -S: both, as in other shells
+    if (hard || !soft) rl.rlim_max = newValue;
+    if (soft || !hard) rl.rlim_cur = newValue;
+    if (setrlimit(target->resource, &rl) == -1) {
+        perror("smash error: setrlimit failed");
+        builtinFailed();
+    }
+}
+
+// ==================================================================================
+//                                Core Utilities
+// ==================================================================================
+
+/**
+ * Appends the backslash escape that starts at text[i] to 'out' and returns the index
+ * after it. 'echoStyle' selects echo's octal form (\0nnn) over printf's (\nnn).
+ * '\c' sets 'stop': nothing more is printed.
+ */
+static std::size_t appendEscape(const std::string &text, std::size_t i, std::string &out,
+                                bool echoStyle, bool &stop)
+{
+    std::size_t j = i + 1;
+    if (j >= text.size()) {
+        out += '\\';
+        return j;
+    }
+
+    char c = text[j++];
+    switch (c) {
+        case 'a':  out += '\a'; return j;
+        case 'b':  out += '\b'; return j;
+        case 'e':  out += '\033'; return j;
+        case 'f':  out += '\f'; return j;
+        case 'n':  out += '\n'; return j;
+        case 'r':  out += '\r'; return j;
+        case 't':  out += '\t'; return j;
+        case 'v':  out += '\v'; return j;
+        case '\\': out += '\\'; return j;
+        case 'c':
+            stop = true;
+            return text.size();
+        case 'x': {
+            int value = 0, digits = 0;
+            while (digits < 2 && j < text.size() && isxdigit((unsigned char) text[j])) {
+                char h = text[j++];
+                value = value * 16 + (isdigit((unsigned char) h) ? h - '0' : (tolower(h) - 'a' + 10));
+                ++digits;
+            }
+            if (digits == 0) out += "\\x";
+            else out += (char) value;
+            return j;
+        }
+        default:
+            break;
+    }
+
+    if (c >= '0' && c <= '7' && (!echoStyle || c == '0')) {
+        // echo: \0 plus up to three digits; printf: up to three digits in all
+        int value = echoStyle ? 0 : c - '0';
+        int maxDigits = echoStyle ? 3 : 2;
+        for (int d = 0; d < maxDigits && j < text.size() && text[j] >= '0' && text[j] <= '7'; ++d) {
+            value = value * 8 + (text[j++] - '0');
+        }
+        out += (char) value;
+        return j;
+    }
+
+    out += '\\';
+    out += c;
+    return j;
+}
+
+static std::string expandEscapes(const std::string &text, bool echoStyle, bool &stop) {
+    std::string out;
+    std::size_t i = 0;
+    while (i < text.size() && !stop) {
+        if (text[i] == '\\') i = appendEscape(text, i, out, echoStyle, stop);
+        else out += text[i++];
+    }
+    return out;
+}
+
+// ----------------------------------- echo ---------------------------------------
+
+void EchoCommand::execute() {
+    const ArgList &args = getArgs();
+    bool newline = true;
+    bool escapes = false;
+
+    // Only words made entirely of n/e/E flags are options: 'echo -x' prints "-x"
+    std::size_t first = 1;
+    for (; first < args.size(); ++first) {
+        const ArgRef &arg = args[first];
+        if (arg.size() < 2 || arg[0] != '-' || strspn(arg.c_str() + 1, "neE") != arg.size() - 1) break;
+        for (std::size_t j = 1; j < arg.size(); ++j) {
+            if (arg[j] == 'n') newline = false;
+            else escapes = (arg[j] == 'e');
+        }
+    }
+
+    // Straight from the arguments into the batched output - no copy of the line
+    bool stop = false;
+    for (std::size_t i = first; i < args.size() && !stop; ++i) {
+        if (i > first) cout.put(' ');
+        if (escapes) {
+            std::string text = expandEscapes(args[i], true, stop);
+            cout.write(text.data(), text.size());
+        } else {
+            cout.write(args[i].data(), args[i].size());
+        }
+    }
+    if (newline && !stop) cout.put('\n');
+    cout.flush();
+}
+
+// ---------------------------------- printf --------------------------------------
+
+template <typename T>
+static void appendFormatted(std::string &out, const std::string &spec, T value) {
+    int len = snprintf(nullptr, 0, spec.c_str(), value);
+    if (len <= 0) return;
+    std::vector<char> buf(len + 1);
+    snprintf(buf.data(), buf.size(), spec.c_str(), value);
+    out.append(buf.data(), len);
+}
+
+/**
+ * printf's numeric argument: decimal/octal/hex, or 'c / "c for a character code.
+ */
+static long long printfInteger(const std::string &arg, bool &failed) {
+    if (arg.empty()) return 0;
+    if (arg[0] == '\'' || arg[0] == '"') return arg.size() > 1 ? (unsigned char) arg[1] : 0;
+
+    char *end = nullptr;
+    errno = 0;
+    long long value = strtoll(arg.c_str(), &end, 0);
+    if (errno != 0 || *end != '\0') {
+        cerr << "smash error: printf: " << arg << ": invalid number" << endl;
+        failed = true;
+    }
+    return value;
+}
+
+static double printfFloat(const std::string &arg, bool &failed) {
+    if (arg.empty()) return 0.0;
+    if (arg[0] == '\'' || arg[0] == '"') return arg.size() > 1 ? (unsigned char) arg[1] : 0;
+
+    char *end = nullptr;
+    errno = 0;
+    double value = strtod(arg.c_str(), &end);
+    if (errno != 0 || *end != '\0') {
+        cerr << "smash error: printf: " << arg << ": invalid number" << endl;
+        failed = true;
+    }
+    return value;
+}
+
+void PrintfCommand::execute() {
+    const ArgList &args = getArgs();
+    if (args.size() < 2) {
+        cerr << "smash error: printf: missing format" << endl;
+        builtinFailed();
         return;
     }
 
-    // 5. Send Signal
-    pid_t pid = smash.getBGjobPidById(job_id);
-    cout << "signal number " << sig_num << " was sent to pid " << pid << endl;
+    const string &format = args[1];
+    std::size_t argIndex = 2;
+    auto nextArg = [&]() -> string {
+        return (argIndex < args.size()) ? args[argIndex++] : string();
+    };
+
+    std::string out;
+    bool failed = false;
+    bool stop = false;
+    do {
+        std::size_t before = argIndex;
+        std::size_t i = 0;
+        while (i < format.size() && !stop) {
+            char c = format[i];
+            if (c == '\\') {
+                i = appendEscape(format, i, out, false, stop);
+                continue;
+            }
+            if (c != '%') {
+                out += c;
+                ++i;
+                continue;
+            }
+            if (i + 1 < format.size() && format[i + 1] == '%') {
+                out += '%';
+                i += 2;
+                continue;
+            }
 
-    if (kill(pid, sig_num) == -1) {
-        perror("smash error: kill failed");
+            // %[flags][width][.precision]conversion - '*' takes the value from an argument
+            std::string spec = "%";
+            ++i;
+            while (i < format.size() && strchr("-+ #0", format[i]) != nullptr) spec += format[i++];
+            if (i < format.size() && format[i] == '*') {
+                spec += std::to_string(printfInteger(nextArg(), failed));
+                ++i;
+            } else {
+                while (i < format.size() && isdigit((unsigned char) format[i])) spec += format[i++];
+            }
+            if (i < format.size() && format[i] == '.') {
+                spec += format[i++];
+                if (i < format.size() && format[i] == '*') {
+                    spec += std::to_string(printfInteger(nextArg(), failed));
+                    ++i;
+                } else {
+                    while (i < format.size() && isdigit((unsigned char) format[i])) spec += format[i++];
+                }
+            }
+            if (i >= format.size()) {
+                cerr << "smash error: printf: " << spec << ": missing conversion" << endl;
+                builtinFailed();
+                return;
+            }
+
+            char conv = format[i++];
+            switch (conv) {
+                case 'd': case 'i':
+                    appendFormatted(out, spec + "lld", printfInteger(nextArg(), failed));
+                    break;
+                case 'o': case 'u': case 'x': case 'X':
+                    appendFormatted(out, spec + "ll" + conv,
+                                    (unsigned long long) printfInteger(nextArg(), failed));
+                    break;
+                case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+                    appendFormatted(out, spec + conv, printfFloat(nextArg(), failed));
+                    break;
+                case 'c': {
+                    string arg = nextArg();
+                    if (!arg.empty()) appendFormatted(out, spec + "c", (int) (unsigned char) arg[0]);
+                    break;
+                }
+                case 's':
+                    appendFormatted(out, spec + "s", nextArg().c_str());
+                    break;
+                case 'b': {
+                    string expanded = expandEscapes(nextArg(), true, stop);
+                    appendFormatted(out, spec + "s", expanded.c_str());
+                    break;
+                }
+                default:
+                    cout.write(out.data(), out.size());
+                    cout.flush();
+                    cerr << "smash error: printf: %" << conv << ": invalid directive" << endl;
+                    builtinFailed();
+                    return;
+            }
+        }
+
+        // The format is reused while it keeps consuming arguments
+        if (argIndex == before) break;
+    } while (argIndex < args.size() && !stop);
+
+    cout.write(out.data(), out.size());
+    cout.flush();
+    if (failed) builtinFailed();
+}
+
+// ----------------------------------- test ---------------------------------------
+
+static bool isUnaryTestOp(const ArgRef &op) {
+    return op.size() == 2 && op[0] == '-' && strchr("bcdefghLkprsStuwxzn", op[1]) != nullptr;
+}
+
+static bool isBinaryTestOp(const ArgRef &op) {
+    static const char *const ops[] = {"=", "==", "!=", "<", ">", "-eq", "-ne", "-lt", "-le",
+                                      "-gt", "-ge", "-nt", "-ot", "-ef"};
+    for (const char *known : ops)
+        if (op == known) return true;
+    return false;
+}
+
+// Evaluates a 'test' expression. Errors print a message and set m_error (status 2).
+class TestEvaluator {
+private:
+    const ArgList &m_args;
+    std::size_t m_pos;
+    std::size_t m_end;
+    bool m_error;
+
+    bool fail(const std::string &message) {
+        if (!m_error) cerr << "smash error: test: " << message << endl;
+        m_error = true;
+        return false;
+    }
+
+    bool toInteger(const ArgRef &text, long long &value) {
+        // Blanks around the number are allowed
+        const char *s = text.c_str() + strspn(text.c_str(), WHITESPACE_CHARS);
+        char *end = nullptr;
+        errno = 0;
+        value = strtoll(s, &end, 10);
+        bool valid = (*s != '\0' && errno == 0 && end != s);
+        if (valid) end += strspn(end, WHITESPACE_CHARS);
+        if (!valid || *end != '\0') return fail(text.str() + ": integer expression expected");
+        return true;
+    }
+
+    bool unary(const ArgRef &op, const ArgRef &arg) {
+        struct stat st;
+        switch (op[1]) {
+            case 'z': return arg.empty();
+            case 'n': return !arg.empty();
+            case 't': {
+                long long fd;
+                return toInteger(arg, fd) && isatty((int) fd);
+            }
+            case 'r': return access(arg.c_str(), R_OK) == 0;
+            case 'w': return access(arg.c_str(), W_OK) == 0;
+            case 'x': return access(arg.c_str(), X_OK) == 0;
+            case 'h': case 'L': return lstat(arg.c_str(), &st) == 0 && S_ISLNK(st.st_mode);
+            default: break;
+        }
+        if (stat(arg.c_str(), &st) != 0) return false;
+        switch (op[1]) {
+            case 'e': return true;
+            case 'f': return S_ISREG(st.st_mode);
+            case 'd': return S_ISDIR(st.st_mode);
+            case 'b': return S_ISBLK(st.st_mode);
+            case 'c': return S_ISCHR(st.st_mode);
+            case 'p': return S_ISFIFO(st.st_mode);
+            case 'S': return S_ISSOCK(st.st_mode);
+            case 's': return st.st_size > 0;
+            case 'g': return (st.st_mode & S_ISGID) != 0;
+            case 'u': return (st.st_mode & S_ISUID) != 0;
+            case 'k': return (st.st_mode & S_ISVTX) != 0;
+            default:  return false;
+        }
+    }
+
+    bool binary(const ArgRef &lhs, const ArgRef &op, const ArgRef &rhs) {
+        if (op == "=" || op == "==") return lhs == rhs;
+        if (op == "!=") return lhs != rhs;
+        if (op == "<") return strcmp(lhs.c_str(), rhs.c_str()) < 0;
+        if (op == ">") return strcmp(lhs.c_str(), rhs.c_str()) > 0;
+
+        if (op == "-nt" || op == "-ot" || op == "-ef") {
+            struct stat a, b;
+            bool hasA = stat(lhs.c_str(), &a) == 0;
+            bool hasB = stat(rhs.c_str(), &b) == 0;
+            if (op == "-ef") return hasA && hasB && a.st_dev == b.st_dev && a.st_ino == b.st_ino;
+            if (op == "-nt") return hasA && (!hasB || a.st_mtime > b.st_mtime);
+            return hasB && (!hasA || a.st_mtime < b.st_mtime);
+        }
+
+        long long l, r;
+        if (!toInteger(lhs, l) || !toInteger(rhs, r)) return false;
+        if (op == "-eq") return l == r;
+        if (op == "-ne") return l != r;
+        if (op == "-lt") return l < r;
+        if (op == "-le") return l <= r;
+        if (op == "-gt") return l > r;
+        return l >= r;
+    }
+
+    // ------------------- General grammar (more than four words) -------------------
+    //   or := and ('-o' and)* ; and := not ('-a' not)* ; not := '!' not | primary
+    //   primary := '(' or ')' | unary-op word | word binary-op word | word
+
+    bool parseOr() {
+        bool value = parseAnd();
+        while (m_pos < m_end && m_args[m_pos] == "-o") {
+            ++m_pos;
+            bool rhs = parseAnd();
+            value = value || rhs;
+        }
+        return value;
+    }
+
+    bool parseAnd() {
+        bool value = parseNot();
+        while (m_pos < m_end && m_args[m_pos] == "-a") {
+            ++m_pos;
+            bool rhs = parseNot();
+            value = value && rhs;
+        }
+        return value;
+    }
+
+    bool parseNot() {
+        if (m_pos < m_end && m_args[m_pos] == "!") {
+            ++m_pos;
+            return !parseNot();
+        }
+        return parsePrimary();
+    }
+
+    bool parsePrimary() {
+        if (m_pos >= m_end) return fail("argument expected");
+
+        const ArgRef &word = m_args[m_pos];
+        if (word == "(") {
+            ++m_pos;
+            bool value = parseOr();
+            if (m_pos >= m_end || m_args[m_pos] != ")") return fail("')' expected");
+            ++m_pos;
+            return value;
+        }
+        if (m_pos + 2 < m_end && isBinaryTestOp(m_args[m_pos + 1])) {
+            m_pos += 3;
+            return binary(word, m_args[m_pos - 2], m_args[m_pos - 1]);
+        }
+        if (isUnaryTestOp(word) && m_pos + 1 < m_end) {
+            m_pos += 2;
+            return unary(word, m_args[m_pos - 1]);
+        }
+        ++m_pos;
+        return !word.empty();
+    }
+
+    // POSIX fixes the meaning of up to four words by their count
+    bool evaluate(std::size_t begin, std::size_t end) {
+        std::size_t n = end - begin;
+        const ArgList &a = m_args;
+        switch (n) {
+            case 0:
+                return false;
+            case 1:
+                return !a[begin].empty();
+            case 2:
+                if (a[begin] == "!") return a[begin + 1].empty();
+                if (isUnaryTestOp(a[begin])) return unary(a[begin], a[begin + 1]);
+                return fail(a[begin].str() + ": unary operator expected");
+            case 3:
+                if (isBinaryTestOp(a[begin + 1])) return binary(a[begin], a[begin + 1], a[begin + 2]);
+                if (a[begin + 1] == "-a") return !a[begin].empty() && !a[begin + 2].empty();
+                if (a[begin + 1] == "-o") return !a[begin].empty() || !a[begin + 2].empty();
+                if (a[begin] == "!") return !evaluate(begin + 1, end);
+                if (a[begin] == "(" && a[end - 1] == ")") return !a[begin + 1].empty();
+                return fail(a[begin + 1].str() + ": binary operator expected");
+            case 4:
+                if (a[begin] == "!") return !evaluate(begin + 1, end);
+                if (a[begin] == "(" && a[end - 1] == ")") return evaluate(begin + 1, end - 1);
+                break;
+            default:
+                break;
+        }
+
+        m_pos = begin;
+        m_end = end;
+        bool value = parseOr();
+        if (m_pos != m_end) return fail(m_args[m_pos].str() + ": unexpected argument");
+        return value;
+    }
+
+public:
+    explicit TestEvaluator(const ArgList &args) : m_args(args), m_pos(0), m_end(0), m_error(false) {}
+
+    // Status of the words [begin, end): 0 true, 1 false, 2 error
+    int run(std::size_t begin, std::size_t end) {
+        bool value = evaluate(begin, end);
+        return m_error ? 2 : (value ? 0 : 1);
+    }
+};
+
+void TestCommand::execute() {
+    SmallShell &smash = SmallShell::getInstance();
+    const ArgList &args = getArgs();
+
+    std::size_t end = args.size();
+    if (args[0] == "[") {
+        if (args.back() != "]" || args.size() < 2) {
+            cerr << "smash error: [: missing ']'" << endl;
+            smash.setLastStatus(2);
+            return;
+        }
+        --end;
+    }
+
+    TestEvaluator evaluator(args);
+    smash.setLastStatus(evaluator.run(1, end));
+}
+
+// ------------------------------- true / false -----------------------------------
+
+void StatusCommand::execute() {
+    SmallShell::getInstance().setLastStatus(m_status);
+}
+
+// ----------------------------------- sleep --------------------------------------
+
+void SleepCommand::execute() {
+    SmallShell &smash = SmallShell::getInstance();
+    if (getArgsNum() < 2) {
+        cerr << "smash error: sleep: missing operand" << endl;
+        builtinFailed();
         return;
     }
-}
-// ==================================================================================
-//                        Shell Environment Commands
-// ==================================================================================
 
-// ==================================================================================
-//                           Class: ChpromtCommand
-// ==================================================================================
+    // Every operand is added up: 'sleep 1m 30s'
+    double total = 0.0;
+    for (int i = 1; i < getArgsNum(); ++i) {
+        std::string arg = getArg(i);
+        char *end = nullptr;
+        double value = strtod(arg.c_str(), &end);
+        double unit = -1.0;
+        if (end != arg.c_str() && value >= 0 && !std::isnan(value)) {
+            if (*end == '\0' || strcmp(end, "s") == 0) unit = 1.0;
+            else if (strcmp(end, "m") == 0) unit = 60.0;
+            else if (strcmp(end, "h") == 0) unit = 3600.0;
+            else if (strcmp(end, "d") == 0) unit = 86400.0;
+        }
+        if (unit < 0) {
+            cerr << "smash error: sleep: invalid time interval '" << arg << "'" << endl;
+            builtinFailed();
+            return;
+        }
+        total += value * unit;
+    }
 
-ChpromtCommand::ChpromtCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {
-    if (getArgsNum() > 1) {
-        m_promptMsg = getArg(1);
-    } else {
-        m_promptMsg = "smash";
+    // An absolute deadline: being woken by a signal never stretches the sleep
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    double whole = std::floor(total);
+    deadline.tv_sec += (whole > 1e12) ? (time_t) 1e12 : (time_t) whole;
+    deadline.tv_nsec += (long) ((total - whole) * 1e9);
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec += 1;
+        deadline.tv_nsec -= 1000000000L;
     }
-}
 
-void ChpromtCommand::execute() {
-    SmallShell::getInstance().setPrompt(m_promptMsg + "> ");
+    smash.setInterrupted(false);
+    ShellOutput::flush();
+    while (true) {
+#ifdef __APPLE__
+        // No clock_nanosleep: sleep for what is left of the deadline
+        struct timespec now, left;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        left.tv_sec = deadline.tv_sec - now.tv_sec;
+        left.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+        if (left.tv_nsec < 0) {
+            left.tv_sec -= 1;
+            left.tv_nsec += 1000000000L;
+        }
+        if (left.tv_sec < 0) return;
+        int rc = (nanosleep(&left, nullptr) == 0) ? 0 : errno;
+#else
+        int rc = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr);
+#endif
+        if (rc == 0) return;
+        if (rc != EINTR) {
+            errno = rc;
+            perror("smash error: clock_nanosleep failed");
+            builtinFailed();
+            return;
+        }
+        // ctrl-C ends the sleep like it would kill an external one
+        if (smash.isInterrupted()) {
+            smash.setLastStatus(128 + SIGINT);
+            return;
+        }
+    }
 }
 
-// ==================================================================================
-//                           Class: ShowPidCommand
-// ==================================================================================
-
-ShowPidCommand::ShowPidCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {}
-
-void ShowPidCommand::execute() {
-    std::cout << "smash pid is " << getpid() << std::endl;
+// ------------------------------- text filters -----------------------------------
+
+/**
+ * Parses a count option value: plain decimal digits only (suffixes, signs and '+N'
+ * are left to the real program).
+ */
+static bool parseFilterCount(const string &text, unsigned long long &out) {
+    if (text.empty() || text.find_first_not_of("0123456789") != string::npos) return false;
+    errno = 0;
+    out = strtoull(text.c_str(), nullptr, 10);
+    return errno == 0;
 }
 
-// ==================================================================================
-//                           Class: GetCurrDirCommand
-// ==================================================================================
+/**
+ * Name shown for an input in headers and prefixes ("-" is stdin).
+ */
+static string filterInputName(const string &file) {
+    return (file == "-") ? "standard input" : file;
+}
 
-GetCurrDirCommand::GetCurrDirCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {}
+/**
+ * Options shared by head and tail: -n N, -nN, -c N, -cN, -N. False if anything
+ * else is given, so the real program runs.
+ */
+static bool parseHeadTailOptions(const ArgList &args, unsigned long long &count, bool &bytes,
+                                 vector<string> &files) {
+    count = 10;
+    bytes = false;
+    bool options = true;
+    for (std::size_t i = 1; i < args.size(); ++i) {
+        const string &arg = args[i];
+        if (!options || arg.size() < 2 || arg[0] != '-') {
+            files.push_back(arg);
+            continue;
+        }
+        if (arg == "--") {
+            options = false;
+        } else if (arg[1] == 'n' || arg[1] == 'c') {
+            bytes = (arg[1] == 'c');
+            string value = arg.substr(2);
+            if (value.empty()) {
+                if (i + 1 >= args.size()) return false;
+                value = args[++i];
+            }
+            if (!parseFilterCount(value, count)) return false;
+        } else if (!parseFilterCount(arg.substr(1), count)) {
+            return false;
+        } else {
+            bytes = false;
+        }
+    }
+    if (files.empty()) files.push_back("-");
+    return true;
+}
 
-void GetCurrDirCommand::execute() {
+/**
+ * True (and $? = 130) once ctrl-C was pressed during a filter.
+ */
+static bool filterInterrupted() {
     SmallShell &smash = SmallShell::getInstance();
-    cout << smash.getCurrentPwd() << std::endl;
+    if (!smash.isInterrupted()) return false;
+    smash.setLastStatus(128 + SIGINT);
+    return true;
 }
 
-// ==================================================================================
-//                           Class: ChangeDirCommand
-// ==================================================================================
+// ------------------------------------ wc ----------------------------------------
+
+static bool parseWcOptions(const ArgList &args, bool &lines, bool &words, bool &bytes,
+                           vector<string> &files) {
+    lines = words = bytes = false;
+    bool options = true;
+    for (std::size_t i = 1; i < args.size(); ++i) {
+        const string &arg = args[i];
+        if (options && arg == "--") {
+            options = false;
+        } else if (options && arg.size() > 1 && arg[0] == '-') {
+            for (std::size_t j = 1; j < arg.size(); ++j) {
+                if (arg[j] == 'l') lines = true;
+                else if (arg[j] == 'w') words = true;
+                else if (arg[j] == 'c') bytes = true;
+                else return false;
+            }
+        } else {
+            files.push_back(arg);
+        }
+    }
+    if (!lines && !words && !bytes) lines = words = bytes = true;
+    return true;
+}
 
-ChangeDirCommand::ChangeDirCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {
-    int args_num = getArgsNum();
+bool WcCommand::handles(const ArgList &args) {
+    bool lines, words, bytes;
+    vector<string> files;
+    return parseWcOptions(args, lines, words, bytes, files);
+}
 
-    if (args_num > 2) {
-        cerr << "smash error: cd: too many arguments" << endl;
-        m_dir = "";
-    }
-    else if (args_num == 2) {
-        m_dir = getArg(1);
+void WcCommand::execute() {
+    bool lines, words, bytes;
+    vector<string> files;
+    parseWcOptions(getArgs(), lines, words, bytes, files);
+    bool named = !files.empty();
+    if (!named) files.push_back("-");
+
+    struct Counts {
+        unsigned long long values[3];   // lines, words, bytes
+        string name;
+    };
+    vector<Counts> results;
+    Counts total = {{0, 0, 0}, "total"};
+    bool failed = false;
+    bool irregular = false;
+    long long totalSize = 0;
+    SmallShell::getInstance().setInterrupted(false);
+
+    for (const string &file : files) {
+        TextInput input("wc", file);
+        if (!input.ok()) {
+            failed = true;
+            continue;
+        }
+        if (input.regularSize() < 0) irregular = true;
+        else totalSize += input.regularSize();
+
+        Counts counts = {{0, 0, 0}, file};
+        bool inWord = false;
+        const char *data;
+        std::size_t len;
+        while (input.next(data, len)) {
+            if (filterInterrupted()) return;
+            if (lines) counts.values[0] += TextScan::countLines(data, len);
+            if (words) counts.values[1] += TextScan::countWords(data, len, inWord);
+            counts.values[2] += len;
+        }
+        if (!input.ok()) failed = true;
+        for (int k = 0; k < 3; ++k) total.values[k] += counts.values[k];
+        results.push_back(counts);
     }
-    else {
-        m_dir = "";
+    if (files.size() > 1) results.push_back(total);
+
+    // GNU wc's columns: as wide as the total size of the files, at least 7 wide
+    // once an input is not a regular file, and unpadded for one count of one input
+    bool shown[3] = {lines, words, bytes};
+    int columns = (int) lines + (int) words + (int) bytes;
+    int width = (int) std::to_string(totalSize).size();
+    if (irregular) width = std::max(width, 7);
+    if (columns == 1 && files.size() == 1) width = 1;
+
+    std::ostringstream out;
+    for (const Counts &counts : results) {
+        bool first = true;
+        for (int k = 0; k < 3; ++k) {
+            if (!shown[k]) continue;
+            if (!first) out << ' ';
+            out << std::setw(width) << counts.values[k];
+            first = false;
+        }
+        if (named || &counts != &results.front()) out << ' ' << counts.name;
+        out << '\n';
     }
+    cout << out.str();
+    cout.flush();
+    if (failed) builtinFailed();
 }
 
-void ChangeDirCommand::execute() {
-    SmallShell &smash = SmallShell::getInstance();
+// ----------------------------------- grep ---------------------------------------
+
+namespace {
+
+struct GrepOptions {
+    bool fixed = false;
+    bool invert = false;
+    bool count = false;
+    bool lineNumbers = false;
+    bool quiet = false;
+    string pattern;
+    vector<string> files;
+};
+
+/**
+ * One input's scan: selects lines, counts them and prints them (with the file
+ * name / line number prefixes) into a buffer that goes to cout in large writes.
+ */
+class GrepScan {
+private:
+    const GrepOptions &m_options;
+    string m_prefix;                // "file:" with several inputs
+    unsigned long long m_lineNo;    // lines before the current position (-n only)
+    string m_out;
+
+    void emitLine(const char *start, const char *end) {
+        ++selected;
+        if (m_options.lineNumbers) ++m_lineNo;
+        if (m_options.count || m_options.quiet) return;
+        m_out += m_prefix;
+        if (m_options.lineNumbers) {
+            m_out += std::to_string(m_lineNo);
+            m_out += ':';
+        }
+        m_out.append(start, end - start);
+        if (end == start || end[-1] != '\n') m_out += '\n';
+        if (m_out.size() >= 64 * 1024) flush();
+    }
 
-    // Handle "-" argument (Previous Directory)
-    if (m_dir == "-") {
-        m_dir = smash.getLastPwd();
-        if (m_dir == NO_DIRECTORY_SET) {
-            cerr << "smash error: cd: OLDPWD not set" << endl;
+    // Every line in [start, end) is selected (grep -v between two matches)
+    void emitRange(const char *start, const char *end) {
+        if (start == end) return;
+        bool plain = m_prefix.empty() && !m_options.lineNumbers;
+        if (m_options.count || m_options.quiet || plain) {
+            std::size_t n = TextScan::countLines(start, end - start) + (end[-1] != '\n' ? 1 : 0);
+            selected += n;
+            if (m_options.count || m_options.quiet) return;
+            m_out.append(start, end - start);
+            if (end[-1] != '\n') m_out += '\n';
+            if (m_out.size() >= 64 * 1024) flush();
             return;
         }
+        while (start < end) {
+            const char *newline = static_cast<const char*>(memchr(start, '\n', end - start));
+            const char *lineEnd = newline ? newline + 1 : end;
+            emitLine(start, lineEnd);
+            start = lineEnd;
+        }
     }
 
-    // Handle empty directory (no operation)
-    if (m_dir == "") {
-        return;
+    // Lines in [start, end) that are not selected - only -n needs to know
+    void skipRange(const char *start, const char *end) {
+        if (m_options.lineNumbers && start != end) m_lineNo += TextScan::countLines(start, end - start);
     }
 
-    // Perform change directory syscall
-    if (chdir(m_dir.c_str()) != 0) {
-        perror("smash error: chdir failed");
-        return;
+public:
+    unsigned long long selected;
+
+    GrepScan(const GrepOptions &options, const string &prefix)
+            : m_options(options), m_prefix(prefix), m_lineNo(0), selected(0) {}
+
+    /**
+     * Scans whole lines (the last one may lack its newline at EOF): the pattern is
+     * searched in the block itself, not line by line, and only the lines around a
+     * match are located.
+     */
+    void scan(const char *data, std::size_t len) {
+        const char *pos = data;
+        const char *end = data + len;
+        while (pos < end) {
+            if (m_options.quiet && selected > 0) return;
+            const char *match = TextScan::findFixed(pos, end - pos, m_options.pattern);
+            const char *lineStart = end;
+            if (match != nullptr) {
+                const char *newline = TextScan::findLastNewline(pos, match - pos);
+                lineStart = newline ? newline + 1 : pos;
+            }
+            if (m_options.invert) emitRange(pos, lineStart);
+            else skipRange(pos, lineStart);
+            if (match == nullptr) return;
+
+            const char *newline = static_cast<const char*>(memchr(match, '\n', end - match));
+            const char *lineEnd = newline ? newline + 1 : end;
+            if (m_options.invert) skipRange(lineStart, lineEnd);
+            else emitLine(lineStart, lineEnd);
+            pos = lineEnd;
+        }
     }
 
-    // Update PWD in shell state
-    char cwd[PATH_MAX];
-    if (getcwd(cwd, sizeof(cwd)) == NULL) {
-        perror("smash error: getcwd failed");
-        return;
+    void flush() {
+        cout.write(m_out.data(), m_out.size());
+        m_out.clear();
     }
+};
 
-    smash.setLastPwd(smash.getCurrentPwd());
-    smash.setCurrentPwd(string(cwd));
 }
 
-// ==================================================================================
-//                            Alias & Environment Variables
-// ==================================================================================
-
-// ==================================================================================
-//                           Class: AliasCommand
-// ==================================================================================
-
-
-void AliasCommand::execute()
-{
-    SmallShell& smash = SmallShell::getInstance();
-
-    // If no arguments provided, print all aliases
-    if (this->getArgsNum() == 1) {
-        smash.printAllAliases();
-        return;
+static bool parseGrepOptions(const ArgList &args, GrepOptions &options) {
+    bool havePattern = false;
+    bool flags = true;
+    for (std::size_t i = 1; i < args.size(); ++i) {
+        const string &arg = args[i];
+        if (flags && arg == "--") {
+            flags = false;
+        } else if (flags && arg.size() > 1 && arg[0] == '-') {
+            for (std::size_t j = 1; j < arg.size(); ++j) {
+                if (arg[j] == 'F') options.fixed = true;
+                else if (arg[j] == 'v') options.invert = true;
+                else if (arg[j] == 'c') options.count = true;
+                else if (arg[j] == 'n') options.lineNumbers = true;
+                else if (arg[j] == 'q') options.quiet = true;
+                else return false;
+            }
+        } else if (!havePattern) {
+            options.pattern = arg;
+            havePattern = true;
+        } else {
+            options.files.push_back(arg);
+        }
     }
+    // Several patterns on separate lines are the real grep's business
+    return options.fixed && havePattern && options.pattern.find('\n') == string::npos;
+}
 
-    // Parse command using Regex to extract name and command
-    // Format: alias name='command'
-    static const std::regex re(R"(^\s*alias\s+([A-Za-z0-9_]+)='([^']*)'\s*$)");
+bool GrepCommand::handles(const ArgList &args) {
+    GrepOptions options;
+    return parseGrepOptions(args, options);
+}
 
-    std::smatch m;
-    std::string line = getCmdLine();
+void GrepCommand::execute() {
+    GrepOptions options;
+    parseGrepOptions(getArgs(), options);
+    bool named = options.files.size() > 1;
+    if (options.files.empty()) options.files.push_back("-");
 
-    if (!std::regex_match(line, m, re)) {
-        std::cerr << "smash error: alias: invalid alias format" << std::endl;
-        return;
-    }
+    bool found = false;
+    bool failed = false;
+    SmallShell &smash = SmallShell::getInstance();
+    smash.setInterrupted(false);
 
-    std::string name = m[1];
-    std::string body = m[2];
+    for (const string &file : options.files) {
+        TextInput input("grep", file);
+        if (!input.ok()) {
+            failed = true;
+            continue;
+        }
+        string name = (file == "-") ? "(standard input)" : file;
+        GrepScan scan(options, named ? name + ":" : "");
+
+        // Only whole lines are scanned; a line cut off at the end of a block is kept
+        // and completed by the next one
+        const char *data;
+        std::size_t len;
+        std::size_t keep = 0;
+        while (input.next(data, len, keep)) {
+            if (filterInterrupted()) {
+                scan.flush();
+                return;
+            }
+            std::size_t whole = len;
+            if (!input.atEnd()) {
+                const char *newline = TextScan::findLastNewline(data, len);
+                whole = newline ? newline - data + 1 : 0;
+            }
+            scan.scan(data, whole);
+            keep = len - whole;
+            // The next read of a pipe may block: hand over what matched so far
+            if (input.regularSize() < 0) scan.flush();
+            if (options.quiet && scan.selected > 0) break;
+        }
+        if (!input.ok()) failed = true;
 
-    // Validation: Ensure name is not a reserved word or existing alias
-    if (smash.isReservedWord(name) || smash.isAlias(name)) {
-        std::cerr << "smash error: alias: " << name
-                  << " already exists or is a reserved command" << std::endl;
-        return;
+        if (options.count && !options.quiet) {
+            cout << (named ? name + ":" : "") << scan.selected << '\n';
+        }
+        scan.flush();
+        found = found || scan.selected > 0;
+        if (options.quiet && found) break;
     }
+    cout.flush();
 
-    // Add the new alias
-    smash.addAlias(name, body);
+    // 0: something was selected, 1: nothing was, 2: an input failed (-q with a match wins)
+    if (options.quiet && found) smash.setLastStatus(0);
+    else smash.setLastStatus(failed ? 2 : (found ? 0 : 1));
 }
 
-// ==================================================================================
-//                           Class: UnAliasCommand
-// ==================================================================================
-void UnAliasCommand::execute() {
-    SmallShell &smash = SmallShell::getInstance();
+// ----------------------------------- head ---------------------------------------
 
-    // Validate arguments count
-    if (this->getArgsNum() <= 1) {
-        cerr << "smash error: unalias: not enough arguments" << endl;
-        return;
-    }
+bool HeadCommand::handles(const ArgList &args) {
+    unsigned long long count;
+    bool bytes;
+    vector<string> files;
+    return parseHeadTailOptions(args, count, bytes, files);
+}
 
-    // Iterate over arguments and remove aliases
-    for (int i = 1; i < this->getArgsNum(); ++i) {
-        string aliasName = this->getArg(i);
+void HeadCommand::execute() {
+    unsigned long long count;
+    bool bytes;
+    vector<string> files;
+    parseHeadTailOptions(getArgs(), count, bytes, files);
+
+    bool failed = false;
+    SmallShell::getInstance().setInterrupted(false);
+    for (std::size_t f = 0; f < files.size(); ++f) {
+        TextInput input("head", files[f]);
+        if (!input.ok()) {
+            failed = true;
+            continue;
+        }
+        if (files.size() > 1) {
+            cout << (f > 0 ? "\n" : "") << "==> " << filterInputName(files[f]) << " <==\n";
+        }
 
-        if (smash.isAlias(aliasName)) {
-            smash.removeAlias(aliasName);
-        } else {
-            // Stop at first error as per assignment logic implies (or just report it)
-            cerr << "smash error: unalias: " << aliasName << " alias does not exist" << endl;
-            return;
+        unsigned long long remaining = count;
+        const char *data;
+        std::size_t len;
+        while (remaining > 0 && input.next(data, len)) {
+            if (filterInterrupted()) return;
+            std::size_t take = 0;
+            if (bytes) {
+                take = (std::size_t) std::min<unsigned long long>(len, remaining);
+                remaining -= take;
+            } else {
+                // Whole slices while they hold fewer lines than are still wanted, so a
+                // mapped file is never counted past the lines printed
+                const std::size_t SLICE = 64 * 1024;
+                while (take < len && remaining > 0) {
+                    std::size_t slice = std::min(SLICE, len - take);
+                    std::size_t lines = TextScan::countLines(data + take, slice);
+                    if (lines < remaining) {
+                        remaining -= lines;
+                        take += slice;
+                        continue;
+                    }
+                    const char *p = data + take;
+                    for (; remaining > 0; --remaining) {
+                        p = static_cast<const char*>(memchr(p, '\n', data + take + slice - p)) + 1;
+                    }
+                    take = p - data;
+                }
+            }
+            cout.write(data, take);
+            input.unread(len - take); // a seekable stdin stays right after what was printed
         }
+        if (!input.ok()) failed = true;
     }
+    cout.flush();
+    if (failed) builtinFailed();
 }
 
-// ==================================================================================
-//                           Class: UnSetEnvCommand
-// ==================================================================================
-
-UnSetEnvCommand::UnSetEnvCommand(const char *cmd_line) : BuiltInCommand(cmd_line) {
-    // Constructor passthrough
-}
-
-void UnSetEnvCommand::execute() {
-    // Validate arguments count
-    if (getArgsNum() == 1) {
-        std::cerr << "smash error: unsetenv: not enough arguments\n";
-        return;
+// ----------------------------------- tail ---------------------------------------
+
+/**
+ * Offset in [data, data + len) where its last 'count' lines (or bytes) start.
+ */
+static std::size_t tailStart(const char *data, std::size_t len, unsigned long long count, bool bytes) {
+    if (bytes) return (count < len) ? len - count : 0;
+    if (count == 0) return len;
+    // The last line's own newline does not start another line
+    std::size_t end = (len > 0 && data[len - 1] == '\n') ? len - 1 : len;
+    while (true) {
+        const char *newline = TextScan::findLastNewline(data, end);
+        if (newline == nullptr) return 0;
+        if (--count == 0) return newline - data + 1;
+        end = newline - data;
     }
+}
 
-    int i = 1;
-    while (i < getArgsNum()) {
-        std::string varName = getArg(i);
-        const char* var = varName.c_str();
+bool TailCommand::handles(const ArgList &args) {
+    unsigned long long count;
+    bool bytes;
+    vector<string> files;
+    return parseHeadTailOptions(args, count, bytes, files);
+}
 
-        // Check if environment variable exists
-        if (!envExistsProcfs(var)) {
-            std::cerr << "smash error: unsetenv: "
-                      << varName << " does not exist\n";
-            return;
+void TailCommand::execute() {
+    unsigned long long count;
+    bool bytes;
+    vector<string> files;
+    parseHeadTailOptions(getArgs(), count, bytes, files);
+
+    const std::size_t TRIM_AT = 4 << 20;
+    bool failed = false;
+    SmallShell::getInstance().setInterrupted(false);
+    for (std::size_t f = 0; f < files.size(); ++f) {
+        TextInput input("tail", files[f]);
+        if (!input.ok()) {
+            failed = true;
+            continue;
+        }
+        if (files.size() > 1) {
+            cout << (f > 0 ? "\n" : "") << "==> " << filterInputName(files[f]) << " <==\n";
         }
 
-        // Delete the environment variable
-        deleteEntry(var);
-        i++;
+        // A mapped file is searched backwards from its end in place. A stream keeps
+        // what may still be part of the answer, trimmed once it grows large
+        string kept;
+        const char *data;
+        std::size_t len;
+        while (input.next(data, len)) {
+            if (filterInterrupted()) return;
+            if (kept.empty() && input.atEnd()) {
+                std::size_t start = tailStart(data, len, count, bytes);
+                cout.write(data + start, len - start);
+                len = 0;
+                break;
+            }
+            kept.append(data, len);
+            if (kept.size() >= TRIM_AT) kept.erase(0, tailStart(kept.data(), kept.size(), count, bytes));
+        }
+        if (!kept.empty()) {
+            std::size_t start = tailStart(kept.data(), kept.size(), count, bytes);
+            cout.write(kept.data() + start, kept.size() - start);
+        }
+        if (!input.ok()) failed = true;
     }
+    cout.flush();
+    if (failed) builtinFailed();
 }
 
 // ==================================================================================
@@ -916,6 +3636,7 @@ void WatchProcCommand::execute() {
     // Validate Arguments
     if (getArgsNum() != 2) {
         std::cerr << "smash error: watchproc: invalid arguments\n";
+        builtinFailed();
         return;
     }
     std::string pidStr = getArg(1);
@@ -923,6 +3644,7 @@ void WatchProcCommand::execute() {
     try { pid = std::stoi(pidStr); }
     catch (...) {
         std::cerr << "smash error: watchproc: invalid arguments\n";
+        builtinFailed();
         return;
     }
 
@@ -931,6 +3653,7 @@ void WatchProcCommand::execute() {
     if (!readTotals(pidStr, ut1, st1, stime1, sys1)) {
         std::cerr << "smash error: watchproc: pid " << pid
                   << " does not exist\n";
+        builtinFailed();
         return;
     }
 
@@ -942,6 +3665,7 @@ void WatchProcCommand::execute() {
     if (!readTotals(pidStr, ut2, st2, stime2, sys2)) {
         std::cerr << "smash error: watchproc: pid " << pid
                   << " does not exist\n";
+        builtinFailed();
         return;
     }
 
@@ -969,6 +3693,212 @@ void WatchProcCommand::execute() {
               << std::fixed << std::setprecision(1) << memMB << " MB\n";
 }
 
+// ==================================================================================
+//                           Helpers for Bench
+// ==================================================================================
+
+struct BenchStats {
+    std::vector<double> walls;   // seconds, in run order
+    double meanWall = 0, stddevWall = 0, minWall = 0, medianWall = 0, p95Wall = 0, maxWall = 0;
+    double meanUser = 0, meanSys = 0;
+    long maxRssKb = 0;
+    std::vector<std::size_t> outliers; // indices into walls
+};
+
+static double nearestRank(const std::vector<double> &sorted, double pct) {
+    std::size_t rank = (std::size_t) std::ceil(pct * sorted.size());
+    if (rank == 0) rank = 1;
+    return sorted[std::min(rank, sorted.size()) - 1];
+}
+
+static void computeBenchStats(BenchStats &st, const std::vector<ResourceUsage> &runs) {
+    std::size_t n = runs.size();
+    double sumUser = 0, sumSys = 0, sumWall = 0;
+    for (const auto &r : runs) {
+        st.walls.push_back(r.wallSec);
+        sumWall += r.wallSec;
+        sumUser += r.userSec;
+        sumSys += r.sysSec;
+        st.maxRssKb = std::max(st.maxRssKb, r.maxRssKb);
+    }
+    st.meanWall = sumWall / n;
+    st.meanUser = sumUser / n;
+    st.meanSys = sumSys / n;
+
+    double sq = 0;
+    for (double w : st.walls) sq += (w - st.meanWall) * (w - st.meanWall);
+    st.stddevWall = (n > 1) ? std::sqrt(sq / (n - 1)) : 0.0;
+
+    std::vector<double> sorted = st.walls;
+    std::sort(sorted.begin(), sorted.end());
+    st.minWall = sorted.front();
+    st.maxWall = sorted.back();
+    st.medianWall = (n % 2) ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+    st.p95Wall = nearestRank(sorted, 0.95);
+
+    // Tukey fences: anything beyond 1.5 IQR from the quartiles is an outlier
+    if (n >= 4) {
+        double q1 = nearestRank(sorted, 0.25), q3 = nearestRank(sorted, 0.75);
+        double iqr = q3 - q1;
+        for (std::size_t i = 0; i < n; ++i) {
+            if (st.walls[i] < q1 - 1.5 * iqr || st.walls[i] > q3 + 1.5 * iqr)
+                st.outliers.push_back(i);
+        }
+    }
+}
+
+static std::string formatMs(double seconds) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.3f ms", seconds * 1000.0);
+    return buf;
+}
+
+/**
+ * Runs a command line with its stdout discarded (stderr is kept for errors).
+ */
+static ResourceUsage runBenchIteration(const std::string &cmd_line, int devNull) {
+    SmallShell &smash = SmallShell::getInstance();
+    ShellOutput::flush();
+    int savedStdout = dup(STDOUT_FILENO);
+    if (savedStdout != -1) dup2(devNull, STDOUT_FILENO);
+
+    ResourceUsage usage = smash.executeMeasured(cmd_line.c_str());
+
+    ShellOutput::flush();
+    if (savedStdout != -1) {
+        dup2(savedStdout, STDOUT_FILENO);
+        close(savedStdout);
+    }
+    return usage;
+}
+
+// ==================================================================================
+//                           Class: BenchCommand
+// ==================================================================================
+
+BenchCommand::BenchCommand(const char *cmd_line)
+        : BuiltInCommand(cmd_line), m_runs(10), m_warmup(0), m_prepare(""), m_valid(true)
+{
+    std::string line = getCmdLine();
+    std::vector<std::string> words;
+    std::vector<WordSpan> spans;
+    tokenizeCommandLine(line, words, &spans);
+
+    std::size_t i = 1; // skip 'bench'
+    for (; i < words.size() && !spans[i].quoted && words[i][0] == '-'; ++i) {
+        const std::string &opt = words[i];
+        bool hasValue = (i + 1 < words.size());
+        if ((opt == "-n" || opt == "-w") && hasValue) {
+            int value;
+            if (!isNumber(words[i + 1], &value) || value < 0 || (opt == "-n" && value == 0)) {
+                m_valid = false;
+                return;
+            }
+            (opt == "-n" ? m_runs : m_warmup) = value;
+            ++i;
+        } else if (opt == "--prepare" && hasValue) {
+            m_prepare = words[++i];
+        } else {
+            m_valid = false;
+            return;
+        }
+    }
+
+    if (i >= words.size()) {
+        m_valid = false;
+        return;
+    }
+
+    // Quoted arguments are separate commands; otherwise the rest of the line is one
+    if (spans[i].quoted) {
+        for (; i < words.size(); ++i) m_commands.push_back(words[i]);
+    } else {
+        m_commands.push_back(_trim(line.substr(spans[i].start)));
+    }
+}
+
+void BenchCommand::execute()
+{
+    SmallShell &smash = SmallShell::getInstance();
+
+    if (!m_valid || m_commands.empty()) {
+        std::cerr << "smash error: bench: invalid arguments" << std::endl;
+        builtinFailed();
+        return;
+    }
+
+    int devNull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if (devNull == -1) {
+        perror("smash error: open failed");
+        builtinFailed();
+        return;
+    }
+
+    smash.setInterrupted(false);
+    std::vector<BenchStats> results(m_commands.size());
+
+    for (std::size_t c = 0; c < m_commands.size(); ++c) {
+        std::vector<ResourceUsage> runs;
+        for (int i = 0; i < m_warmup + m_runs && !smash.isInterrupted(); ++i) {
+            if (!m_prepare.empty()) runBenchIteration(m_prepare, devNull);
+            ResourceUsage usage = runBenchIteration(m_commands[c], devNull);
+            if (i >= m_warmup) runs.push_back(usage);
+        }
+        if (smash.isInterrupted() || runs.empty()) {
+            std::cerr << "smash error: bench: interrupted" << std::endl;
+            builtinFailed();
+            close(devNull);
+            return;
+        }
+
+        BenchStats &st = results[c];
+        computeBenchStats(st, runs);
+
+        std::cout << "Benchmark " << c + 1 << ": " << m_commands[c]
+                  << " (" << m_runs << " runs, " << m_warmup << " warmup)\n"
+                  << "  wall:  mean " << formatMs(st.meanWall)
+                  << " +- " << formatMs(st.stddevWall) << "\n"
+                  << "         min " << formatMs(st.minWall)
+                  << "  median " << formatMs(st.medianWall)
+                  << "  p95 " << formatMs(st.p95Wall)
+                  << "  max " << formatMs(st.maxWall) << "\n"
+                  << "  user:  mean " << formatMs(st.meanUser)
+                  << "  sys: mean " << formatMs(st.meanSys)
+                  << "  max rss: " << st.maxRssKb << " KB\n";
+        if (!st.outliers.empty()) {
+            std::cout << "  warning: " << st.outliers.size() << " outlier(s):";
+            for (std::size_t idx : st.outliers)
+                std::cout << " run " << idx + 1 << " (" << formatMs(st.walls[idx]) << ")";
+            std::cout << "\n";
+        }
+    }
+    close(devNull);
+
+    if (results.size() < 2) {
+        std::cout.flush();
+        return;
+    }
+
+    // Side by side: everything relative to the fastest mean
+    std::size_t fastest = 0;
+    for (std::size_t c = 1; c < results.size(); ++c)
+        if (results[c].meanWall < results[fastest].meanWall) fastest = c;
+
+    const BenchStats &base = results[fastest];
+    std::cout << "Summary: '" << m_commands[fastest] << "' ran\n";
+    for (std::size_t c = 0; c < results.size(); ++c) {
+        if (c == fastest) continue;
+        const BenchStats &other = results[c];
+        double ratio = other.meanWall / base.meanWall;
+        double relA = base.meanWall > 0 ? base.stddevWall / base.meanWall : 0;
+        double relB = other.meanWall > 0 ? other.stddevWall / other.meanWall : 0;
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%.2f +- %.2f", ratio, ratio * std::sqrt(relA * relA + relB * relB));
+        std::cout << "  " << buf << " times faster than '" << m_commands[c] << "'\n";
+    }
+    std::cout.flush();
+}
+
 // ==================================================================================
 //                           Helpers for DiskUsage
 // ==================================================================================
@@ -1001,6 +3931,7 @@ void DiskUsageCommand::execute()
     // 1. Validate Arguments
     if (argc > 2) {
         std::cerr << "smash error: du: too many arguments\n";
+        builtinFailed();
         cleanup();
         return;
     }
@@ -1012,6 +3943,7 @@ void DiskUsageCommand::execute()
     if (stat(target, &st) == -1) {
         std::cerr << "smash error: du: directory " << target
                   << " does not exist\n";
+        builtinFailed();
         cleanup();
         return;
     }
@@ -1020,6 +3952,7 @@ void DiskUsageCommand::execute()
     duplicationStaticTotal = 0;
     if (nftw(target, CallBackFunctionOfDuForNFTW, 20, FTW_PHYS) == -1) {
         perror("smash error: nftw failed");
+        builtinFailed();
         cleanup();
         return;
     }
@@ -1044,6 +3977,7 @@ void WhoAmICommand::execute()
     int fd = open("/etc/passwd", O_RDONLY);
     if (fd == -1) {
         perror("smash error: whoami: open failed");
+        builtinFailed();
         return;
     }
 
@@ -1091,6 +4025,7 @@ void WhoAmICommand::execute()
         perror("smash error: whoami: read failed");
     else
         std::cerr << "smash error: whoami: user not found" << std::endl;
+    builtinFailed();
 
     close(fd);
 }
@@ -1107,10 +4042,12 @@ void NetInfo::execute() {
     // 1. Validate Arguments
     if (getArgsNum() <= 1) {
         std::cerr << "smash error: netinfo: interface not specified" << std::endl;
+        builtinFailed();
         return;
     }
     if (getArgsNum() > 2) {
         std::cerr << "smash error: netinfo: too many arguments" << std::endl;
+        builtinFailed();
         return;
     }
 
@@ -1126,6 +4063,7 @@ void NetInfo::execute() {
     int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
     if (sockfd < 0) {
         perror("smash error: netinfo: socket failed");
+        builtinFailed();
         return;
     }
 
@@ -1138,6 +4076,7 @@ void NetInfo::execute() {
     if (ioctl(sockfd, SIOCGIFADDR, &ifr) < 0) {
         std::cerr << "smash error: netinfo: interface " << interfaceName
                   << " does not exist" << std::endl;
+        builtinFailed();
         close(sockfd);
         return;
     }
@@ -1149,6 +4088,7 @@ void NetInfo::execute() {
     // 3. Get Subnet Mask
     if (ioctl(sockfd, SIOCGIFNETMASK, &ifr) < 0) {
         perror("smash error: netinfo: SIOCGIFNETMASK failed");
+        builtinFailed();
         close(sockfd);
         return;
     }
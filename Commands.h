@@ -8,6 +8,11 @@
 #include <set>
 #include <ctime>
 #include <iostream>
+#include <stdexcept>
+#include "Arena.h"
+#include "Redirection.h"
+#include "ResourceLimits.h"
+#include "JobQueue.h"
 
 // Forward declarations
 class JobsList;
@@ -23,9 +28,16 @@ using namespace std;
 //                                Class: Command (Abstract Base)
 // ==================================================================================
 
+// The line and its words live in the command's own arena, which starts in the
+// object (see Arena.h), and the objects come from size-class pools. Parsing and
+// running a builtin thus allocate nothing once the pools are warm.
 class Command {
 private:
-    vector<string> m_args;
+    static const std::size_t INLINE_ARENA = 256;
+
+    alignas(std::max_align_t) char m_inline[INLINE_ARENA];
+    Arena m_arena;
+    ArgList m_args;
     char *m_cmd_line;
     int m_args_num;
     bool m_isBackground;
@@ -34,11 +46,15 @@ public:
     Command(const char *cmd_line);
     virtual ~Command();
 
+    static void *operator new(std::size_t size) { return poolAllocate(size); }
+    static void operator delete(void *object, std::size_t size) { poolRelease(object, size); }
+
     // --------------------------- Getters --------------------------------------
     int getArgsNum() const { return m_args_num; }
+    const ArgList &getArgs() const { return m_args; }
     char* getCmdLine() const { return m_cmd_line; }
     bool isBackground() const { return m_isBackground; }
-    string getArg(int i) const {
+    const ArgRef &getArg(int i) const {
         if (i < 0 || i >= m_args_num) {
             throw std::out_of_range("Index out of range");
         }
@@ -60,10 +76,19 @@ public:
 };
 
 class ExternalCommand : public Command {
+private:
+    vector<FdOp> m_redirections;    // applied in the child, between fork and exec
 public:
     ExternalCommand(const char *cmd_line);
     virtual ~ExternalCommand() {}
 
+    void setRedirections(const vector<FdOp> &ops) { m_redirections = ops; }
+
+    // The child side of execute() - limits, redirections, exec - for a process that
+    // is already forked (a pipeline stage). Never returns. Exec failures are
+    // reported as an errno on 'execErrorFd' unless it is -1.
+    void execInChild(int execErrorFd = -1);
+
     void execute() override;
 };
 
@@ -71,7 +96,12 @@ public:
 //                            Special Commands (Pipes & IO)
 // ==================================================================================
 
+// '<command> [n]>file [n]<file 2>&1 ...' - see Redirection.h for the accepted forms
 class RedirectionCommand : public Command {
+private:
+    string m_innerCmdLine;
+    vector<FdOp> m_ops;
+    bool m_valid;
 public:
     explicit RedirectionCommand(const char *cmd_line);
     virtual ~RedirectionCommand() {}
@@ -87,6 +117,116 @@ public:
     void execute() override;
 };
 
+// 'producer |> (cmdA) (cmdB) ... [> file | >> file]' - fan-out: every consumer
+// reads its own copy of the producer's output, and the optional file gets one
+// more (like 'producer | tee >(cmdA) >(cmdB) > file'). A relay child duplicates
+// the stream with tee()/splice() - see Relay.h. The status is the last consumer's.
+class FanOutCommand : public Command {
+public:
+    explicit FanOutCommand(const char *cmd_line);
+    virtual ~FanOutCommand() {}
+
+    void execute() override;
+};
+
+// '<(cmd)' and '>(cmd)' - each inner command runs in its own child on a pipe, and
+// the occurrence is replaced by /dev/fd/N naming the shell's end of that pipe
+// (inherited by the outer command). The children join the outer command's job if it
+// becomes one; otherwise they are reaped when this object goes out of scope.
+class ProcessSubstitutions {
+private:
+    vector<int> m_fds;
+    vector<pid_t> m_pids;
+public:
+    ProcessSubstitutions() {}
+    ~ProcessSubstitutions();
+
+    ProcessSubstitutions(ProcessSubstitutions const &) = delete;
+    void operator=(ProcessSubstitutions const &) = delete;
+
+    // Launches every substitution in 'line' and rewrites it; false on bad syntax
+    bool resolve(string &line);
+};
+
+// Runs 'cmd_line' for $(...) and captures what it writes to stdout into 'output'.
+// Builtins run in-process with cout redirected into memory (no fork); anything
+// else runs in a child on a pipe. 'status' (optional) gets a wait status.
+void captureCommandOutput(const string &cmd_line, string &output, int *status);
+
+// 'time [-v] <command line>' - runs any command line (builtin, external, pipeline)
+// and reports wall/user/sys time; -v adds max RSS, page faults and context switches
+class TimeCommand : public Command {
+private:
+    string m_innerCmdLine;
+    bool m_verbose;
+public:
+    explicit TimeCommand(const char *cmd_line);
+    virtual ~TimeCommand() {}
+
+    void execute() override;
+};
+
+// 'pipestat [--size SIZE] cmd1 | cmd2 | ...' - runs the pipeline with a measuring
+// relay on every edge (see Relay.h) and reports bytes, MB/s and both kinds of wait
+// per edge, then names the bottleneck stage. --size sets every pipe's capacity
+class PipeStatCommand : public Command {
+private:
+    string m_innerCmdLine;
+    long long m_pipeSize;       // -1: the kernel's default
+    bool m_valid;
+public:
+    explicit PipeStatCommand(const char *cmd_line);
+    virtual ~PipeStatCommand() {}
+
+    void execute() override;
+};
+
+// 'perfstat [-i SECONDS] (-p PID | %JOB | [--] <command line>)' - perf_event_open
+// counters (see PerfCounters.h) on a running process or job, or on a command line
+// started for the purpose, with its threads and children folded in. Prints a summary
+// at the end, or with -i one line of deltas per interval
+class PerfStatCommand : public Command {
+private:
+    string m_innerCmdLine;
+    double m_interval;          // seconds; 0: summary only
+    pid_t m_pid;                // -p, else -1
+    int m_jobId;                // %JOB, else -1
+    bool m_valid;
+public:
+    explicit PerfStatCommand(const char *cmd_line);
+    virtual ~PerfStatCommand() {}
+
+    void execute() override;
+};
+
+// 'limit [--mem SIZE] [--cpu N%|SECONDS] [--nofile N] [--nproc N] <command line>'
+class LimitCommand : public Command {
+private:
+    string m_innerCmdLine;
+    JobLimits m_limits;
+    bool m_valid;
+public:
+    explicit LimitCommand(const char *cmd_line);
+    virtual ~LimitCommand() {}
+
+    void execute() override;
+};
+
+// 'submit [--max-running N] [--max-load L] [--priority P] <command line>' - a
+// background job that starts only when fewer than N submitted jobs run and the
+// load average is below L (see JobQueue.h); until then it is "(queued)" in 'jobs'
+class SubmitCommand : public Command {
+private:
+    string m_innerCmdLine;
+    SubmitLimits m_limits;
+    bool m_valid;
+public:
+    explicit SubmitCommand(const char *cmd_line);
+    virtual ~SubmitCommand() {}
+
+    void execute() override;
+};
+
 // ==================================================================================
 //                            Job Control Commands
 // ==================================================================================
@@ -115,6 +255,15 @@ public:
     void execute() override;
 };
 
+// 'joblog [--since T] [--slowest N] [--failed]' - finished jobs from the job journal
+class JobLogCommand : public BuiltInCommand {
+public:
+    JobLogCommand(const char *cmd_line): BuiltInCommand(cmd_line) {}
+    virtual ~JobLogCommand() {}
+
+    void execute() override;
+};
+
 class QuitCommand : public BuiltInCommand {
 public:
     QuitCommand(const char *cmd_line): BuiltInCommand(cmd_line) {}
@@ -183,6 +332,24 @@ public:
     void execute() override;
 };
 
+// 'NAME=value ...' on its own - sets shell variables (exported ones in the environment)
+class AssignmentCommand : public BuiltInCommand {
+public:
+    AssignmentCommand(const char *cmd_line): BuiltInCommand(cmd_line) {}
+    virtual ~AssignmentCommand() {}
+
+    void execute() override;
+};
+
+// 'name args...' for a function defined with 'name() { ...; }' - see Script.h
+class FunctionCommand : public BuiltInCommand {
+public:
+    FunctionCommand(const char *cmd_line): BuiltInCommand(cmd_line) {}
+    virtual ~FunctionCommand() {}
+
+    void execute() override;
+};
+
 class UnSetEnvCommand : public BuiltInCommand {
 public:
     UnSetEnvCommand(const char *cmd_line);
@@ -191,6 +358,140 @@ public:
     void execute() override;
 };
 
+// 'ulimit [-H|-S] [-a | -c|-d|-f|-l|-n|-s|-t|-u|-v [value|unlimited]]' - the shell's own limits
+class UlimitCommand : public BuiltInCommand {
+public:
+    UlimitCommand(const char *cmd_line): BuiltInCommand(cmd_line) {}
+    virtual ~UlimitCommand() {}
+
+    void execute() override;
+};
+
+// 'setenv NAME [value]'
+class SetEnvCommand : public BuiltInCommand {
+public:
+    SetEnvCommand(const char *cmd_line): BuiltInCommand(cmd_line) {}
+    virtual ~SetEnvCommand() {}
+
+    void execute() override;
+};
+
+// 'export NAME[=value] ...' - with no arguments, lists the environment
+class ExportCommand : public BuiltInCommand {
+public:
+    ExportCommand(const char *cmd_line): BuiltInCommand(cmd_line) {}
+    virtual ~ExportCommand() {}
+
+    void execute() override;
+};
+
+// 'env' without arguments ('env cmd ...' runs the external env)
+class EnvCommand : public BuiltInCommand {
+public:
+    EnvCommand(const char *cmd_line): BuiltInCommand(cmd_line) {}
+    virtual ~EnvCommand() {}
+
+    void execute() override;
+};
+
+// ==================================================================================
+//                                Core Utilities
+// ==================================================================================
+// In-process versions of the commands scripts run most, so they cost no fork/exec.
+// Each sets $? the POSIX way. With '&' the external programs run instead, so that
+// 'sleep 10 &' is still a job.
+
+// 'echo [-neE] [args]'
+class EchoCommand : public BuiltInCommand {
+public:
+    EchoCommand(const char *cmd_line): BuiltInCommand(cmd_line) {}
+    virtual ~EchoCommand() {}
+
+    void execute() override;
+};
+
+// 'printf format [args]' - the format is reused until the arguments run out
+class PrintfCommand : public BuiltInCommand {
+public:
+    PrintfCommand(const char *cmd_line): BuiltInCommand(cmd_line) {}
+    virtual ~PrintfCommand() {}
+
+    void execute() override;
+};
+
+// 'test expr' and '[ expr ]' - status 0 (true), 1 (false) or 2 (error)
+class TestCommand : public BuiltInCommand {
+public:
+    TestCommand(const char *cmd_line): BuiltInCommand(cmd_line) {}
+    virtual ~TestCommand() {}
+
+    void execute() override;
+};
+
+// 'true' / 'false'
+class StatusCommand : public BuiltInCommand {
+private:
+    int m_status;
+public:
+    StatusCommand(const char *cmd_line, int status): BuiltInCommand(cmd_line), m_status(status) {}
+    virtual ~StatusCommand() {}
+
+    void execute() override;
+};
+
+// 'sleep N[smhd] ...' - clock_nanosleep on an absolute deadline, ends early on ctrl-C
+class SleepCommand : public BuiltInCommand {
+public:
+    SleepCommand(const char *cmd_line): BuiltInCommand(cmd_line) {}
+    virtual ~SleepCommand() {}
+
+    void execute() override;
+};
+
+// Text filters: they read files (mmapped) or stdin through TextScan's kernels (see
+// TextScan.h). In a pipeline they run in the shell, reading the pipe. handles() is
+// false for options only the real program has; that program then runs instead.
+
+// 'wc [-lwc] [file...]'
+class WcCommand : public BuiltInCommand {
+public:
+    WcCommand(const char *cmd_line): BuiltInCommand(cmd_line) {}
+    virtual ~WcCommand() {}
+
+    static bool handles(const ArgList &args);
+    void execute() override;
+};
+
+// 'grep -F [-vcnq] pattern [file...]' - fixed strings only; other greps are external
+class GrepCommand : public BuiltInCommand {
+public:
+    GrepCommand(const char *cmd_line): BuiltInCommand(cmd_line) {}
+    virtual ~GrepCommand() {}
+
+    static bool handles(const ArgList &args);
+    void execute() override;
+};
+
+// 'head [-n N | -c N | -N] [file...]'
+class HeadCommand : public BuiltInCommand {
+public:
+    HeadCommand(const char *cmd_line): BuiltInCommand(cmd_line) {}
+    virtual ~HeadCommand() {}
+
+    static bool handles(const ArgList &args);
+    void execute() override;
+};
+
+// 'tail [-n N | -c N | -N] [file...]' - '+N' and '-f' are left to the real tail
+class TailCommand : public BuiltInCommand {
+public:
+    TailCommand(const char *cmd_line): BuiltInCommand(cmd_line) {}
+    virtual ~TailCommand() {}
+
+    static bool handles(const ArgList &args);
+    void execute() override;
+};
+
 // ==================================================================================
 //                            System Info & Monitoring
 // ==================================================================================
@@ -227,4 +528,20 @@ public:
     void execute() override;
 };
 
+// 'bench [-n runs] [-w warmup] [--prepare 'cmd'] <command>' - repeated timing with
+// statistics. Several single-quoted commands are benchmarked side by side.
+class BenchCommand : public BuiltInCommand {
+private:
+    int m_runs;
+    int m_warmup;
+    string m_prepare;
+    vector<string> m_commands;
+    bool m_valid;
+public:
+    BenchCommand(const char *cmd_line);
+    virtual ~BenchCommand() {}
+
+    void execute() override;
+};
+
 #endif //SMASH_COMMAND_H_
\ No newline at end of file
@@ -0,0 +1,69 @@
+//
+// Created by Nikita Matrosov on 16/12/2025.
+//
+
+#include <algorithm>
+#include <cstring>
+#include "Environment.h"
+
+// ==================================================================================
+//                                Class: Environment
+// ==================================================================================
+
+void Environment::load(char **envp) {
+    m_vars.clear();
+    for (char **entry = envp; entry != nullptr && *entry != nullptr; ++entry) {
+        const char *eq = strchr(*entry, '=');
+        if (eq == nullptr) continue;
+        // First definition wins, as with getenv()
+        m_vars.insert(std::make_pair(std::string(*entry, eq - *entry), std::string(eq + 1)));
+    }
+    m_dirty = true;
+}
+
+const std::string *Environment::find(const std::string &name) const {
+    auto it = m_vars.find(name);
+    return (it == m_vars.end()) ? nullptr : &it->second;
+}
+
+void Environment::set(const std::string &name, const std::string &value) {
+    m_vars[name] = value;
+    m_dirty = true;
+}
+
+bool Environment::unset(const std::string &name) {
+    if (m_vars.erase(name) == 0) return false;
+    m_dirty = true;
+    return true;
+}
+
+void Environment::rebuild() {
+    m_entries.clear();
+    m_entries.reserve(m_vars.size());
+    for (const auto &var : m_vars) {
+        m_entries.push_back(var.first + "=" + var.second);
+    }
+    std::sort(m_entries.begin(), m_entries.end());
+
+    // Pointers are taken only after m_entries stops growing
+    m_envp.clear();
+    m_envp.reserve(m_entries.size() + 1);
+    for (auto &entry : m_entries) {
+        m_envp.push_back(&entry[0]);
+    }
+    m_envp.push_back(nullptr);
+    m_dirty = false;
+}
+
+char *const *Environment::envp() {
+    if (m_dirty) rebuild();
+    return m_envp.data();
+}
+
+void Environment::print(std::ostream &out) {
+    if (m_dirty) rebuild();
+    for (const auto &entry : m_entries) {
+        out << entry << '\n';
+    }
+    out.flush();
+}
@@ -0,0 +1,55 @@
+#ifndef SMASH_ENVIRONMENT_H_
+#define SMASH_ENVIRONMENT_H_
+
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// ==================================================================================
+//                                Class: Environment
+// ==================================================================================
+// The environment passed to every command smash runs. It is loaded from 'environ'
+// once at startup and owned by SmallShell after that. Lookups and updates go
+// through a hash table. envp() hands out a ready NULL-terminated "NAME=value"
+// array for execve(). The array is rebuilt only after the table has changed, so
+// an exec does no environment work at all.
+//
+// The process's own 'environ' is left as it was at startup: smash reads its own
+// settings (SMASH_TRACE, SMASH_JOURNAL, ...) only once, at startup.
+class Environment {
+private:
+    std::unordered_map<std::string, std::string> m_vars;
+
+    // envp() cache: m_entries holds the "NAME=value" strings, m_envp points into them
+    std::vector<std::string> m_entries;
+    std::vector<char*> m_envp;
+    bool m_dirty;
+
+    void rebuild();
+
+public:
+    Environment() : m_dirty(true) {}
+
+    Environment(Environment const &) = delete;
+    void operator=(Environment const &) = delete;
+
+    // Replaces the table with the contents of a "NAME=value" array (e.g. environ)
+    void load(char **envp);
+
+    // Value of 'name', or nullptr if it is not in the environment
+    const std::string *find(const std::string &name) const;
+    void set(const std::string &name, const std::string &value);
+    // False if 'name' was not in the environment
+    bool unset(const std::string &name);
+
+    const std::unordered_map<std::string, std::string> &vars() const { return m_vars; }
+
+    // NULL-terminated "NAME=value" array (sorted). Valid until the next change
+    char *const *envp();
+
+    // One "NAME=value" line per variable, in envp() order
+    void print(std::ostream &out);
+};
+
+#endif //SMASH_ENVIRONMENT_H_
@@ -0,0 +1,379 @@
+//
+// Created by Nikita Matrosov on 14/12/2025.
+//
+
+#include <unistd.h>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include "Expansion.h"
+#include "Quoting.h"
+#include "Arithmetic.h"
+#include "Commands.h"
+#include "SmallShell.h"
+#include "Trace.h"
+
+// ==================================================================================
+//                                Quoting Helpers
+// ==================================================================================
+
+namespace {
+
+// Characters that mean something to the parsers that run after expansion
+const char *const UNQUOTED_SPECIALS = "|&;<>()$`'\"\\";
+const char *const DQUOTED_SPECIALS = "$`\"\\";
+
+// Where an expansion's value lands: it is quoted to suit
+enum Context { UNQUOTED, IN_DOUBLE, HERE_DOC };
+
+/**
+ * Appends 'len' bytes of 'value' to 'out' as literal text. Inside double quotes
+ * the quotes are briefly closed around a special character ("'$'"). A here-doc
+ * body is never parsed again, so the value goes in as is.
+ */
+void appendLiteral(std::string &out, const char *value, std::size_t len, Context context) {
+    if (context == HERE_DOC) {
+        out.append(value, len);
+        return;
+    }
+    for (std::size_t i = 0; i < len; ++i) {
+        char c = value[i];
+        if (context == IN_DOUBLE) {
+            if (strchr(DQUOTED_SPECIALS, c) != nullptr) {
+                out += "\"'";
+                out += c;
+                out += "'\"";
+            } else {
+                out += c;
+            }
+            continue;
+        }
+
+        if (c == '\n') {
+            out += ' ';
+        } else if (c == '\'') {
+            out += "\"'\"";
+        } else if (strchr(UNQUOTED_SPECIALS, c) != nullptr) {
+            out += '\'';
+            out += c;
+            out += '\'';
+        } else {
+            out += c;
+        }
+    }
+}
+
+bool isNameStart(char c) {
+    return isalpha((unsigned char) c) || c == '_';
+}
+
+bool isNameChar(char c) {
+    return isalnum((unsigned char) c) || c == '_';
+}
+
+/**
+ * Special parameter characters ($?, $#, ...). Digits are the positional parameters.
+ */
+bool isSpecialParameter(char c) {
+    return strchr("?$!#@*", c) != nullptr || isdigit((unsigned char) c);
+}
+
+/**
+ * Finds the value of a named or special parameter without copying it: 'value'
+ * points into the variable table, the environment, the positional parameters
+ * or 'scratch' (numbers, $@). Returns false if the parameter is unset.
+ * The name is read in place, from [name, name + nameLen) of the line.
+ */
+bool lookupParameter(const char *name, std::size_t nameLen, const char *&value, std::size_t &len,
+                     std::string &scratch) {
+    SmallShell &smash = SmallShell::getInstance();
+
+    if (nameLen > 0 && isdigit((unsigned char) name[0])) {
+        if (nameLen == 1 && name[0] == '0') {
+            scratch = "smash";
+        } else {
+            std::size_t index = 0;
+            for (std::size_t i = 0; i < nameLen; ++i) index = index * 10 + (name[i] - '0');
+            const std::vector<std::string> &positional = smash.getPositional();
+            if (index > positional.size()) return false;
+            value = positional[index - 1].data();
+            len = positional[index - 1].size();
+            return true;
+        }
+    } else if (nameLen == 1 && !isNameStart(name[0])) {
+        switch (name[0]) {
+            case '?':
+                scratch = std::to_string(smash.getLastStatus());
+                break;
+            case '$':
+                scratch = std::to_string((int) smash.getShellPid());
+                break;
+            case '!':
+                if (smash.getLastBgPid() == -1) return false;
+                scratch = std::to_string((int) smash.getLastBgPid());
+                break;
+            case '#':
+                scratch = std::to_string(smash.getPositional().size());
+                break;
+            case '@':
+            case '*':
+                scratch.clear();
+                for (const auto &param : smash.getPositional()) {
+                    if (!scratch.empty()) scratch += ' ';
+                    scratch += param;
+                }
+                break;
+            default:
+                return false;
+        }
+    } else {
+        // The tables are keyed by std::string (no heterogeneous lookup in C++11):
+        // one key buffer is reused, so a lookup copies the name but never allocates
+        static std::string key;
+        key.assign(name, nameLen);
+        const std::string *var = smash.lookupVariable(key);
+        if (var == nullptr) return false;
+        value = var->data();
+        len = var->size();
+        return true;
+    }
+    value = scratch.data();
+    len = scratch.size();
+    return true;
+}
+
+/**
+ * "$@": one word per positional parameter - the double quotes are closed and
+ * reopened around the blank between two of them.
+ */
+void appendQuotedPositional(std::string &out) {
+    const std::vector<std::string> &positional = SmallShell::getInstance().getPositional();
+    for (std::size_t i = 0; i < positional.size(); ++i) {
+        if (i > 0) out += "\" \"";
+        appendLiteral(out, positional[i].data(), positional[i].size(), IN_DOUBLE);
+    }
+}
+
+bool expandInto(const std::string &line, std::string &out, Context context);
+
+/**
+ * Expands the "${...}" whose body is 'body' into 'out'.
+ */
+bool expandBraced(const std::string &body, std::string &out, Context context) {
+    std::string scratch;
+    const char *value = nullptr;
+    std::size_t len = 0;
+
+    // ${#NAME}
+    if (body.size() > 1 && body[0] == '#') {
+        bool set = lookupParameter(body.data() + 1, body.size() - 1, value, len, scratch);
+        out += std::to_string(set ? len : (std::size_t) 0);
+        return true;
+    }
+
+    std::size_t nameEnd = 0;
+    if (!body.empty() && isNameStart(body[0])) {
+        while (nameEnd < body.size() && isNameChar(body[nameEnd])) ++nameEnd;
+    } else if (!body.empty() && isdigit((unsigned char) body[0])) {
+        while (nameEnd < body.size() && isdigit((unsigned char) body[nameEnd])) ++nameEnd; // ${10}
+    } else if (!body.empty() && isSpecialParameter(body[0])) {
+        nameEnd = 1;
+    }
+    if (nameEnd == 0) {
+        std::cerr << "smash error: ${" << body << "}: bad substitution" << std::endl;
+        return false;
+    }
+
+    bool set = lookupParameter(body.data(), nameEnd, value, len, scratch);
+    if (nameEnd == body.size()) {
+        if (set) appendLiteral(out, value, len, context);
+        return true;
+    }
+
+    // ${NAME<op>word}: with ':' an empty value counts as unset
+    std::size_t opPos = nameEnd;
+    bool colon = (body[opPos] == ':');
+    if (colon) ++opPos;
+    char op = (opPos < body.size()) ? body[opPos] : '\0';
+    if (strchr("-=+?", op) == nullptr || op == '\0') {
+        std::cerr << "smash error: ${" << body << "}: bad substitution" << std::endl;
+        return false;
+    }
+    std::string name = body.substr(0, nameEnd);
+    std::string word = body.substr(opPos + 1);
+    bool present = set && !(colon && len == 0);
+
+    switch (op) {
+        case '-':
+            if (present) appendLiteral(out, value, len, context);
+            else return expandInto(word, out, context);
+            return true;
+        case '+':
+            if (present) return expandInto(word, out, context);
+            return true;
+        case '?':
+            if (present) {
+                appendLiteral(out, value, len, context);
+                return true;
+            }
+            std::cerr << "smash error: " << name << ": "
+                      << (word.empty() ? "parameter null or not set" : removeQuotes(word)) << std::endl;
+            return false;
+        default: { // '='
+            if (present) {
+                appendLiteral(out, value, len, context);
+                return true;
+            }
+            if (!isNameStart(name[0])) {
+                std::cerr << "smash error: $" << name << ": cannot assign in this way" << std::endl;
+                return false;
+            }
+            std::string expanded;
+            if (!expandInto(word, expanded, UNQUOTED)) return false;
+            std::string assigned = removeQuotes(expanded);
+            SmallShell::getInstance().assignVariable(name, assigned);
+            appendLiteral(out, assigned.data(), assigned.size(), context);
+            return true;
+        }
+    }
+}
+
+/**
+ * The expansion pass itself: copies 'line' into 'out', expanding as it goes.
+ * 'context' is the quoting the text starts in (for ${NAME:-word} words). Quotes
+ * and backslashes are copied for the later quote removal, except in a here-doc
+ * body, which has none: its escaping backslashes are dropped here.
+ */
+bool expandInto(const std::string &line, std::string &out, Context context) {
+    QuoteScan scan(context == IN_DOUBLE ? QuoteScan::IN_DOUBLE
+                                        : (context == HERE_DOC ? QuoteScan::HERE_DOC : QuoteScan::UNQUOTED));
+    std::size_t i = 0;
+    while (i < line.size()) {
+        char c = line[i];
+        QuoteScan::Kind kind = scan.at(line, i);
+
+        if (kind == QuoteScan::LITERAL || kind == QuoteScan::SYNTAX || c != '$' || i + 1 >= line.size()) {
+            if (kind != QuoteScan::SYNTAX || context != HERE_DOC) out += c;
+            ++i;
+            continue;
+        }
+
+        // Where this '$' stands decides how its value is quoted
+        Context at = (context == HERE_DOC) ? HERE_DOC : (kind == QuoteScan::QUOTED ? IN_DOUBLE : UNQUOTED);
+        char next = line[i + 1];
+
+        // $((expression)) - a '$(' whose inner parentheses close right before its own
+        if (next == '(' && i + 2 < line.size() && line[i + 2] == '(') {
+            std::size_t closing = findClosingParen(line, i + 1);
+            if (closing != std::string::npos && findClosingParen(line, i + 2) == closing - 1) {
+                std::string expr;
+                if (!expandInto(line.substr(i + 3, closing - i - 4), expr, UNQUOTED)) return false;
+                long long result;
+                if (!evaluateArithmetic(removeQuotes(expr), result)) return false;
+                out += std::to_string(result);
+                i = closing + 1;
+                continue;
+            }
+        }
+
+        // $(...)
+        if (next == '(') {
+            std::size_t closing = findClosingParen(line, i + 1);
+            if (closing == std::string::npos) {
+                std::cerr << "smash error: command substitution: missing ')'" << std::endl;
+                return false;
+            }
+
+            std::string output;
+            captureCommandOutput(line.substr(i + 2, closing - i - 2), output, nullptr);
+
+            std::size_t len = output.find_last_not_of('\n');
+            len = (len == std::string::npos) ? 0 : len + 1;
+            appendLiteral(out, output.data(), len, at);
+            i = closing + 1;
+            continue;
+        }
+
+        // ${...}
+        if (next == '{') {
+            std::size_t closing = findClosingBrace(line, i + 1);
+            if (closing == std::string::npos) {
+                std::cerr << "smash error: parameter expansion: missing '}'" << std::endl;
+                return false;
+            }
+            if (!expandBraced(line.substr(i + 2, closing - i - 2), out, at)) return false;
+            i = closing + 1;
+            continue;
+        }
+
+        // "$@": a word per positional parameter
+        if (next == '@' && at == IN_DOUBLE) {
+            appendQuotedPositional(out);
+            i += 2;
+            continue;
+        }
+
+        // $NAME, $?, $$, $!, $#, $@, $*, $0 ... $9
+        std::size_t nameEnd = i + 1;
+        if (isNameStart(next)) {
+            while (nameEnd < line.size() && isNameChar(line[nameEnd])) ++nameEnd;
+        } else if (isSpecialParameter(next)) {
+            nameEnd = i + 2;
+        } else {
+            out += c; // a lone '$' is literal
+            ++i;
+            continue;
+        }
+
+        std::string scratch;
+        const char *value;
+        std::size_t len;
+        if (lookupParameter(line.data() + i + 1, nameEnd - i - 1, value, len, scratch)) {
+            appendLiteral(out, value, len, at);
+        }
+        i = nameEnd;
+    }
+    return true;
+}
+
+}
+
+// ==================================================================================
+//                                Expansion
+// ==================================================================================
+
+bool expandWord(const std::string &word, std::string &value) {
+    if (word.find_first_of("$'\"\\") == std::string::npos) {
+        value = word;
+        return true;
+    }
+
+    std::string expanded;
+    if (!expandInto(word, expanded, UNQUOTED)) return false;
+    value = removeQuotes(expanded);
+    return true;
+}
+
+bool expandHereDoc(const std::string &body, std::string &out) {
+    out.clear();
+    if (body.find_first_of("$\\") == std::string::npos) {
+        out = body;
+        return true;
+    }
+    out.reserve(body.size() + 64);
+    return expandInto(body, out, HERE_DOC);
+}
+
+bool expandCommandLine(std::string &line) {
+    if (line.find('$') == std::string::npos) return true;
+    TRACE_SCOPE("expand");
+
+    std::string out;
+    out.reserve(line.size() + 64);
+    if (!expandInto(line, out, UNQUOTED)) return false;
+
+    line.swap(out);
+    return true;
+}
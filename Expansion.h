@@ -0,0 +1,47 @@
+#ifndef SMASH_EXPANSION_H_
+#define SMASH_EXPANSION_H_
+
+#include <cstddef>
+#include <string>
+#include "Quoting.h"
+
+// ==================================================================================
+//                                Expansion
+// ==================================================================================
+// A single pass over each command line, after alias expansion and before
+// CreateCommand(). Text in single quotes, or escaped with a backslash, is left alone
+// (quoting rules: Quoting.h). Everywhere else it handles:
+//   $NAME ${NAME}            shell variable, else environment variable
+//   ${NAME:-w} ${NAME-w}     w if NAME is unset/empty (without ':': only if unset)
+//   ${NAME:=w} ${NAME:+w}    assign w if unset/empty / w only if NAME is set
+//   ${NAME:?msg} ${#NAME}    fail with msg if unset/empty / length of the value
+//   $? $$ $! $0              last exit status, shell pid, last background pid, "smash"
+//   $1..$9 ${10} $# $@ $*    positional parameters (function arguments) and their count;
+//                            "$@" keeps one word per parameter
+//   $(...)                   captured output of the inner command, trailing
+//                            newlines stripped
+//   $((expr))                integer arithmetic (see Arithmetic.h)
+//
+// Values are appended straight to the output line. Characters that would otherwise
+// act as operators (| & ; < > ( ) $ quotes) are wrapped in quotes so the rest of the
+// shell reads them as literal data. Unquoted values keep their blanks (and newlines
+// become blanks), so they split into words as usual.
+
+/**
+ * Expands 'line' in place. Prints an error and returns false on bad syntax.
+ */
+bool expandCommandLine(std::string &line);
+
+/**
+ * Expands a here-doc body into 'out': $ and ` expansions and \-escapes of $ ` \ and
+ * newline, as inside "...", but quotes stay as they are. False (error printed) on bad syntax.
+ */
+bool expandHereDoc(const std::string &body, std::string &out);
+
+/**
+ * Expands a single word without splitting it (assignment values, 'for' targets):
+ * 'value' receives the result with quotes removed. False (error printed) on bad syntax.
+ */
+bool expandWord(const std::string &word, std::string &value);
+
+#endif //SMASH_EXPANSION_H_
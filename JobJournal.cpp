@@ -0,0 +1,383 @@
+//
+// Created by Nikita Matrosov on 10/12/2025.
+//
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <sys/wait.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include "JobJournal.h"
+
+// ==================================================================================
+//                                Static State
+// ==================================================================================
+
+namespace {
+
+const std::size_t MAX_PENDING_RECORDS = 4096;
+const off_t DEFAULT_MAX_BYTES = 4 * 1024 * 1024;
+
+struct LiveJob {
+    int jobId;
+    int64_t startUs;
+    char command[JOURNAL_CMD_LEN];
+};
+
+bool g_enabled = false;
+std::string g_path;
+off_t g_maxBytes = DEFAULT_MAX_BYTES;
+pid_t g_ownerPid = 0;
+
+// Jobs announced by jobStarted() - touched by the shell's main thread only
+std::unordered_map<pid_t, LiveJob> g_live;
+
+// Writer hand-off. Heap allocated and never freed: the detached writer may still
+// be blocked on the condition variable while static destructors run at exit
+struct WriterQueue {
+    std::mutex mutex;
+    std::condition_variable wakeWriter;
+    std::condition_variable drained;
+    std::vector<JournalRecord> pending;
+    bool writing = false;
+    bool writerStarted = false;
+    uint64_t dropped = 0;
+};
+WriterQueue *g_queue = nullptr;
+
+// Owned by the writer thread
+int g_journalFd = -1;
+int g_indexFd = -1;
+int g_lockFd = -1;
+
+std::string indexPathOf(const std::string &journal) { return journal + ".idx"; }
+std::string lockPathOf(const std::string &journal) { return journal + ".lock"; }
+
+int64_t realtimeMicros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int64_t timevalMicros(const struct timeval &tv) {
+    return (int64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+bool writeAll(int fd, const void *buf, std::size_t len) {
+    const char *p = static_cast<const char *>(buf);
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n == -1) return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+void closeFiles() {
+    if (g_journalFd != -1) close(g_journalFd);
+    if (g_indexFd != -1) close(g_indexFd);
+    g_journalFd = g_indexFd = -1;
+}
+
+bool openFiles() {
+    // Another shell may have rotated the files under us: follow the name, not the inode
+    struct stat current, named;
+    if (g_journalFd != -1 && (fstat(g_journalFd, &current) == -1 || stat(g_path.c_str(), &named) == -1 ||
+                              current.st_ino != named.st_ino || current.st_dev != named.st_dev)) {
+        closeFiles();
+    }
+    if (g_journalFd != -1) return true;
+    g_journalFd = open(g_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    g_indexFd = open(indexPathOf(g_path).c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if (g_journalFd == -1 || g_indexFd == -1) {
+        closeFiles();
+        return false;
+    }
+    return true;
+}
+
+void rotate() {
+    closeFiles();
+    rename(g_path.c_str(), (g_path + ".1").c_str());
+    rename(indexPathOf(g_path).c_str(), indexPathOf(g_path + ".1").c_str());
+}
+
+// Held across append and rotate: shells (and --serve workers) sharing one journal
+// would otherwise interleave records and index entries computed from stale offsets.
+// The lock file itself is never rotated
+class JournalLock {
+public:
+    JournalLock() : m_locked(false) {
+        if (g_lockFd == -1) g_lockFd = open(lockPathOf(g_path).c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if (g_lockFd == -1) return;
+        int rc;
+        while ((rc = flock(g_lockFd, LOCK_EX)) == -1 && errno == EINTR) {}
+        m_locked = (rc == 0);
+    }
+    ~JournalLock() { if (m_locked) flock(g_lockFd, LOCK_UN); }
+    bool locked() const { return m_locked; }
+private:
+    bool m_locked;
+};
+
+/**
+ * Appends a batch of records and the index entries of the finished jobs in it.
+ * Runs on the writer thread only.
+ */
+void writeBatch(const std::vector<JournalRecord> &batch) {
+    JournalLock lock;
+    if (!lock.locked() || !openFiles()) return;
+
+    struct stat st;
+    if (fstat(g_journalFd, &st) == -1) return;
+    off_t base = st.st_size;
+
+    if (!writeAll(g_journalFd, batch.data(), batch.size() * sizeof(JournalRecord))) return;
+
+    std::vector<JournalIndexEntry> entries;
+    for (std::size_t i = 0; i < batch.size(); ++i) {
+        const JournalRecord &rec = batch[i];
+        if (rec.event != JOURNAL_EXITED && rec.event != JOURNAL_SIGNALED) continue;
+
+        JournalIndexEntry e;
+        memset(&e, 0, sizeof(e));
+        e.endUs = rec.timeUs;
+        e.wallUs = rec.timeUs - rec.startUs;
+        e.offset = base + i * sizeof(JournalRecord);
+        e.status = rec.status;
+        e.signaled = (rec.event == JOURNAL_SIGNALED);
+        entries.push_back(e);
+    }
+    if (!entries.empty()) writeAll(g_indexFd, entries.data(), entries.size() * sizeof(JournalIndexEntry));
+
+    if (base + (off_t) (batch.size() * sizeof(JournalRecord)) > g_maxBytes) rotate();
+}
+
+void writerLoop() {
+    WriterQueue &q = *g_queue;
+    std::vector<JournalRecord> batch;
+    std::unique_lock<std::mutex> lock(q.mutex);
+    while (true) {
+        q.wakeWriter.wait(lock, [&q] { return !q.pending.empty(); });
+        batch.swap(q.pending);
+        q.writing = true;
+
+        lock.unlock();
+        writeBatch(batch);
+        batch.clear();
+        lock.lock();
+
+        q.writing = false;
+        q.drained.notify_all();
+    }
+}
+
+void syncAtExit() {
+    JobJournal::sync();
+}
+
+/**
+ * Queues a record for the writer thread; never waits for I/O.
+ */
+void enqueue(const JournalRecord &rec) {
+    WriterQueue &q = *g_queue;
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (q.pending.size() >= MAX_PENDING_RECORDS) {
+        ++q.dropped;
+        return;
+    }
+    q.pending.push_back(rec);
+
+    if (!q.writerStarted) {
+        // Started on first use; it must never take the shell's signals
+        sigset_t all, prev;
+        sigfillset(&all);
+        pthread_sigmask(SIG_SETMASK, &all, &prev);
+        std::thread(writerLoop).detach();
+        pthread_sigmask(SIG_SETMASK, &prev, nullptr);
+        q.writerStarted = true;
+    }
+    q.wakeWriter.notify_one();
+}
+
+JournalRecord makeRecord(JournalEvent event, pid_t pid, const LiveJob &job) {
+    JournalRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.magic = JOURNAL_RECORD_MAGIC;
+    rec.event = event;
+    rec.jobId = job.jobId;
+    rec.pid = pid;
+    rec.timeUs = realtimeMicros();
+    rec.startUs = job.startUs;
+    memcpy(rec.command, job.command, JOURNAL_CMD_LEN);
+    return rec;
+}
+
+// Forked pipeline stages carry a copy of everything above - only the shell writes
+bool isOwner() {
+    return g_enabled && getpid() == g_ownerPid;
+}
+
+struct IndexedEntry {
+    JournalIndexEntry entry;
+    int file;       // 0 = rotated (.1), 1 = current
+};
+
+void loadIndex(const std::string &journal, int file, std::vector<IndexedEntry> &out) {
+    int fd = open(indexPathOf(journal).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return;
+
+    JournalIndexEntry buf[256];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        for (ssize_t i = 0; i < n / (ssize_t) sizeof(JournalIndexEntry); ++i)
+            out.push_back(IndexedEntry{buf[i], file});
+    }
+    close(fd);
+}
+
+}
+
+// ==================================================================================
+//                                Class: JobJournal
+// ==================================================================================
+
+void JobJournal::init() {
+    // Opt-in, like metrics and the shm job table: SMASH_JOURNAL=<path>, or =1 for ~/.smash_journal
+    const char *path = getenv("SMASH_JOURNAL");
+    if (path == nullptr || *path == '\0') return;
+    if (strcmp(path, "1") == 0) {
+        const char *home = getenv("HOME");
+        if (home == nullptr || *home == '\0') return;
+        g_path = std::string(home) + "/.smash_journal";
+    } else {
+        g_path = path;
+    }
+
+    const char *maxBytes = getenv("SMASH_JOURNAL_MAX");
+    if (maxBytes != nullptr && atoll(maxBytes) > 0) g_maxBytes = atoll(maxBytes);
+
+    g_queue = new WriterQueue();
+    g_ownerPid = getpid();
+    g_enabled = true;
+    atexit(syncAtExit);
+}
+
+bool JobJournal::isEnabled() {
+    return g_enabled;
+}
+
+void JobJournal::jobStarted(pid_t pid, int jobId, const std::string &cmd_line) {
+    if (!isOwner()) return;
+
+    LiveJob job;
+    job.jobId = jobId;
+    job.startUs = realtimeMicros();
+    strncpy(job.command, cmd_line.c_str(), JOURNAL_CMD_LEN - 1);
+    job.command[JOURNAL_CMD_LEN - 1] = '\0';
+    g_live[pid] = job;
+
+    enqueue(makeRecord(JOURNAL_STARTED, pid, job));
+}
+
+void JobJournal::jobStopped(pid_t pid) {
+    if (!isOwner()) return;
+    auto it = g_live.find(pid);
+    if (it == g_live.end()) return;
+    enqueue(makeRecord(JOURNAL_STOPPED, pid, it->second));
+}
+
+void JobJournal::jobContinued(pid_t pid) {
+    if (!isOwner()) return;
+    auto it = g_live.find(pid);
+    if (it == g_live.end()) return;
+    enqueue(makeRecord(JOURNAL_CONTINUED, pid, it->second));
+}
+
+void JobJournal::jobFinished(pid_t pid, int status, const struct rusage *ru) {
+    if (!isOwner()) return;
+    auto it = g_live.find(pid);
+    if (it == g_live.end()) return;
+
+    bool signaled = WIFSIGNALED(status);
+    JournalRecord rec = makeRecord(signaled ? JOURNAL_SIGNALED : JOURNAL_EXITED, pid, it->second);
+    rec.status = signaled ? WTERMSIG(status) : WEXITSTATUS(status);
+    if (ru != nullptr) {
+        rec.userUs = timevalMicros(ru->ru_utime);
+        rec.sysUs = timevalMicros(ru->ru_stime);
+        rec.maxRssKb = ru->ru_maxrss;
+        rec.minorFaults = ru->ru_minflt;
+        rec.majorFaults = ru->ru_majflt;
+    }
+    g_live.erase(it);
+
+    enqueue(rec);
+}
+
+void JobJournal::sync() {
+    if (!isOwner()) return;
+    WriterQueue &q = *g_queue;
+    std::unique_lock<std::mutex> lock(q.mutex);
+    q.drained.wait(lock, [&q] { return q.pending.empty() && !q.writing; });
+}
+
+bool JobJournal::query(const JournalQuery &q, std::vector<JournalRecord> &out) {
+    if (!g_enabled) return false;
+    sync();
+
+    // Rotated file first - the concatenation stays sorted by end time
+    const std::string journals[2] = {g_path + ".1", g_path};
+    std::vector<IndexedEntry> index;
+    loadIndex(journals[0], 0, index);
+    loadIndex(journals[1], 1, index);
+
+    // --since: binary search on the end time instead of scanning
+    auto first = std::lower_bound(index.begin(), index.end(), q.sinceUs,
+                                  [](const IndexedEntry &e, int64_t t) { return e.entry.endUs < t; });
+    std::vector<IndexedEntry> selected;
+    for (auto it = first; it != index.end(); ++it) {
+        if (q.failedOnly && !it->entry.signaled && it->entry.status == 0) continue;
+        selected.push_back(*it);
+    }
+
+    if (q.slowest > 0) {
+        std::size_t n = std::min<std::size_t>(q.slowest, selected.size());
+        std::partial_sort(selected.begin(), selected.begin() + n, selected.end(),
+                          [](const IndexedEntry &a, const IndexedEntry &b) {
+                              return a.entry.wallUs > b.entry.wallUs;
+                          });
+        selected.resize(n);
+    } else if (q.sinceUs == 0 && q.limit > 0 && selected.size() > (std::size_t) q.limit) {
+        selected.erase(selected.begin(), selected.end() - q.limit);
+    }
+
+    // Only the records that are printed are read from the journal itself
+    int fds[2] = {-1, -1};
+    for (const auto &sel : selected) {
+        int &fd = fds[sel.file];
+        if (fd == -1) fd = open(journals[sel.file].c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1) continue;
+
+        JournalRecord rec;
+        if (pread(fd, &rec, sizeof(rec), sel.entry.offset) == (ssize_t) sizeof(rec) &&
+            rec.magic == JOURNAL_RECORD_MAGIC) {
+            out.push_back(rec);
+        }
+    }
+    for (int fd : fds)
+        if (fd != -1) close(fd);
+    return true;
+}
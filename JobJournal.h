@@ -0,0 +1,96 @@
+#ifndef SMASH_JOB_JOURNAL_H_
+#define SMASH_JOB_JOURNAL_H_
+
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ==================================================================================
+//                                Job Event Journal
+// ==================================================================================
+// Append-only binary log of job lifecycle events (started, stopped, continued,
+// exited, signaled), kept in $SMASH_JOURNAL when it is set (SMASH_JOURNAL=1 means
+// ~/.smash_journal). Records are queued in memory and written by a
+// background thread, so the prompt never waits on disk I/O; if the queue overflows,
+// events are dropped rather than blocking.
+//
+// Every finished job also gets a 32-byte entry in '<journal>.idx' pointing at its
+// record; 'joblog' answers queries from the index and only reads the records it
+// prints. Both files rotate to '.1' once the journal exceeds $SMASH_JOURNAL_MAX
+// bytes (default 4 MiB). Shells sharing a journal take an flock on '<journal>.lock'
+// for each append and rotation, and reopen the files when another shell rotated them.
+
+#define JOURNAL_RECORD_MAGIC (0x4a4d5331u)   // "1SMJ"
+#define JOURNAL_CMD_LEN (96)
+
+enum JournalEvent : uint8_t {
+    JOURNAL_STARTED = 0,
+    JOURNAL_STOPPED,
+    JOURNAL_CONTINUED,
+    JOURNAL_EXITED,
+    JOURNAL_SIGNALED
+};
+
+struct JournalRecord {
+    uint32_t magic;
+    uint8_t event;                  // JournalEvent
+    uint8_t reserved[3];
+    int32_t jobId;                  // -1 when the job never had one
+    int32_t pid;
+    int32_t status;                 // exit code (EXITED) or signal number (SIGNALED)
+    int64_t timeUs;                 // wall clock (CLOCK_REALTIME) of the event
+    int64_t startUs;                // wall clock when the job started
+    int64_t userUs;
+    int64_t sysUs;
+    int64_t maxRssKb;
+    int64_t minorFaults;
+    int64_t majorFaults;
+    char command[JOURNAL_CMD_LEN];  // NUL terminated, truncated
+};
+
+struct JournalIndexEntry {
+    int64_t endUs;                  // entries are appended in end-time order
+    int64_t wallUs;
+    uint64_t offset;                // of the JOURNAL_EXITED/SIGNALED record
+    int32_t status;
+    uint8_t signaled;
+    uint8_t reserved[3];
+};
+
+struct JournalQuery {
+    int64_t sinceUs = 0;            // only jobs that ended at/after this time
+    int slowest = 0;                // > 0: the N longest jobs, slowest first
+    bool failedOnly = false;        // non-zero exit or killed by a signal
+    int limit = 20;                 // most recent N when no other ordering applies
+};
+
+// ==================================================================================
+//                                Class: JobJournal
+// ==================================================================================
+class JobJournal {
+public:
+    // Resolves the journal path and prepares the writer (called once from main)
+    static void init();
+
+    static bool isEnabled();
+
+    // ------------------------------ Event Hooks -----------------------------------
+    // Only processes announced with jobStarted() are journaled; others are ignored
+    static void jobStarted(pid_t pid, int jobId, const std::string &cmd_line);
+    static void jobStopped(pid_t pid);
+    static void jobContinued(pid_t pid);
+
+    // 'status' is a wait status; ru may be nullptr when no rusage is available
+    static void jobFinished(pid_t pid, int status, const struct rusage *ru);
+
+    // Blocks until queued records reach the file (used before queries)
+    static void sync();
+
+    // ------------------------------- Queries --------------------------------------
+    // Returns matching finished-job records, in display order
+    static bool query(const JournalQuery &q, std::vector<JournalRecord> &out);
+};
+
+#endif //SMASH_JOB_JOURNAL_H_
@@ -6,11 +6,19 @@
 #include <vector>
 #include <sstream>
 #include <sys/wait.h>
+#include <sys/resource.h>
+#include <cerrno>
 #include <csignal>
 #include <regex>
 #include <algorithm>
 #include "JobList.h"
 #include "SmallShell.h"
+#include "ResourceLimits.h"
+#include "Trace.h"
+#include "Metrics.h"
+#include "JobTableShm.h"
+#include "JobJournal.h"
+#include "Arena.h"
 
 using namespace std;
 
@@ -20,7 +28,8 @@ using namespace std;
 
 std::ostream &operator<<(std::ostream &os, const JobsList::JobEntry &job) {
     os << "[" << job.getJobId() << "] " << job.getPrintCommandLine()
-       << ((job.getStopped()) ? " (stopped)" : "" ) << "\n";
+       << ((job.getStopped()) ? " (stopped)" : "" ) << ((job.getQueued()) ? " (queued)" : "")
+       << ResourceLimits::jobStats(job.getPid()) << "\n";
     return os;
 }
 
@@ -28,13 +37,17 @@ std::ostream &operator<<(std::ostream &os, const JobsList::JobEntry &job) {
 //                            Class: JobEntry Implementation
 // ==================================================================================
 
-JobsList::JobEntry::JobEntry(pid_t pid, int jobId, const string &procecced_commandLine, bool isStopped, const string &print_cmd_line):
+JobsList::JobEntry::JobEntry(pid_t pid, int jobId, const string &procecced_commandLine, bool isStopped, const string &print_cmd_line,
+                             const vector<pid_t> &helperPids):
         m_pid(pid),
         m_procecced_commandLine(procecced_commandLine),
         m_org_commandLine(""),
         m_jobId(jobId),
         m_isStopped(isStopped),
-        m_insertionTime(0)
+        m_insertionTime(0),
+        m_helperPids(helperPids),
+        m_exited(false),
+        m_queued(false)
 {
     if (print_cmd_line == "") {
         m_org_commandLine = procecced_commandLine;
@@ -44,6 +57,33 @@ JobsList::JobEntry::JobEntry(pid_t pid, int jobId, const string &procecced_comma
     m_insertionTime = time(nullptr);
 }
 
+// A job table that fills and drains all session long reuses the same entries
+static SlabPool &jobEntryPool() {
+    static SlabPool pool(sizeof(JobsList::JobEntry), 32);
+    return pool;
+}
+
+void *JobsList::JobEntry::operator new(std::size_t) {
+    return jobEntryPool().allocate();
+}
+
+void JobsList::JobEntry::operator delete(void *entry) {
+    if (entry != nullptr) jobEntryPool().release(entry);
+}
+
+bool JobsList::JobEntry::reapHelpers() {
+    SmallShell &smash = SmallShell::getInstance();
+    for (auto it = m_helperPids.begin(); it != m_helperPids.end();) {
+        pid_t res = smash.waitForChild(*it, nullptr, WNOHANG);
+        if (res == 0) {
+            ++it;
+            continue;
+        }
+        it = m_helperPids.erase(it); // exited, or no longer ours (-1)
+    }
+    return m_helperPids.empty();
+}
+
 // ==================================================================================
 //                                Lifecycle (Destructor)
 // ==================================================================================
@@ -58,14 +98,15 @@ JobsList::~JobsList() {
 //                                Core Job Management
 // ==================================================================================
 
-void JobsList::addJob(pid_t pid, const string &proccesed_cmd_line, bool isStopped, int jobId, const string &print_cmd_line) {
+void JobsList::addJob(pid_t pid, const string &proccesed_cmd_line, bool isStopped, int jobId, const string &print_cmd_line,
+                      const vector<pid_t> &helperPids) {
     SmallShell &smash = SmallShell::getInstance();
 
     if (jobId == -1) {
         jobId = smash.getNextFreeJobId();
     }
 
-    JobEntry* jobToAdd = new JobEntry(pid, jobId, proccesed_cmd_line, isStopped, print_cmd_line);
+    JobEntry* jobToAdd = new JobEntry(pid, jobId, proccesed_cmd_line, isStopped, print_cmd_line, helperPids);
     smash.setJobIdUsed(jobId);
     m_jobsMap.insert({jobToAdd->getJobId(), jobToAdd});
 
@@ -74,32 +115,48 @@ void JobsList::addJob(pid_t pid, const string &proccesed_cmd_line, bool isStoppe
     } else {
         m_runningJobsQueue.push_back(jobToAdd);
     }
+    notifyChanged();
 }
 
 void JobsList::removeFinishedJobs() {
+    TRACE_SCOPE("reap-jobs");
     SmallShell &smash = SmallShell::getInstance();
     vector<JobEntry*> finishedJobs;
 
     //  Identify finished jobs
     for (const auto & jobPair: m_jobsMap) {
         JobEntry* jobPtr = jobPair.second;
-        int status;
-        pid_t pState = waitpid(jobPtr->getPid(), &status, WNOHANG);
 
-        if (pState == -1) {
-            perror("smash error: waitpid failed");
-            continue;
+        if (!jobPtr->hasExited()) {
+            int status;
+            struct rusage ru;
+            pid_t pState = wait4(jobPtr->getPid(), &status, WNOHANG, &ru);
+
+            if (pState == -1) {
+                // Not our child: a pipeline stage inherits the shell's job list
+                if (errno == ECHILD) {
+                    jobPtr->setExited();
+                } else {
+                    perror("smash error: waitpid failed");
+                    continue;
+                }
+            } else if (pState == 0) {
+                continue; // Job still running
+            } else {
+                JobJournal::jobFinished(pState, status, &ru);
+                jobPtr->setExited();
+            }
         }
 
-        if (pState == 0) {
-            continue; // Job still running
-        } else {
+        // Process substitutions belong to the job: it is over once they are reaped too
+        if (jobPtr->reapHelpers()) {
             finishedJobs.push_back(jobPtr);
         }
     }
 
     //  Remove them from all structures
     for(const auto & jobPtr : finishedJobs) {
+        ResourceLimits::releaseJob(jobPtr->getPid());
         smash.setJobIdFree(jobPtr->getJobId());
         m_jobsMap.erase(jobPtr->getJobId());
 
@@ -109,6 +166,7 @@ void JobsList::removeFinishedJobs() {
 
         delete jobPtr;
     }
+    if (!finishedJobs.empty()) notifyChanged();
 }
 
 void JobsList::killAllJobs() {
@@ -117,20 +175,27 @@ void JobsList::killAllJobs() {
     // Clear queues first
     m_runningJobsQueue.clear();
     m_stoppedJobsQueue.clear();
+    m_submitQueue.clear();
 
     for (const auto & jobPair : m_jobsMap) {
         JobEntry* jobPtr = jobPair.second;
         smash.setJobIdFree(jobPtr->getJobId());
 
-        // Send SIGKILL
+        // Send SIGKILL (journaled as killed; the shell exits before reaping, so no rusage)
         kill(jobPtr->getPid(), SIGKILL);
+        JobJournal::jobFinished(jobPtr->getPid(), SIGKILL, nullptr);
+        for (pid_t helper : jobPtr->getHelperPids()) kill(helper, SIGKILL);
 
         delete jobPtr;
     }
     m_jobsMap.clear();
+    notifyChanged();
 }
 
 void JobsList::removeJobByIdWithoutKillingIt(int jobId) {
+    // A job that leaves the list (fg) must not stay gated
+    m_submitQueue.release(jobId);
+
     auto it = m_jobsMap.find(jobId);
     if (it != m_jobsMap.end()) {
         JobEntry* jobPtr = it->second;
@@ -140,9 +205,22 @@ void JobsList::removeJobByIdWithoutKillingIt(int jobId) {
         m_stoppedJobsQueue.erase(std::remove(m_stoppedJobsQueue.begin(), m_stoppedJobsQueue.end(), jobPtr), m_stoppedJobsQueue.end());
 
         delete jobPtr;
+        notifyChanged();
     }
 }
 
+bool JobsList::queueJob(int jobId, const int gate[2], const SubmitLimits &limits) {
+    JobEntry *job = getJobById(jobId);
+    if (job == nullptr || !m_submitQueue.enqueue(job->getPid(), jobId, gate, limits)) return false;
+    job->setQueued(m_submitQueue.isQueued(jobId));
+    return true;
+}
+
+void JobsList::notifyChanged() {
+    Metrics::setActiveJobs(m_jobsMap.size());
+    JobTableShm::publish(*this);
+}
+
 // ==================================================================================
 //                                  Lookups & Getters
 // ==================================================================================
@@ -183,6 +261,8 @@ JobsList::JobEntry* JobsList::getLastStoppedJob(int *jobId) {
 
 void JobsList::printJobsList() {
     for (const auto & job : m_jobsMap) {
+        // Admission happens in a signal handler, so the flag is refreshed here
+        job.second->setQueued(m_submitQueue.isQueued(job.first));
         cout << *job.second;
     }
 }
\ No newline at end of file
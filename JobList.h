@@ -8,6 +8,7 @@
 #include <set>
 #include <iostream>
 #include <ctime>
+#include "JobQueue.h"
 
 // Same macros as in SmallShell.h to ensure consistency
 #define COMMAND_MAX_LENGTH (200)
@@ -37,11 +38,23 @@ public:
         bool m_isStopped;
         time_t m_insertionTime;
 
+        // Process substitution children - the job ends when they are reaped as well
+        vector<pid_t> m_helperPids;
+        bool m_exited;
+
+        // Submitted and still waiting for admission, as of the last 'jobs'
+        bool m_queued;
+
     public:
         // ----------------------- Constr & Destr -----------------------------------
-        JobEntry(pid_t pid, int jobId, const string &cmd_line, bool isStopped = false, const string &print_cmd_line = "");
+        JobEntry(pid_t pid, int jobId, const string &cmd_line, bool isStopped = false, const string &print_cmd_line = "",
+                 const vector<pid_t> &helperPids = vector<pid_t>());
         ~JobEntry() = default;
 
+        // Entries are carved from a slab pool, see JobList.cpp
+        static void *operator new(std::size_t size);
+        static void operator delete(void *entry);
+
         // --------------------------- Getters --------------------------------------
         pid_t getPid() const { return m_pid; }
         int getJobId() const { return m_jobId; }
@@ -49,6 +62,14 @@ public:
         string getPrintCommandLine() const { return m_org_commandLine; }
         bool getStopped() const { return m_isStopped; }
         time_t getInsertionTime() const { return m_insertionTime; }
+        const vector<pid_t> &getHelperPids() const { return m_helperPids; }
+        bool hasExited() const { return m_exited; }
+        void setExited() { m_exited = true; }
+        bool getQueued() const { return m_queued; }
+        void setQueued(bool queued) { m_queued = queued; }
+
+        // Reaps the helpers that are done (WNOHANG); true once none are left
+        bool reapHelpers();
     };
 
 private:
@@ -61,8 +82,15 @@ private:
     deque<JobEntry*> m_runningJobsQueue;
     deque<JobEntry*> m_stoppedJobsQueue;
 
+    // Jobs from 'submit' waiting for a slot (and the admitted ones, until they exit)
+    JobQueue m_submitQueue;
+
     // ---------------------------- Friend Declarations -----------------------------
     friend std::ostream& operator<<(std::ostream&, const JobEntry&);
+    friend class JobTableShm;
+
+    // Pushes the new state to observers (metrics gauge, shared-memory job table)
+    void notifyChanged();
 
 public:
     // ==============================================================================
@@ -76,7 +104,8 @@ public:
     // ==============================================================================
 
     // Add a new job to the list (running or stopped)
-    void addJob(pid_t pid, const string& proccesed_cmd_line, bool isStopped = false, int jobId = -1, const string &print_cmd_line = "");
+    void addJob(pid_t pid, const string& proccesed_cmd_line, bool isStopped = false, int jobId = -1, const string &print_cmd_line = "",
+                const vector<pid_t> &helperPids = vector<pid_t>());
 
     // Removes finished jobs from the list (zombie cleanup)
     void removeFinishedJobs();
@@ -87,6 +116,11 @@ public:
     // Remove a specific job by ID from the data structures without sending a signal
     void removeJobByIdWithoutKillingIt(int jobId);
 
+    // Puts the gated process of job 'jobId' (already added) in the submit queue
+    bool queueJob(int jobId, const int gate[2], const SubmitLimits &limits);
+    bool isSubmitQueueFull() const { return m_submitQueue.isFull(); }
+    void closeSubmitGatesInChild() { m_submitQueue.closeGatesInChild(); }
+
     // ==============================================================================
     //                              Lookup & Access
     // ==============================================================================
@@ -0,0 +1,219 @@
+//
+// Created by Nikita Matrosov on 05/01/2026.
+//
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <cerrno>
+#include <cstdio>
+#include "JobQueue.h"
+
+JobQueue *JobQueue::s_owner = nullptr;
+pid_t JobQueue::s_ownerPid = -1;
+
+namespace {
+
+// Keeps SIGCHLD and SIGALRM (the admission handlers) off while the shell edits the table
+class SignalsHeld {
+private:
+    sigset_t m_old;
+public:
+    SignalsHeld() {
+        sigset_t set;
+        sigemptyset(&set);
+        sigaddset(&set, SIGCHLD);
+        sigaddset(&set, SIGALRM);
+        sigprocmask(SIG_BLOCK, &set, &m_old);
+    }
+    ~SignalsHeld() { sigprocmask(SIG_SETMASK, &m_old, nullptr); }
+};
+
+}
+
+JobQueue::JobQueue() : m_nextSeq(0) {
+    for (Slot &slot : m_slots) {
+        slot.state = FREE;
+        slot.pid = -1;
+        slot.jobId = -1;
+        slot.gate[0] = slot.gate[1] = -1;
+    }
+}
+
+// ==================================================================================
+//                                Signal Side
+// ==================================================================================
+
+void JobQueue::onSignal(int) {
+    // A forked child of the shell inherits the handler and a copy of the table
+    if (s_owner == nullptr || getpid() != s_ownerPid) return;
+    int savedErrno = errno;
+    s_owner->admit();
+    errno = savedErrno;
+}
+
+bool JobQueue::isAlive(pid_t pid) {
+    siginfo_t info;
+    info.si_pid = 0;
+    // WNOWAIT: only look, the job list reaps it. ECHILD: it was reaped already
+    if (waitid(P_PID, (id_t) pid, &info, WEXITED | WNOHANG | WNOWAIT) == -1) return false;
+    return info.si_pid == 0;
+}
+
+void JobQueue::openGate(Slot &slot) {
+    ssize_t n;
+    do {
+        n = write(slot.gate[1], "", 1);
+    } while (n == -1 && errno == EINTR);
+    closeGate(slot);
+}
+
+void JobQueue::closeGate(Slot &slot) {
+    if (slot.gate[0] != -1) close(slot.gate[0]);
+    if (slot.gate[1] != -1) close(slot.gate[1]);
+    slot.gate[0] = slot.gate[1] = -1;
+}
+
+double JobQueue::loadAverage() {
+    int fd = open("/proc/loadavg", O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return -1;
+    char buf[64];
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0) return -1;
+    buf[n] = '\0';
+
+    // "0.42 0.37 0.30 1/123 4567" - no strtod here, it is not async-signal-safe
+    double load = 0, scale = 0;
+    for (const char *p = buf; *p != '\0' && *p != ' '; ++p) {
+        if (*p == '.') {
+            scale = 1;
+        } else if (*p >= '0' && *p <= '9') {
+            load = load * 10 + (*p - '0');
+            scale *= 10;
+        } else {
+            return -1;
+        }
+    }
+    return (scale > 0) ? load / scale : load;
+}
+
+void JobQueue::admit() {
+    // 1. Drop what exited: admitted jobs free their slot, killed queued ones their gate
+    int running = 0;
+    for (Slot &slot : m_slots) {
+        if (slot.state == FREE) continue;
+        if (!isAlive(slot.pid)) {
+            closeGate(slot);
+            slot.state = FREE;
+        } else if (slot.state == ADMITTED) {
+            ++running;
+        }
+    }
+
+    // 2. The best queued job goes next, while it fits; one that does not fit blocks
+    // the ones behind it, so an order is never overtaken
+    double load = -2;   // read once, and only if a limit needs it
+    while (true) {
+        Slot *next = nullptr;
+        for (Slot &slot : m_slots) {
+            if (slot.state != QUEUED) continue;
+            if (next == nullptr || slot.limits.priority > next->limits.priority ||
+                (slot.limits.priority == next->limits.priority && slot.seq < next->seq)) {
+                next = &slot;
+            }
+        }
+        if (next == nullptr || running >= next->limits.maxRunning) return;
+        if (next->limits.maxLoad > 0) {
+            if (load == -2) load = loadAverage();
+            if (load >= next->limits.maxLoad) {
+                alarm(LOAD_RECHECK_SEC);
+                return;
+            }
+        }
+        openGate(*next);
+        next->state = ADMITTED;
+        ++running;
+    }
+}
+
+// ==================================================================================
+//                                Shell Side
+// ==================================================================================
+
+bool JobQueue::isFull() const {
+    for (const Slot &slot : m_slots) {
+        if (slot.state == FREE) return false;
+    }
+    return true;
+}
+
+bool JobQueue::enqueue(pid_t pid, int jobId, const int gate[2], const SubmitLimits &limits) {
+    if (s_owner == nullptr) {
+        struct sigaction sa;
+        sa.sa_handler = onSignal;
+        sa.sa_flags = SA_RESTART | SA_NOCLDSTOP; // the prompt's read() carries on
+        sigemptyset(&sa.sa_mask);
+        sigaddset(&sa.sa_mask, SIGCHLD);
+        sigaddset(&sa.sa_mask, SIGALRM);
+        if (sigaction(SIGCHLD, &sa, nullptr) == -1 || sigaction(SIGALRM, &sa, nullptr) == -1) {
+            perror("smash error: sigaction failed");
+            return false;
+        }
+        s_owner = this;
+        s_ownerPid = getpid();
+
+        // A server worker starts with SIGCHLD blocked (signalfd in the server)
+        sigset_t set;
+        sigemptyset(&set);
+        sigaddset(&set, SIGCHLD);
+        sigaddset(&set, SIGALRM);
+        sigprocmask(SIG_UNBLOCK, &set, nullptr);
+    }
+
+    SignalsHeld held;
+    for (Slot &slot : m_slots) {
+        if (slot.state != FREE) continue;
+        slot.pid = pid;
+        slot.jobId = jobId;
+        slot.gate[0] = gate[0];
+        slot.gate[1] = gate[1];
+        slot.limits = limits;
+        slot.seq = m_nextSeq++;
+        slot.state = QUEUED;
+        admit();
+        return true;
+    }
+    return false;
+}
+
+bool JobQueue::isQueued(int jobId) const {
+    for (const Slot &slot : m_slots) {
+        if (slot.state == QUEUED && slot.jobId == jobId) return true;
+    }
+    return false;
+}
+
+void JobQueue::release(int jobId) {
+    SignalsHeld held;
+    for (Slot &slot : m_slots) {
+        if (slot.state == QUEUED && slot.jobId == jobId) {
+            openGate(slot);
+            slot.state = ADMITTED;
+        }
+    }
+}
+
+void JobQueue::clear() {
+    SignalsHeld held;
+    for (Slot &slot : m_slots) {
+        closeGate(slot);
+        slot.state = FREE;
+    }
+    if (s_owner == this) alarm(0);
+}
+
+void JobQueue::closeGatesInChild() {
+    // The table is this process's own copy; the shell's is untouched
+    for (Slot &slot : m_slots) closeGate(slot);
+}
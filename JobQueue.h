@@ -0,0 +1,91 @@
+#ifndef SMASH_JOB_QUEUE_H_
+#define SMASH_JOB_QUEUE_H_
+
+#include <sys/types.h>
+#include <csignal>
+
+// Admission limits of one 'submit'
+struct SubmitLimits {
+    int maxRunning;     // submitted jobs running at once, this one included
+    double maxLoad;     // 1-minute /proc/loadavg must be below this; <= 0: no limit
+    int priority;       // higher is admitted first; FIFO among equals
+};
+
+// ==================================================================================
+//                                Class: JobQueue
+// ==================================================================================
+// The jobs started by 'submit' that wait for a slot, owned by JobsList. A queued
+// job is already a process (and a job in 'jobs'). It was forked by submit and is
+// blocked reading a "gate" pipe. Admitting it means writing one byte to the gate.
+//
+// Admission runs from SIGCHLD. The moment an admitted job exits, the handler
+// counts the submitted jobs still running and lets in the best queued ones that
+// fit. So the handler only uses async-signal-safe calls on a fixed table:
+// waitid(WNOWAIT), which does not reap and so leaves the job to removeFinishedJobs(),
+// plus read() of /proc/loadavg and write()/close() of the gates. The shell's own
+// changes to the table hold SIGCHLD and SIGALRM off.
+//
+// The load average only changes every 5 s in the kernel. A job held back by
+// --max-load alone is re-checked by alarm() on that period. Nothing else polls.
+class JobQueue {
+public:
+    static const int CAPACITY = 101;            // same as MAX_BG_JOBS
+    static const unsigned LOAD_RECHECK_SEC = 5; // the kernel's LOAD_FREQ
+
+private:
+    enum SlotState { FREE, QUEUED, ADMITTED };
+
+    struct Slot {
+        volatile sig_atomic_t state;
+        pid_t pid;
+        int jobId;
+        int gate[2];                // shell keeps both ends: a dead job's gate never SIGPIPEs
+        SubmitLimits limits;
+        unsigned long seq;
+    };
+
+    Slot m_slots[CAPACITY];
+    unsigned long m_nextSeq;
+
+    // Handlers go in on the first submit, for this process only (not forked children)
+    static JobQueue *s_owner;
+    static pid_t s_ownerPid;
+    static void onSignal(int sig);
+
+    static bool isAlive(pid_t pid);
+    void openGate(Slot &slot);
+    void closeGate(Slot &slot);
+
+    // Lets in what fits; async-signal-safe
+    void admit();
+
+public:
+    JobQueue();
+    ~JobQueue() = default;
+
+    JobQueue(JobQueue const &) = delete;
+    void operator=(JobQueue const &) = delete;
+
+    bool isFull() const;
+
+    // Queues the gated process 'pid' of job 'jobId' and admits it at once if it fits.
+    // The queue takes over both gate ends
+    bool enqueue(pid_t pid, int jobId, const int gate[2], const SubmitLimits &limits);
+
+    bool isQueued(int jobId) const;
+
+    // Admits a queued job now, over the limits (fg, or leaving the job list)
+    void release(int jobId);
+
+    // Forgets every entry (quit kill); the processes are killed by the caller
+    void clear();
+
+    // In a child just forked from the shell: closes the inherited gate ends, so only
+    // the shell can admit a queued job and its exit is seen as EOF on the gates
+    void closeGatesInChild();
+
+    // 1-minute load average from /proc/loadavg, -1 if unavailable; async-signal-safe
+    static double loadAverage();
+};
+
+#endif //SMASH_JOB_QUEUE_H_
@@ -0,0 +1,101 @@
+//
+// Created by Nikita Matrosov on 08/12/2025.
+//
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "JobTableShm.h"
+#include "JobList.h"
+
+// ==================================================================================
+//                                Static State
+// ==================================================================================
+
+namespace {
+
+std::string g_shmPath;
+pid_t g_ownerPid = 0;
+
+// Forked children run atexit handlers too - only the shell removes the file
+void unlinkJobTable() {
+    if (getpid() == g_ownerPid) unlink(g_shmPath.c_str());
+}
+
+}
+
+ShmJobTable *JobTableShm::s_table = nullptr;
+
+// ==================================================================================
+//                                Class: JobTableShm
+// ==================================================================================
+
+void JobTableShm::init() {
+    const char *value = getenv("SMASH_JOBS_SHM");
+    if (value == nullptr || *value == '\0') return;
+
+    g_shmPath = (strcmp(value, "1") == 0)
+                ? "/dev/shm/smash-" + std::to_string(getpid()) + ".jobs"
+                : std::string(value);
+
+    int fd = open(g_shmPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        perror("smash error: jobs shm: open failed");
+        return;
+    }
+    if (ftruncate(fd, sizeof(ShmJobTable)) == -1) {
+        perror("smash error: jobs shm: ftruncate failed");
+        close(fd);
+        return;
+    }
+
+    void *mem = mmap(nullptr, sizeof(ShmJobTable), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // the mapping keeps the file alive
+    if (mem == MAP_FAILED) {
+        perror("smash error: jobs shm: mmap failed");
+        return;
+    }
+
+    // The file was just truncated, so everything (including seq) starts at zero
+    ShmJobTable *table = static_cast<ShmJobTable *>(mem);
+    table->version = SHM_JOBS_VERSION;
+    table->capacity = SHM_JOBS_CAPACITY;
+    table->shellPid = getpid();
+    table->count = 0;
+    memcpy(table->magic, SHM_JOBS_MAGIC, sizeof(table->magic)); // written last: marks it valid
+
+    g_ownerPid = getpid();
+    atexit(unlinkJobTable);
+    s_table = table;
+}
+
+void JobTableShm::publish(const JobsList &jobs) {
+    // Pipeline children share the mapping but only hold a stale copy of the list
+    if (s_table == nullptr || getpid() != g_ownerPid) return;
+
+    uint64_t seq = s_table->seq.load(std::memory_order_relaxed);
+    s_table->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    uint32_t count = 0;
+    for (const auto &jobPair : jobs.m_jobsMap) {
+        if (count == SHM_JOBS_CAPACITY) break;
+        const JobsList::JobEntry *job = jobPair.second;
+        ShmJobRecord &rec = s_table->records[count++];
+
+        rec.jobId = job->getJobId();
+        rec.pid = job->getPid();
+        rec.state = job->getStopped() ? SHM_JOB_STOPPED : SHM_JOB_RUNNING;
+        rec.reserved = 0;
+        rec.startTime = job->getInsertionTime();
+        strncpy(rec.command, job->getPrintCommandLine().c_str(), SHM_JOBS_CMD_LEN - 1);
+        rec.command[SHM_JOBS_CMD_LEN - 1] = '\0';
+    }
+    s_table->count = count;
+
+    s_table->seq.store(seq + 2, std::memory_order_release);
+}
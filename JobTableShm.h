@@ -0,0 +1,83 @@
+#ifndef SMASH_JOB_TABLE_SHM_H_
+#define SMASH_JOB_TABLE_SHM_H_
+
+#include <atomic>
+#include <cstdint>
+#include <sys/types.h>
+
+// ==================================================================================
+//                            Shared-Memory Job Table
+// ==================================================================================
+// With SMASH_JOBS_SHM set, smash mirrors its jobs list into a memory-mapped file
+// (SMASH_JOBS_SHM=1 picks /dev/shm/smash-<pid>.jobs, any other value is the path).
+// The layout below is fixed and shared with external readers (see jobsreader.cpp).
+//
+// Consistency is provided by a seqlock: the shell bumps 'seq' to an odd value,
+// rewrites the records, then bumps it to the next even value. Readers copy the
+// table and retry if 'seq' was odd or changed meanwhile - no locks, no syscalls.
+
+#define SHM_JOBS_MAGIC "SMASHJT1"
+#define SHM_JOBS_VERSION (1)
+#define SHM_JOBS_CAPACITY (101)     // same as MAX_BG_JOBS
+#define SHM_JOBS_CMD_LEN (80)       // command lines are truncated to fit
+
+enum ShmJobState : int32_t {
+    SHM_JOB_RUNNING = 0,
+    SHM_JOB_STOPPED = 1
+};
+
+struct ShmJobRecord {
+    int32_t jobId;
+    int32_t pid;
+    int32_t state;                  // ShmJobState
+    int32_t reserved;
+    int64_t startTime;              // time(nullptr) when the job was added
+    char command[SHM_JOBS_CMD_LEN]; // NUL terminated
+};
+
+struct ShmJobTable {
+    char magic[8];
+    uint32_t version;
+    uint32_t capacity;
+    int32_t shellPid;
+    uint32_t count;                 // valid records
+    std::atomic<uint64_t> seq;      // odd while the shell is writing
+    ShmJobRecord records[SHM_JOBS_CAPACITY];
+};
+
+// Copies a consistent snapshot out of 'table' into 'out' (SHM_JOBS_CAPACITY
+// records) and returns the record count. Spins while the shell is mid-update.
+inline uint32_t readJobTableSnapshot(const ShmJobTable *table, ShmJobRecord *out) {
+    while (true) {
+        uint64_t before = table->seq.load(std::memory_order_acquire);
+        if (before & 1) continue;
+
+        uint32_t count = table->count;
+        if (count > SHM_JOBS_CAPACITY) count = SHM_JOBS_CAPACITY;
+        for (uint32_t i = 0; i < count; ++i) out[i] = table->records[i];
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (table->seq.load(std::memory_order_relaxed) == before) return count;
+    }
+}
+
+class JobsList;
+
+// ==================================================================================
+//                                Class: JobTableShm
+// ==================================================================================
+class JobTableShm {
+private:
+    static ShmJobTable *s_table;
+
+public:
+    // Reads SMASH_JOBS_SHM, creates and maps the file (called once from main)
+    static void init();
+
+    static bool isEnabled() { return s_table != nullptr; }
+
+    // Rewrites the table from the current jobs list (single writer: the shell)
+    static void publish(const JobsList &jobs);
+};
+
+#endif //SMASH_JOB_TABLE_SHM_H_
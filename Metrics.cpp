@@ -0,0 +1,215 @@
+//
+// Created by Nikita Matrosov on 06/12/2025.
+//
+
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include "Metrics.h"
+
+// ==================================================================================
+//                                Static State
+// ==================================================================================
+
+namespace {
+
+const double SPAWN_LATENCY_BOUNDS[Histogram::NUM_BUCKETS] = {
+        0.00005, 0.0001, 0.00025, 0.0005, 0.001, 0.0025,
+        0.005, 0.01, 0.025, 0.05, 0.1, 0.25
+};
+
+const double FOREGROUND_DURATION_BOUNDS[Histogram::NUM_BUCKETS] = {
+        0.001, 0.005, 0.01, 0.05, 0.1, 0.25,
+        0.5, 1, 2.5, 5, 10, 60
+};
+
+const char *const COMMAND_TYPE_NAMES[Metrics::CMD_TYPES] = {
+        "builtin", "external", "pipe", "redirection"
+};
+
+std::string g_socketPath;
+pid_t g_ownerPid = 0;
+
+// Forked children run atexit handlers too - only the shell owns the socket file
+void unlinkSocket() {
+    if (getpid() == g_ownerPid) unlink(g_socketPath.c_str());
+}
+
+}
+
+bool Metrics::s_enabled = false;
+std::atomic<uint64_t> Metrics::s_commands[Metrics::CMD_TYPES];
+std::atomic<uint64_t> Metrics::s_forkFailures(0);
+std::atomic<uint64_t> Metrics::s_execFailures(0);
+std::atomic<int64_t> Metrics::s_activeJobs(0);
+Histogram Metrics::s_spawnLatency(SPAWN_LATENCY_BOUNDS);
+Histogram Metrics::s_foregroundDuration(FOREGROUND_DURATION_BOUNDS);
+
+// ==================================================================================
+//                                Class: Histogram
+// ==================================================================================
+
+Histogram::Histogram(const double *bounds) : m_bounds(bounds), m_sumNanos(0), m_count(0) {
+    for (auto &bucket : m_buckets) bucket.store(0, std::memory_order_relaxed);
+}
+
+void Histogram::observe(double seconds) {
+    int i = 0;
+    while (i < NUM_BUCKETS && seconds > m_bounds[i]) ++i;
+
+    m_buckets[i].fetch_add(1, std::memory_order_relaxed);
+    m_sumNanos.fetch_add((uint64_t) (seconds * 1e9), std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Histogram::render(std::string &out, const char *name, const char *help) const {
+    char line[256];
+    snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+    out += line;
+
+    uint64_t cumulative = 0;
+    for (int i = 0; i <= NUM_BUCKETS; ++i) {
+        cumulative += m_buckets[i].load(std::memory_order_relaxed);
+        if (i < NUM_BUCKETS)
+            snprintf(line, sizeof(line), "%s_bucket{le=\"%g\"} %llu\n", name, m_bounds[i],
+                     (unsigned long long) cumulative);
+        else
+            snprintf(line, sizeof(line), "%s_bucket{le=\"+Inf\"} %llu\n", name,
+                     (unsigned long long) cumulative);
+        out += line;
+    }
+
+    snprintf(line, sizeof(line), "%s_sum %.9f\n%s_count %llu\n",
+             name, m_sumNanos.load(std::memory_order_relaxed) / 1e9,
+             name, (unsigned long long) m_count.load(std::memory_order_relaxed));
+    out += line;
+}
+
+// ==================================================================================
+//                                Class: Metrics
+// ==================================================================================
+
+void Metrics::init() {
+    const char *path = getenv("SMASH_METRICS");
+    if (path == nullptr || *path == '\0') return;
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "smash error: metrics: socket path too long\n");
+        return;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        perror("smash error: metrics: socket failed");
+        return;
+    }
+    // A stale socket from a previous run is replaced; anything else at the path is not
+    struct stat st;
+    if (lstat(path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            fprintf(stderr, "smash error: metrics: %s exists and is not a socket\n", path);
+            close(fd);
+            return;
+        }
+        unlink(path);
+    }
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1 || listen(fd, 16) == -1) {
+        perror("smash error: metrics: bind failed");
+        close(fd);
+        return;
+    }
+
+    g_socketPath = path;
+    g_ownerPid = getpid();
+    atexit(unlinkSocket);
+
+    // The exporter thread must never receive ctrl-C - block everything while
+    // creating it so it inherits a full signal mask
+    sigset_t all, prev;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &prev);
+    std::thread(Metrics::serve, fd).detach();
+    pthread_sigmask(SIG_SETMASK, &prev, nullptr);
+
+    s_enabled = true;
+}
+
+void Metrics::serve(int listenFd) {
+    while (true) {
+        int client = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client == -1) continue;
+
+        // HTTP clients send a request line first; raw clients (socat, nc) may not
+        char req[512];
+        bool http = false;
+        struct pollfd pfd = {client, POLLIN, 0};
+        if (poll(&pfd, 1, 50) > 0) {
+            ssize_t n = recv(client, req, sizeof(req), 0);
+            http = (n >= 4 && strncmp(req, "GET ", 4) == 0);
+        }
+
+        std::string body = render();
+        std::string response;
+        if (http) {
+            response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                       "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n";
+        }
+        response += body;
+
+        const char *p = response.data();
+        std::size_t left = response.size();
+        while (left > 0) {
+            ssize_t n = send(client, p, left, MSG_NOSIGNAL);
+            if (n <= 0) break;
+            p += n;
+            left -= n;
+        }
+        close(client);
+    }
+}
+
+std::string Metrics::render() {
+    std::string out;
+    char line[1024];
+
+    out += "# HELP smash_commands_total Commands executed, by type.\n"
+           "# TYPE smash_commands_total counter\n";
+    for (int t = 0; t < CMD_TYPES; ++t) {
+        snprintf(line, sizeof(line), "smash_commands_total{type=\"%s\"} %llu\n",
+                 COMMAND_TYPE_NAMES[t], (unsigned long long) s_commands[t].load(std::memory_order_relaxed));
+        out += line;
+    }
+
+    snprintf(line, sizeof(line),
+             "# HELP smash_fork_failures_total Failed fork() calls.\n"
+             "# TYPE smash_fork_failures_total counter\n"
+             "smash_fork_failures_total %llu\n"
+             "# HELP smash_exec_failures_total Children whose exec failed.\n"
+             "# TYPE smash_exec_failures_total counter\n"
+             "smash_exec_failures_total %llu\n"
+             "# HELP smash_active_jobs Jobs in the jobs list.\n"
+             "# TYPE smash_active_jobs gauge\n"
+             "smash_active_jobs %lld\n",
+             (unsigned long long) s_forkFailures.load(std::memory_order_relaxed),
+             (unsigned long long) s_execFailures.load(std::memory_order_relaxed),
+             (long long) s_activeJobs.load(std::memory_order_relaxed));
+    out += line;
+
+    s_spawnLatency.render(out, "smash_spawn_latency_seconds",
+                          "Time from fork() until the child exec'ed, for simple external commands (not pipeline stages).");
+    s_foregroundDuration.render(out, "smash_foreground_duration_seconds",
+                                "Wall time of foreground commands.");
+    return out;
+}
@@ -0,0 +1,79 @@
+#ifndef SMASH_METRICS_H_
+#define SMASH_METRICS_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// ==================================================================================
+//                                Metrics Exporter
+// ==================================================================================
+// Optional Prometheus text exporter. When SMASH_METRICS=<socket path> is set, a
+// background thread serves the current values on that Unix domain socket (plain
+// text, or an HTTP response if the client sends a GET). Updates on the hot path are
+// relaxed atomic increments - no locks, no syscalls - and the scraper only reads.
+
+// ==================================================================================
+//                                Class: Histogram
+// ==================================================================================
+// Fixed-bucket histogram of durations; buckets are stored non-cumulative and
+// summed up at scrape time.
+class Histogram {
+public:
+    static const int NUM_BUCKETS = 12;
+
+private:
+    const double *m_bounds;                 // upper bounds in seconds, NUM_BUCKETS entries
+    std::atomic<uint64_t> m_buckets[NUM_BUCKETS + 1]; // last one is +Inf
+    std::atomic<uint64_t> m_sumNanos;
+    std::atomic<uint64_t> m_count;
+
+public:
+    explicit Histogram(const double *bounds);
+
+    void observe(double seconds);
+
+    // Appends the _bucket/_sum/_count series in exposition format
+    void render(std::string &out, const char *name, const char *help) const;
+};
+
+// ==================================================================================
+//                                Class: Metrics
+// ==================================================================================
+class Metrics {
+public:
+    enum CommandType { CMD_BUILTIN = 0, CMD_EXTERNAL, CMD_PIPE, CMD_REDIRECTION, CMD_TYPES };
+
+private:
+    static bool s_enabled;
+    static std::atomic<uint64_t> s_commands[CMD_TYPES];
+    static std::atomic<uint64_t> s_forkFailures;
+    static std::atomic<uint64_t> s_execFailures;
+    static std::atomic<int64_t> s_activeJobs;
+    static Histogram s_spawnLatency;
+    static Histogram s_foregroundDuration;
+
+    static void serve(int listenFd);
+
+public:
+    // Reads SMASH_METRICS and starts the exporter thread (called once from main)
+    static void init();
+
+    // True when the exporter is running; used to skip optional measurements
+    static bool isEnabled() { return s_enabled; }
+
+    static void countCommand(CommandType type) {
+        s_commands[type].fetch_add(1, std::memory_order_relaxed);
+    }
+    static void countForkFailure() { s_forkFailures.fetch_add(1, std::memory_order_relaxed); }
+    static void countExecFailure() { s_execFailures.fetch_add(1, std::memory_order_relaxed); }
+    static void setActiveJobs(int64_t n) { s_activeJobs.store(n, std::memory_order_relaxed); }
+
+    static void observeSpawnLatency(double seconds) { s_spawnLatency.observe(seconds); }
+    static void observeForegroundDuration(double seconds) { s_foregroundDuration.observe(seconds); }
+
+    // Full exposition text (what a scrape returns)
+    static std::string render();
+};
+
+#endif //SMASH_METRICS_H_
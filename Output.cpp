@@ -0,0 +1,166 @@
+//
+// Created by Nikita Matrosov on 28/12/2025.
+//
+
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include "Output.h"
+#include "Trace.h"
+
+// ==================================================================================
+//                                Static State
+// ==================================================================================
+
+namespace {
+
+const std::size_t CHUNK_SIZE = 16 * 1024;       // a chunk is appended to until it is this big
+const std::size_t FLUSH_THRESHOLD = 64 * 1024;  // pending bytes that force a write mid-command
+
+struct Chunk {
+    int fd;
+    std::string data;
+};
+
+// Heap-allocated and never freed: cout may still be flushed after static destructors ran
+std::vector<Chunk> *g_chunks = nullptr;
+std::size_t g_used = 0;         // chunks in use; the rest keep their capacity for reuse
+std::size_t g_pending = 0;
+int g_batchDepth = 0;
+
+void append(int fd, const char *data, std::size_t len) {
+    std::vector<Chunk> &chunks = *g_chunks;
+    if (g_used == 0 || chunks[g_used - 1].fd != fd ||
+        (!chunks[g_used - 1].data.empty() && chunks[g_used - 1].data.size() + len > CHUNK_SIZE)) {
+        if (g_used == chunks.size()) chunks.push_back(Chunk());
+        chunks[g_used].fd = fd;
+        chunks[g_used].data.clear();
+        ++g_used;
+    }
+    chunks[g_used - 1].data.append(data, len);
+    g_pending += len;
+    if (g_pending >= FLUSH_THRESHOLD) ShellOutput::flush();
+}
+
+/**
+ * Writes all of 'iov' to 'fd', resuming after short writes. Output that cannot
+ * be written (closed pipe, bad fd) is dropped, as a failed cout write would be.
+ */
+void writeAll(int fd, std::vector<struct iovec> &iov) {
+    std::size_t first = 0;
+    while (first < iov.size()) {
+        int count = (int) std::min<std::size_t>(iov.size() - first, IOV_MAX);
+        ssize_t n = writev(fd, &iov[first], count);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) return;
+
+        while (first < iov.size() && (std::size_t) n >= iov[first].iov_len) {
+            n -= iov[first].iov_len;
+            ++first;
+        }
+        if (n > 0) {
+            iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + n;
+            iov[first].iov_len -= n;
+        }
+    }
+}
+
+/**
+ * cout/cerr buffer: hands every write to append() for its fd. No put area of its
+ * own, so output from both streams lands in the chunk list in program order.
+ */
+class BatchingBuf : public std::streambuf {
+private:
+    int m_fd;
+
+protected:
+    int_type overflow(int_type c) override {
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            char ch = traits_type::to_char_type(c);
+            append(m_fd, &ch, 1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char *s, std::streamsize n) override {
+        append(m_fd, s, n);
+        return n;
+    }
+
+    // std::endl / flush(): deferred to the end of the command while batching
+    int sync() override {
+        if (g_batchDepth == 0) ShellOutput::flush();
+        return 0;
+    }
+
+public:
+    explicit BatchingBuf(int fd) : m_fd(fd) {}
+};
+
+void flushBeforeFork() {
+    ShellOutput::flush();
+}
+
+// The child starts with nothing pending; whatever it prints goes out on flush
+void unbatchInChild() {
+    g_batchDepth = 0;
+}
+
+void flushAtExit() {
+    ShellOutput::flush();
+}
+
+}
+
+// ==================================================================================
+//                                Class: ShellOutput
+// ==================================================================================
+
+void ShellOutput::init() {
+    if (g_chunks != nullptr) return;
+    g_chunks = new std::vector<Chunk>();
+    std::cout.rdbuf(new BatchingBuf(STDOUT_FILENO));
+    std::cerr.rdbuf(new BatchingBuf(STDERR_FILENO));
+    pthread_atfork(flushBeforeFork, nullptr, unbatchInChild);
+    atexit(flushAtExit);
+}
+
+void ShellOutput::flush() {
+    if (g_used == 0) return;
+    TRACE_SCOPE("output-flush");
+
+    // Forget the chunks first: a write that fails must not be retried forever
+    std::vector<Chunk> &chunks = *g_chunks;
+    std::size_t used = g_used;
+    g_used = 0;
+    g_pending = 0;
+
+    std::vector<struct iovec> iov;
+    for (std::size_t i = 0; i < used;) {
+        int fd = chunks[i].fd;
+        iov.clear();
+        for (; i < used && chunks[i].fd == fd; ++i) {
+            struct iovec v;
+            v.iov_base = &chunks[i].data[0];
+            v.iov_len = chunks[i].data.size();
+            if (v.iov_len > 0) iov.push_back(v);
+        }
+        writeAll(fd, iov);
+    }
+}
+
+ShellOutput::Batch::Batch() {
+    ++g_batchDepth;
+}
+
+ShellOutput::Batch::~Batch() {
+    // A forked child starts at depth 0, below the Batches it inherited
+    if (g_batchDepth > 0 && --g_batchDepth == 0) flush();
+}
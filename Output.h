@@ -0,0 +1,40 @@
+#ifndef SMASH_OUTPUT_H_
+#define SMASH_OUTPUT_H_
+
+// ==================================================================================
+//                                Class: ShellOutput
+// ==================================================================================
+// Batched stdout/stderr for the shell process. init() gives cout and cerr stream
+// buffers that append to one shared, ordered list of chunks instead of writing.
+// While a command runs (a Batch is alive), std::endl and flush() write nothing.
+// When the outermost Batch ends, the chunks are written with one writev() per run
+// of chunks for the same fd, so 'jobs' with a thousand entries is one syscall,
+// not a thousand. Interleaved stdout/stderr output keeps its order.
+//
+// Pending output is also written:
+//  - before fork() (pthread_atfork), so a child never inherits and repeats it;
+//    children start unbatched;
+//  - before descriptors are swapped or restored (FdSaver, bench);
+//  - before the shell blocks (waiting for a foreground child, sleep, watchproc);
+//  - once 64 KiB is pending, and at exit.
+// Outside a Batch (prompt, startup), a flush writes right away, as before.
+class ShellOutput {
+public:
+    // Installs the buffers on cout/cerr. Called once, before any command runs
+    static void init();
+
+    // Writes everything pending now
+    static void flush();
+
+    // Marks one command's run; nested Batches flush only when the outermost ends
+    class Batch {
+    public:
+        Batch();
+        ~Batch();
+
+        Batch(Batch const &) = delete;
+        void operator=(Batch const &) = delete;
+    };
+};
+
+#endif //SMASH_OUTPUT_H_
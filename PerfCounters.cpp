@@ -0,0 +1,120 @@
+//
+// Created by Nikita Matrosov on 03/01/2026.
+//
+
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "PerfCounters.h"
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+const char *PerfCounters::name(int event) {
+    static const char *const names[EVENT_COUNT] = {
+            "task-clock", "context-switches", "cpu-migrations", "page-faults", "cycles", "instructions"
+    };
+    return (event >= 0 && event < EVENT_COUNT) ? names[event] : "";
+}
+
+PerfCounters::~PerfCounters() {
+    for (int event = 0; event < EVENT_COUNT; ++event) {
+        for (int fd : m_fds[event]) close(fd);
+    }
+}
+
+#ifdef __linux__
+
+// ==================================================================================
+//                                perf_event_open
+// ==================================================================================
+
+namespace {
+
+struct EventSpec {
+    uint32_t type;
+    uint64_t config;
+};
+
+const EventSpec EVENTS[PerfCounters::EVENT_COUNT] = {
+        {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+        {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+        {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS},
+        {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+};
+
+int openEvent(const EventSpec &spec, pid_t task, bool userOnly) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = spec.type;
+    attr.config = spec.config;
+    attr.inherit = 1;
+    attr.exclude_hv = 1;
+    attr.exclude_kernel = userOnly ? 1 : 0;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int) syscall(__NR_perf_event_open, &attr, task, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+}
+
+bool PerfCounters::attach(const std::vector<pid_t> &tasks) {
+    for (pid_t task : tasks) {
+        for (int event = 0; event < EVENT_COUNT; ++event) {
+            int fd = openEvent(EVENTS[event], task, m_userOnly);
+            if (fd == -1 && (errno == EACCES || errno == EPERM) && !m_userOnly) {
+                m_userOnly = true; // perf_event_paranoid: no kernel-side counting for us
+                fd = openEvent(EVENTS[event], task, true);
+            }
+            if (fd == -1) {
+                // A task that already exited has nothing left to count; a missing
+                // hardware PMU just leaves its events out
+                if (EVENTS[event].type == PERF_TYPE_SOFTWARE && errno != ESRCH && m_fds[event].empty()) {
+                    std::cerr << "smash error: perfstat: perf_event_open " << name(event)
+                              << ": " << strerror(errno) << std::endl;
+                    return false;
+                }
+                continue;
+            }
+            m_fds[event].push_back(fd);
+        }
+    }
+    if (m_fds[TASK_CLOCK].empty()) {
+        std::cerr << "smash error: perfstat: no task to count" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void PerfCounters::read(double values[EVENT_COUNT]) const {
+    for (int event = 0; event < EVENT_COUNT; ++event) {
+        values[event] = m_fds[event].empty() ? -1 : 0;
+        for (int fd : m_fds[event]) {
+            uint64_t data[3];   // value, time enabled, time running
+            if (::read(fd, data, sizeof(data)) != (ssize_t) sizeof(data)) continue;
+            double value = (double) data[0];
+            if (data[2] > 0 && data[2] < data[1]) value *= (double) data[1] / data[2];
+            values[event] += value;
+        }
+    }
+}
+
+#else
+
+bool PerfCounters::attach(const std::vector<pid_t> &) {
+    std::cerr << "smash error: perfstat: only supported on Linux (perf_event_open)" << std::endl;
+    return false;
+}
+
+void PerfCounters::read(double values[EVENT_COUNT]) const {
+    for (int event = 0; event < EVENT_COUNT; ++event) values[event] = -1;
+}
+
+#endif
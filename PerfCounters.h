@@ -0,0 +1,51 @@
+#ifndef SMASH_PERF_COUNTERS_H_
+#define SMASH_PERF_COUNTERS_H_
+
+#include <sys/types.h>
+#include <vector>
+
+// ==================================================================================
+//                                Class: PerfCounters
+// ==================================================================================
+// perf_event_open(2) counters on a set of tasks, for 'perfstat'. The software
+// events (task-clock, context switches, CPU migrations, page faults) are kept by
+// the kernel itself and also work in VMs. Cycles and instructions are added when
+// the CPU exposes them. A hardware event that cannot be opened is reported as
+// "not supported" instead of failing.
+//
+// Every event is opened once per task with 'inherit' set. Threads and children
+// the task creates afterwards count towards it, and their counts are added when
+// they exit. Values are summed over the tasks. They are scaled by
+// enabled/running time when the kernel had to multiplex a hardware counter.
+// When kernel-side counting is not allowed (perf_event_paranoid), the events
+// are opened again for user space only. Linux only; attach() fails elsewhere.
+class PerfCounters {
+public:
+    enum Event { TASK_CLOCK, CONTEXT_SWITCHES, CPU_MIGRATIONS, PAGE_FAULTS, CYCLES, INSTRUCTIONS, EVENT_COUNT };
+
+private:
+    std::vector<int> m_fds[EVENT_COUNT];    // one per attached task
+    bool m_userOnly;
+
+public:
+    PerfCounters() : m_userOnly(false) {}
+    ~PerfCounters();
+
+    PerfCounters(PerfCounters const &) = delete;
+    void operator=(PerfCounters const &) = delete;
+
+    // "task-clock", "context-switches", ...
+    static const char *name(int event);
+
+    // Starts counting on each task. False (after printing why) if not even the
+    // software events could be opened on any of them
+    bool attach(const std::vector<pid_t> &tasks);
+
+    bool supported(int event) const { return !m_fds[event].empty(); }
+    bool userOnly() const { return m_userOnly; }
+
+    // Current totals; task-clock is in nanoseconds. -1 for an unsupported event
+    void read(double values[EVENT_COUNT]) const;
+};
+
+#endif //SMASH_PERF_COUNTERS_H_
@@ -0,0 +1,44 @@
+//
+// Created by Nikita Matrosov on 06/01/2026.
+//
+
+#include "Quoting.h"
+
+namespace {
+
+/**
+ * Index of the 'close' that balances the 'open' character at 'pos', or npos.
+ */
+std::size_t findClosing(const std::string &s, std::size_t pos, char open, char close) {
+    int depth = 0;
+    QuoteScan scan;
+    for (std::size_t i = pos; i < s.size(); ++i) {
+        if (scan.at(s, i) != QuoteScan::PLAIN) continue;
+        if (s[i] == open) {
+            ++depth;
+        } else if (s[i] == close && --depth == 0) {
+            return i;
+        }
+    }
+    return std::string::npos;
+}
+
+}
+
+std::string removeQuotes(const std::string &text) {
+    std::string value;
+    value.reserve(text.size());
+    QuoteScan scan;
+    for (std::size_t i = 0; i < text.size(); ++i) {
+        if (scan.at(text, i) != QuoteScan::SYNTAX) value += text[i];
+    }
+    return value;
+}
+
+std::size_t findClosingParen(const std::string &s, std::size_t open) {
+    return findClosing(s, open, '(', ')');
+}
+
+std::size_t findClosingBrace(const std::string &s, std::size_t open) {
+    return findClosing(s, open, '{', '}');
+}
@@ -0,0 +1,103 @@
+#ifndef SMASH_QUOTING_H_
+#define SMASH_QUOTING_H_
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+// ==================================================================================
+//                                Class: QuoteScan
+// ==================================================================================
+// The quoting rules, in one place, for every left-to-right scan over a command line
+// (tokenizer, pipe/redirection/operator search, expansion, quote removal):
+//   '...'      everything literal up to the next '
+//   "..."      literal, except that expansion still sees $ and `; a backslash
+//              escapes only $ ` " \ and newline, and is kept before anything else
+//   \c         outside quotes, c is literal and the backslash goes
+// Here-doc bodies follow the double-quote rules, except that " is an ordinary char.
+//
+// Each character is classified once, in order. A scan that only looks for operators
+// skips everything that is not PLAIN; quote removal drops SYNTAX.
+class QuoteScan {
+public:
+    enum Kind {
+        PLAIN,      // unquoted: blanks and operators mean something
+        QUOTED,     // inside "..." (or a here-doc body): literal, but $ still expands
+        LITERAL,    // inside '...' or escaped by \: literal to everyone
+        SYNTAX      // a quote or escaping \ itself: dropped by quote removal
+    };
+
+    enum Start { UNQUOTED, IN_DOUBLE, HERE_DOC };
+
+private:
+    char m_quote;       // 0, '\'', '"' or 'h' (here-doc body)
+    bool m_escaped;
+
+public:
+    explicit QuoteScan(Start start = UNQUOTED)
+            : m_quote(start == IN_DOUBLE ? '"' : (start == HERE_DOC ? 'h' : 0)), m_escaped(false) {}
+
+    /**
+     * Classifies 'c', the next character of the scan; 'following' is the one after it
+     * ('\0' at the end), which decides whether a backslash escapes.
+     */
+    Kind next(char c, char following) {
+        if (m_escaped) {
+            m_escaped = false;
+            return LITERAL;
+        }
+        if (m_quote == '\'') {
+            if (c != '\'') return LITERAL;
+            m_quote = 0;
+            return SYNTAX;
+        }
+        if (c == '\\') {
+            if (following == '\0') return m_quote ? QUOTED : LITERAL;
+            if (m_quote && strchr("$`\"\\\n", following) == nullptr) return QUOTED;
+            if (m_quote == 'h' && following == '"') return QUOTED;
+            m_escaped = true;
+            return SYNTAX;
+        }
+        if (m_quote == 'h') return QUOTED;
+        if (m_quote == '"') {
+            if (c != '"') return QUOTED;
+            m_quote = 0;
+            return SYNTAX;
+        }
+        if (c == '\'' || c == '"') {
+            m_quote = c;
+            return SYNTAX;
+        }
+        return PLAIN;
+    }
+
+    // next() for s[i] of a string
+    Kind at(const std::string &s, std::size_t i) {
+        return next(s[i], i + 1 < s.size() ? s[i + 1] : '\0');
+    }
+
+    // next() for s[i] of a NUL-terminated string
+    Kind at(const char *s, std::size_t i) {
+        return next(s[i], s[i] != '\0' ? s[i + 1] : '\0');
+    }
+
+    // Inside '...' or "..." after the last character scanned
+    bool inQuotes() const { return m_quote == '\'' || m_quote == '"'; }
+};
+
+/**
+ * Quote removal: 'text' without its quotes and escaping backslashes.
+ */
+std::string removeQuotes(const std::string &text);
+
+/**
+ * Index of the ')' closing the '(' at 'open' (quotes and nesting respected), or npos.
+ */
+std::size_t findClosingParen(const std::string &s, std::size_t open);
+
+/**
+ * Index of the '}' closing the '{' at 'open' (quotes and nesting respected), or npos.
+ */
+std::size_t findClosingBrace(const std::string &s, std::size_t open);
+
+#endif //SMASH_QUOTING_H_
@@ -0,0 +1,417 @@
+//
+// Created by Nikita Matrosov on 24/12/2025.
+//
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <unordered_map>
+#include "RcFile.h"
+#include "Script.h"
+#include "Quoting.h"
+#include "SmallShell.h"
+#include "Trace.h"
+
+// ==================================================================================
+//                                Snapshot Layout
+// ==================================================================================
+// Header, then 'recordCount' records: a RecordHeader followed by the key and value
+// bytes. Native byte order - a snapshot is a cache for this machine, not a format
+// to exchange. Any mismatch just makes smash run the rc file again.
+
+namespace {
+
+#define RC_SNAPSHOT_MAGIC "SMASHRC1"
+#define RC_SNAPSHOT_VERSION (1)
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordCount;
+    uint64_t rcSize;
+    int64_t rcMtimeSec;
+    int64_t rcMtimeNsec;
+    uint64_t rcHash;            // FNV-1a of the rc file contents
+    uint64_t payloadSize;       // bytes of records after the header
+    uint64_t payloadHash;       // FNV-1a of those bytes
+};
+
+enum RecordKind : uint32_t {
+    REC_DEPENDENCY = 1,         // key: variable the rc reads, value: FNV-1a of its value
+    REC_MISSING_DEPENDENCY = 2, // key: variable the rc reads that was unset
+    REC_ALIAS = 3,              // in 'alias' listing order
+    REC_ENV_SET = 4,
+    REC_ENV_UNSET = 5,
+    REC_VARIABLE = 6,
+    REC_PROMPT = 7              // value only
+};
+
+struct RecordHeader {
+    uint32_t kind;
+    uint32_t keyLen;
+    uint32_t valueLen;
+};
+
+const uint64_t FNV_OFFSET = 1469598103934665603ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+
+uint64_t fnv1a(const char *data, std::size_t len) {
+    uint64_t hash = FNV_OFFSET;
+    for (std::size_t i = 0; i < len; ++i) {
+        hash ^= (unsigned char) data[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+uint64_t fnv1a(const std::string &data) {
+    return fnv1a(data.data(), data.size());
+}
+
+#ifdef __APPLE__
+#define RC_MTIME(st) ((st).st_mtimespec)
+#else
+#define RC_MTIME(st) ((st).st_mtim)
+#endif
+
+struct RcInfo {
+    std::string path;
+    std::string contents;
+    struct stat st;
+};
+
+bool readRcFile(const std::string &path, RcInfo &rc) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return false;
+    if (fstat(fd, &rc.st) == -1 || !S_ISREG(rc.st.st_mode)) {
+        close(fd);
+        return false;
+    }
+
+    rc.path = path;
+    rc.contents.resize(rc.st.st_size);
+    std::size_t done = 0;
+    while (done < rc.contents.size()) {
+        ssize_t n = read(fd, &rc.contents[done], rc.contents.size() - done);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += n;
+    }
+    rc.contents.resize(done);
+    close(fd);
+    return true;
+}
+
+// ==================================================================================
+//                                Static Check
+// ==================================================================================
+
+bool isStateBuiltin(const std::string &word) {
+    return word == "alias" || word == "unalias" || word == "export" || word == "setenv" ||
+           word == "unsetenv" || word == "chprompt";
+}
+
+/**
+ * True if every line of the rc file only changes aliases, variables, the
+ * environment or the prompt, so its whole effect can be replayed from a snapshot.
+ * 'reads' receives the variables it expands ($NAME, ${NAME...}).
+ */
+bool isSnapshottable(const std::string &contents, std::set<std::string> &reads) {
+    std::istringstream lines(contents);
+    std::string line;
+    while (std::getline(lines, line)) {
+        std::string trimmed = _trim(line);
+        if (trimmed.empty() || trimmed[0] == '#') continue;
+        if (Script::isScript(trimmed)) return false;
+
+        std::vector<std::string> words;
+        tokenizeCommandLine(trimmed, words);
+        if (words.empty()) continue;
+        bool assignment = (words.size() == 1 && _isAssignmentWord(words[0]));
+        if (!assignment && !(isStateBuiltin(words[0]) && words.size() > 1)) return false;
+
+        // No processes, files or special parameters; note every $NAME read
+        QuoteScan scan;
+        for (std::size_t i = 0; i < trimmed.size(); ++i) {
+            char c = trimmed[i];
+            QuoteScan::Kind kind = scan.at(trimmed, i);
+            if (kind == QuoteScan::LITERAL || kind == QuoteScan::SYNTAX) continue;
+            if (c == '`') return false;
+            if (kind == QuoteScan::PLAIN && strchr("|&<>", c) != nullptr) return false;
+            if (c != '$' || i + 1 >= trimmed.size()) continue;
+
+            std::size_t start = i + 1;
+            if (trimmed[start] == '{') ++start;
+            std::size_t end = start;
+            while (end < trimmed.size() && (isalnum((unsigned char) trimmed[end]) || trimmed[end] == '_')) ++end;
+            if (end == start || isdigit((unsigned char) trimmed[start])) return false; // $( $? $$ $1 ...
+            reads.insert(trimmed.substr(start, end - start));
+            i = end - 1;
+        }
+    }
+    return true;
+}
+
+// ==================================================================================
+//                                Snapshot Read / Write
+// ==================================================================================
+
+void appendRecord(std::string &payload, uint32_t kind, const std::string &key, const std::string &value) {
+    RecordHeader rec;
+    rec.kind = kind;
+    rec.keyLen = (uint32_t) key.size();
+    rec.valueLen = (uint32_t) value.size();
+    payload.append(reinterpret_cast<const char*>(&rec), sizeof(rec));
+    payload += key;
+    payload += value;
+}
+
+std::string hashString(uint64_t hash) {
+    return std::string(reinterpret_cast<const char*>(&hash), sizeof(hash));
+}
+
+/**
+ * Maps the snapshot and, if it matches the rc file and the current environment,
+ * applies it. False (nothing applied) if it is missing, stale or damaged.
+ */
+bool applySnapshot(const std::string &path, const RcInfo &rc) {
+    TRACE_SCOPE("rc-snapshot-load");
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return false;
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (std::size_t) st.st_size < sizeof(SnapshotHeader)) {
+        close(fd);
+        return false;
+    }
+    void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) return false;
+
+    const char *base = static_cast<const char*>(mapped);
+    SnapshotHeader header;
+    memcpy(&header, base, sizeof(header));
+    const char *payload = base + sizeof(header);
+
+    bool valid = memcmp(header.magic, RC_SNAPSHOT_MAGIC, 8) == 0 &&
+                 header.version == RC_SNAPSHOT_VERSION &&
+                 header.payloadSize == (uint64_t) st.st_size - sizeof(header) &&
+                 header.rcSize == (uint64_t) rc.st.st_size &&
+                 header.rcMtimeSec == (int64_t) RC_MTIME(rc.st).tv_sec &&
+                 header.rcMtimeNsec == (int64_t) RC_MTIME(rc.st).tv_nsec &&
+                 header.rcHash == fnv1a(rc.contents) &&
+                 header.payloadHash == fnv1a(payload, header.payloadSize);
+
+    // Two passes over the records: check every dependency, then apply
+    SmallShell &smash = SmallShell::getInstance();
+    for (int pass = 0; pass < 2 && valid; ++pass) {
+        const char *pos = payload;
+        const char *end = payload + header.payloadSize;
+        for (uint32_t i = 0; i < header.recordCount && valid; ++i) {
+            RecordHeader rec;
+            if ((std::size_t) (end - pos) < sizeof(rec)) {
+                valid = false;
+                break;
+            }
+            memcpy(&rec, pos, sizeof(rec));
+            pos += sizeof(rec);
+            if ((std::size_t) (end - pos) < (std::size_t) rec.keyLen + rec.valueLen) {
+                valid = false;
+                break;
+            }
+            std::string key(pos, rec.keyLen);
+            std::string value(pos + rec.keyLen, rec.valueLen);
+            pos += rec.keyLen + rec.valueLen;
+
+            if (pass == 0) {
+                const std::string *current = smash.lookupVariable(key);
+                if (rec.kind == REC_DEPENDENCY) valid = (current != nullptr && hashString(fnv1a(*current)) == value);
+                else if (rec.kind == REC_MISSING_DEPENDENCY) valid = (current == nullptr);
+                continue;
+            }
+
+            switch (rec.kind) {
+                case REC_ALIAS:
+                    if (!smash.isAlias(key)) smash.addAlias(key, value);
+                    break;
+                case REC_ENV_SET:
+                    smash.getEnvironment().set(key, value);
+                    break;
+                case REC_ENV_UNSET:
+                    smash.getEnvironment().unset(key);
+                    break;
+                case REC_VARIABLE:
+                    smash.setVariable(key, value);
+                    break;
+                case REC_PROMPT:
+                    smash.setPrompt(value);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+    munmap(mapped, st.st_size);
+    return valid;
+}
+
+struct ShellState {
+    std::unordered_map<std::string, std::string> environment;
+    std::unordered_map<std::string, std::string> variables;
+    std::string prompt;
+};
+
+void captureState(ShellState &state) {
+    SmallShell &smash = SmallShell::getInstance();
+    state.environment = smash.getEnvironment().vars();
+    state.variables = smash.getVariables();
+    state.prompt = smash.getPrompt();
+}
+
+/**
+ * Writes what running the rc file changed ('before' -> now) as a snapshot. The
+ * file is written next to its final path and renamed over it.
+ */
+void writeSnapshot(const std::string &path, const RcInfo &rc, const std::set<std::string> &reads,
+                   const std::unordered_map<std::string, const std::string*> &readValues,
+                   const ShellState &before) {
+    SmallShell &smash = SmallShell::getInstance();
+    std::string payload;
+    uint32_t count = 0;
+
+    for (const auto &name : reads) {
+        const std::string *value = readValues.at(name);
+        if (value != nullptr) appendRecord(payload, REC_DEPENDENCY, name, hashString(fnv1a(*value)));
+        else appendRecord(payload, REC_MISSING_DEPENDENCY, name, "");
+        ++count;
+    }
+    for (const auto &alias : smash.getAliasOrder()) {
+        appendRecord(payload, REC_ALIAS, alias, smash.getAliasMeaning(alias));
+        ++count;
+    }
+
+    const auto &environment = smash.getEnvironment().vars();
+    for (const auto &var : environment) {
+        auto old = before.environment.find(var.first);
+        if (old != before.environment.end() && old->second == var.second) continue;
+        appendRecord(payload, REC_ENV_SET, var.first, var.second);
+        ++count;
+    }
+    for (const auto &var : before.environment) {
+        if (environment.count(var.first)) continue;
+        appendRecord(payload, REC_ENV_UNSET, var.first, "");
+        ++count;
+    }
+    for (const auto &var : smash.getVariables()) {
+        auto old = before.variables.find(var.first);
+        if (old != before.variables.end() && old->second == var.second) continue;
+        appendRecord(payload, REC_VARIABLE, var.first, var.second);
+        ++count;
+    }
+    if (smash.getPrompt() != before.prompt) {
+        appendRecord(payload, REC_PROMPT, "", smash.getPrompt());
+        ++count;
+    }
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RC_SNAPSHOT_MAGIC, 8);
+    header.version = RC_SNAPSHOT_VERSION;
+    header.recordCount = count;
+    header.rcSize = rc.st.st_size;
+    header.rcMtimeSec = RC_MTIME(rc.st).tv_sec;
+    header.rcMtimeNsec = RC_MTIME(rc.st).tv_nsec;
+    header.rcHash = fnv1a(rc.contents);
+    header.payloadSize = payload.size();
+    header.payloadHash = fnv1a(payload);
+
+    std::string data(reinterpret_cast<const char*>(&header), sizeof(header));
+    data += payload;
+
+    // The snapshot holds environment values, so it is private to the user
+    std::string tmp = path + ".tmp." + std::to_string(getpid());
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd == -1) {
+        perror("smash error: rc snapshot: open failed");
+        return;
+    }
+    bool ok = (write(fd, data.data(), data.size()) == (ssize_t) data.size());
+    ok = (close(fd) == 0) && ok;
+    if (!ok || rename(tmp.c_str(), path.c_str()) == -1) {
+        perror("smash error: rc snapshot: write failed");
+        unlink(tmp.c_str());
+    }
+}
+
+}
+
+// ==================================================================================
+//                                Class: RcFile
+// ==================================================================================
+
+void RcFile::load() {
+    TRACE_SCOPE("rc-load");
+    std::string path;
+    const char *value = getenv("SMASH_RC");
+    if (value != nullptr) {
+        path = value;
+    } else if (getenv("HOME") != nullptr) {
+        path = std::string(getenv("HOME")) + "/.smashrc";
+    }
+    if (path.empty()) return;
+
+    RcInfo rc;
+    if (!readRcFile(path, rc)) return;
+
+    std::string snapshot;
+    value = getenv("SMASH_RC_SNAPSHOT");
+    if (value != nullptr && *value != '\0') {
+        snapshot = (strcmp(value, "1") == 0) ? path + ".snap" : value;
+        if (applySnapshot(snapshot, rc)) return;
+    }
+
+    // The values the rc file reads are taken before it runs, as a snapshot would see them
+    SmallShell &smash = SmallShell::getInstance();
+    std::set<std::string> reads;
+    bool snapshottable = !snapshot.empty() && isSnapshottable(rc.contents, reads);
+    std::unordered_map<std::string, std::string> readCopies;
+    std::unordered_map<std::string, const std::string*> readValues;
+    ShellState before;
+    if (snapshottable) {
+        for (const auto &name : reads) {
+            const std::string *current = smash.lookupVariable(name);
+            if (current != nullptr) readCopies[name] = *current;
+        }
+        for (const auto &name : reads) {
+            auto it = readCopies.find(name);
+            readValues[name] = (it == readCopies.end()) ? nullptr : &it->second;
+        }
+        captureState(before);
+    }
+
+    // Continuation lines of multi-line constructs come from the file too
+    std::istringstream input(rc.contents);
+    std::istream *previous = smash.getInputStream();
+    smash.setInputStream(&input);
+    std::string line;
+    while (std::getline(input, line)) {
+        smash.setLastStatus(0);
+        smash.executeCommand(line.c_str());
+        // A line that failed would fail silently from a snapshot: keep running the file
+        if (smash.getLastStatus() != 0) snapshottable = false;
+    }
+    smash.setInputStream(previous);
+    smash.setLastStatus(0);
+
+    if (snapshottable) writeSnapshot(snapshot, rc, reads, readValues, before);
+}
@@ -0,0 +1,27 @@
+#ifndef SMASH_RC_FILE_H_
+#define SMASH_RC_FILE_H_
+
+// ==================================================================================
+//                                Class: RcFile
+// ==================================================================================
+// Startup file: SMASH_RC names it (default ~/.smashrc, SMASH_RC= disables it).
+// Each line runs through executeCommand() before the first prompt. Multi-line
+// constructs (functions, loops) continue on the following lines of the file.
+//
+// With SMASH_RC_SNAPSHOT set (1 picks <rc>.snap, any other value is the path),
+// the state left by the rc file (aliases, environment, shell variables, prompt)
+// is also saved to a binary snapshot. The next startup maps the snapshot and
+// applies its records directly. Nothing is parsed and no alias regex runs. The
+// snapshot is used only if the rc file still has the same size, mtime and
+// content hash. Every environment variable the rc file reads ($NAME) must also
+// still have the same value. Only an rc file whose lines do nothing but change
+// that state is snapshotted: alias, unalias, export, setenv, unsetenv, chprompt
+// and NAME=value, with no command substitution, redirection or pipe, and none
+// of them failing. Any other rc file simply runs every time.
+class RcFile {
+public:
+    // Runs (or restores) the rc file. Called once from main(), before the REPL
+    static void load();
+};
+
+#endif //SMASH_RC_FILE_H_
@@ -0,0 +1,393 @@
+//
+// Created by Nikita Matrosov on 12/12/2025.
+//
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <cctype>
+#include <climits>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include "Redirection.h"
+#include "Expansion.h"
+#include "Quoting.h"
+#include "Trace.h"
+#include "Output.h"
+
+// ==================================================================================
+//                                Parsing Helpers
+// ==================================================================================
+
+namespace {
+
+// Descriptors the shell keeps for itself (saved copies, here-doc payloads) live
+// above the range users can name in a redirection
+const int SHELL_FD_BASE = 10;
+
+FdOp makeOp(FdOp::Kind kind, int targetFd, int sourceFd, int flags, const std::string &path) {
+    FdOp op;
+    op.kind = kind;
+    op.targetFd = targetFd;
+    op.sourceFd = sourceFd;
+    op.flags = flags;
+    op.path = path;
+    return op;
+}
+
+bool isWordBreak(char c) {
+    return isspace((unsigned char) c) || c == '<' || c == '>' || c == '|' || c == ';';
+}
+
+bool isAllDigits(const std::string &s) {
+    if (s.empty()) return false;
+    for (char c : s)
+        if (!isdigit((unsigned char) c)) return false;
+    return true;
+}
+
+/**
+ * Reads the redirection target starting at 'i' (leading blanks skipped) and
+ * removes its quotes. Leaves 'i' on the first character after the word.
+ * 'quoted' (if given) tells whether any part of the word was quoted or escaped.
+ */
+std::string readTargetWord(const std::string &line, std::size_t &i, bool *quoted = nullptr) {
+    while (i < line.size() && isspace((unsigned char) line[i])) ++i;
+
+    std::string word;
+    QuoteScan scan;
+    for (; i < line.size(); ++i) {
+        char c = line[i];
+        QuoteScan::Kind kind = scan.at(line, i);
+        if (kind == QuoteScan::PLAIN && isWordBreak(c)) break;
+        if (kind != QuoteScan::SYNTAX) word += c;
+        else if (quoted != nullptr) *quoted = true;
+    }
+    return word;
+}
+
+bool writeAll(int fd, const std::string &data) {
+    const char *p = data.data();
+    std::size_t left = data.size();
+    while (left > 0) {
+        ssize_t n = write(fd, p, left);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += n;
+        left -= n;
+    }
+    return true;
+}
+
+// Moves 'fd' to SHELL_FD_BASE or above (close-on-exec); returns the new fd or -1
+int moveToShellRange(int fd) {
+    if (fd == -1 || fd >= SHELL_FD_BASE) return fd;
+    int high = fcntl(fd, F_DUPFD_CLOEXEC, SHELL_FD_BASE);
+    close(fd);
+    return high;
+}
+
+}
+
+int makePayloadFd(const std::string &data) {
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) == -1) {
+        perror("smash error: pipe failed");
+        return -1;
+    }
+
+    // Fits in the pipe: write it all now, the reader gets EOF right after it
+    long capacity = PIPE_BUF;
+#ifdef F_GETPIPE_SZ
+    capacity = fcntl(fds[1], F_GETPIPE_SZ);
+#endif
+    if ((long) data.size() <= capacity) {
+        bool ok = writeAll(fds[1], data);
+        close(fds[1]);
+        if (!ok) {
+            perror("smash error: write failed");
+            close(fds[0]);
+            return -1;
+        }
+        return moveToShellRange(fds[0]);
+    }
+
+#ifdef MFD_CLOEXEC
+    // Too big for the pipe: a memfd holds any size without a reader on the other end
+    close(fds[0]);
+    close(fds[1]);
+    int fd = memfd_create("smash-payload", MFD_CLOEXEC);
+    if (fd == -1) {
+        perror("smash error: memfd_create failed");
+        return -1;
+    }
+    if (!writeAll(fd, data) || lseek(fd, 0, SEEK_SET) == -1) {
+        perror("smash error: write failed");
+        close(fd);
+        return -1;
+    }
+    return moveToShellRange(fd);
+#else
+    // No memfd: a detached thread feeds the pipe while the command reads it
+    int writeFd = fds[1];
+    sigset_t all, prev;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &prev);
+    std::thread([writeFd, data] {
+        writeAll(writeFd, data);
+        close(writeFd);
+    }).detach();
+    pthread_sigmask(SIG_SETMASK, &prev, nullptr);
+    return moveToShellRange(fds[0]);
+#endif
+}
+
+namespace {
+
+/**
+ * Reads a here-doc body from 'input' up to the 'delimiter' line.
+ */
+std::string readHereDocBody(std::istream *input, const std::string &delimiter, bool stripTabs) {
+    std::string body;
+    std::string bodyLine;
+    while (input != nullptr && std::getline(*input, bodyLine)) {
+        if (stripTabs) bodyLine.erase(0, bodyLine.find_first_not_of('\t'));
+        if (bodyLine == delimiter) return body;
+        body += bodyLine;
+        body += '\n';
+    }
+    std::cerr << "smash error: here-document: delimited by end-of-file (wanted '"
+              << delimiter << "')" << std::endl;
+    return body;
+}
+
+}
+
+// ==================================================================================
+//                                Parsing
+// ==================================================================================
+
+bool parseRedirections(const std::string &line, std::string &command, std::vector<FdOp> &ops) {
+    TRACE_SCOPE("redirect-parse");
+    command.clear();
+    ops.clear();
+
+    QuoteScan scan;
+    std::size_t i = 0;
+    while (i < line.size()) {
+        char c = line[i];
+
+        // Quoted or escaped text belongs to the command, operators included
+        if (scan.at(line, i) != QuoteScan::PLAIN) {
+            command += c;
+            ++i;
+            continue;
+        }
+
+        bool both = (c == '&' && i + 1 < line.size() && line[i + 1] == '>');
+        if (c != '<' && c != '>' && !both) {
+            command += c;
+            ++i;
+            continue;
+        }
+
+        // An explicit fd is a run of digits that starts a word: "2>" but not "a2>"
+        int fd = -1;
+        if (!both) {
+            std::size_t digits = command.find_last_not_of("0123456789") + 1;
+            if (digits < command.size() &&
+                (digits == 0 || isspace((unsigned char) command[digits - 1]))) {
+                fd = atoi(command.c_str() + digits);
+                command.erase(digits);
+            }
+        }
+
+        if (both) ++i;
+        char dir = line[i++];
+        bool append = false;
+        bool dup = false;
+        if (dir == '>' && i < line.size() && line[i] == '>') {
+            append = true;
+            ++i;
+        } else if (!both && i < line.size() && line[i] == '&') {
+            dup = true;
+            ++i;
+        }
+        if (fd == -1) fd = (dir == '<') ? STDIN_FILENO : STDOUT_FILENO;
+
+        std::string target = readTargetWord(line, i);
+        if (target.empty()) {
+            std::cerr << "smash error: redirection: missing " << (dir == '<' ? "input" : "output")
+                      << " file" << std::endl;
+            return false;
+        }
+
+        if (dup && target == "-") {
+            ops.push_back(makeOp(FdOp::CLOSE, fd, -1, 0, ""));
+        } else if (dup && isAllDigits(target)) {
+            ops.push_back(makeOp(FdOp::DUP, fd, atoi(target.c_str()), 0, ""));
+        } else if (dup && dir == '<') {
+            std::cerr << "smash error: redirection: " << target << ": ambiguous redirect" << std::endl;
+            return false;
+        } else {
+            // '>&file' is the old spelling of '&>file'
+            if (dup) both = true;
+            int flags = (dir == '<') ? O_RDONLY : (O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC));
+            ops.push_back(makeOp(FdOp::OPEN, both ? STDOUT_FILENO : fd, -1, flags, target));
+            if (both) ops.push_back(makeOp(FdOp::DUP, STDERR_FILENO, STDOUT_FILENO, 0, ""));
+        }
+    }
+    return true;
+}
+
+// ==================================================================================
+//                                Applying
+// ==================================================================================
+
+bool applyRedirections(const std::vector<FdOp> &ops) {
+    for (const FdOp &op : ops) {
+        switch (op.kind) {
+            case FdOp::OPEN: {
+                int fd = open(op.path.c_str(), op.flags | O_CLOEXEC, 0666);
+                if (fd == -1) {
+                    perror("smash error: open failed");
+                    return false;
+                }
+                if (fd == op.targetFd) {
+                    // Landed on the target itself (it was closed) - keep it across exec
+                    fcntl(fd, F_SETFD, 0);
+                    break;
+                }
+                if (dup2(fd, op.targetFd) == -1) {
+                    perror("smash error: dup2 failed");
+                    close(fd);
+                    return false;
+                }
+                close(fd);
+                break;
+            }
+            case FdOp::DUP:
+                if (op.sourceFd != op.targetFd && dup2(op.sourceFd, op.targetFd) == -1) {
+                    perror("smash error: dup2 failed");
+                    return false;
+                }
+                break;
+            case FdOp::CLOSE:
+                close(op.targetFd);
+                break;
+        }
+    }
+    return true;
+}
+
+// ==================================================================================
+//                                Class: FdSaver
+// ==================================================================================
+
+bool FdSaver::apply() {
+    // Whatever the shell buffered so far belongs to the old descriptors
+    ShellOutput::flush();
+
+    for (const FdOp &op : m_ops) {
+        bool seen = false;
+        for (const auto &saved : m_saved)
+            if (saved.first == op.targetFd) seen = true;
+        if (seen) continue;
+
+        int copy = fcntl(op.targetFd, F_DUPFD_CLOEXEC, SHELL_FD_BASE);
+        if (copy == -1 && errno != EBADF) {
+            perror("smash error: fcntl failed");
+            return false;
+        }
+        m_saved.push_back(std::make_pair(op.targetFd, copy));
+    }
+    return applyRedirections(m_ops);
+}
+
+FdSaver::~FdSaver() {
+    ShellOutput::flush();
+
+    for (auto it = m_saved.rbegin(); it != m_saved.rend(); ++it) {
+        if (it->second == -1) {
+            close(it->first);
+            continue;
+        }
+        if (dup2(it->second, it->first) == -1) perror("smash error: dup2 failed");
+        close(it->second);
+    }
+}
+
+// ==================================================================================
+//                                Class: InlineInputs
+// ==================================================================================
+
+bool InlineInputs::resolve(std::string &line, std::istream *input) {
+    if (line.find("<<") == std::string::npos) return true;
+    std::string out;
+    QuoteScan scan;
+    std::size_t i = 0;
+    while (i < line.size()) {
+        char c = line[i];
+        if (scan.at(line, i) != QuoteScan::PLAIN) {
+            // quoted or escaped: copied as is
+        } else if (line.compare(i, 2, "$(") == 0) {
+            // $(...) and $((...)) go to expansion whole: 'echo $((1<<3))' is a shift
+            std::size_t closing = findClosingParen(line, i + 1);
+            std::size_t end = (closing == std::string::npos) ? line.size() : closing + 1;
+            out.append(line, i, end - i);
+            i = end;
+            continue;
+        } else if (line.compare(i, 2, "<<") == 0) {
+            TRACE_SCOPE("heredoc");
+            bool hereString = (line.compare(i, 3, "<<<") == 0);
+            bool stripTabs = !hereString && line.compare(i, 3, "<<-") == 0;
+            i += (hereString || stripTabs) ? 3 : 2;
+
+            while (i < line.size() && isspace((unsigned char) line[i])) ++i;
+            std::size_t wordStart = i;
+            bool quoted = false;
+            std::string word = readTargetWord(line, i, &quoted);
+            if (word.empty() && !quoted) {
+                std::cerr << "smash error: redirection: missing "
+                          << (hereString ? "here-string word" : "here-document delimiter") << std::endl;
+                return false;
+            }
+
+            // The word of '<<<' and the body of '<<EOF' are expanded; '<<'EOF'' keeps the body as is
+            std::string data;
+            if (hereString) {
+                if (!expandWord(line.substr(wordStart, i - wordStart), data)) return false;
+                data += '\n';
+            } else {
+                data = readHereDocBody(input, word, stripTabs);
+                if (!quoted) {
+                    std::string expanded;
+                    if (!expandHereDoc(data, expanded)) return false;
+                    data.swap(expanded);
+                }
+            }
+            int fd = makePayloadFd(data);
+            if (fd == -1) return false;
+            m_fds.push_back(fd);
+
+            // The fd number written back keeps any explicit target: '3<<EOF' -> '3<&12'
+            out += "<&" + std::to_string(fd);
+            continue;
+        }
+        out += c;
+        ++i;
+    }
+    line = out;
+    return true;
+}
+
+InlineInputs::~InlineInputs() {
+    for (int fd : m_fds) close(fd);
+}
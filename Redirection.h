@@ -0,0 +1,96 @@
+#ifndef SMASH_REDIRECTION_H_
+#define SMASH_REDIRECTION_H_
+
+#include <istream>
+#include <string>
+#include <vector>
+
+// ==================================================================================
+//                                Redirections
+// ==================================================================================
+// A command line's redirections are parsed once into an ordered list of fd
+// operations. External commands apply the list in the child, between fork() and
+// exec(), so the shell's own descriptors are never touched. In-process commands
+// (builtins) go through FdSaver, which swaps descriptors only around execute().
+//
+// Supported forms (n defaults to 1 for '>' and 0 for '<'):
+//   [n]>file  [n]>>file  [n]<file  &>file  &>>file  [n]>&m  [n]<&m  [n]>&-  [n]<&-
+
+struct FdOp {
+    enum Kind { OPEN, DUP, CLOSE };
+
+    Kind kind;
+    int targetFd;
+    int sourceFd;       // DUP: the fd copied onto targetFd
+    int flags;          // OPEN: open(2) flags (O_CLOEXEC is added when opening)
+    std::string path;   // OPEN
+};
+
+/**
+ * Splits the redirections off 'line': 'command' receives the remaining text and
+ * 'ops' the operations in source order. Single and double quotes are respected.
+ * Prints an error and returns false on bad syntax.
+ */
+bool parseRedirections(const std::string &line, std::string &command, std::vector<FdOp> &ops);
+
+/**
+ * Performs 'ops' on the calling process. Meant for a forked child right before
+ * exec(); prints an error and returns false on the first failure.
+ */
+bool applyRedirections(const std::vector<FdOp> &ops);
+
+/**
+ * Returns a readable close-on-exec fd (10 or above) positioned at the start of
+ * 'data', or -1 after printing an error. Small payloads go straight into a pipe,
+ * larger ones into a memfd (or a pipe fed by a detached thread without memfd),
+ * so the caller never blocks on a reader. Used for here-docs and for the output
+ * of builtin pipeline stages.
+ */
+int makePayloadFd(const std::string &data);
+
+// ==================================================================================
+//                                Class: FdSaver
+// ==================================================================================
+// In-process redirection: apply() saves every descriptor the operations touch
+// (close-on-exec copies above 10) before changing it, the destructor puts them back.
+class FdSaver {
+private:
+    const std::vector<FdOp> &m_ops;
+    std::vector<std::pair<int, int> > m_saved;  // {targetFd, copy or -1 if it was closed}
+
+public:
+    explicit FdSaver(const std::vector<FdOp> &ops) : m_ops(ops) {}
+    ~FdSaver();
+
+    FdSaver(FdSaver const &) = delete;
+    void operator=(FdSaver const &) = delete;
+
+    bool apply();
+};
+
+// ==================================================================================
+//                                Class: InlineInputs
+// ==================================================================================
+// Here-documents (<<WORD, <<-WORD strips leading tabs) and here-strings (<<<word).
+// resolve() reads every here-doc body from the shell's input, puts each payload in
+// its own descriptor and rewrites the operator as '<&N', so the rest of the shell
+// only ever sees a plain fd duplication. Payloads that fit in a pipe's buffer are
+// written to a pipe up front; larger ones go to a memfd, so nothing touches the
+// filesystem and a big payload never blocks the shell. The descriptors are
+// close-on-exec and are closed when the InlineInputs goes out of scope.
+class InlineInputs {
+private:
+    std::vector<int> m_fds;
+
+public:
+    InlineInputs() {}
+    ~InlineInputs();
+
+    InlineInputs(InlineInputs const &) = delete;
+    void operator=(InlineInputs const &) = delete;
+
+    // 'input' may be nullptr (here-doc bodies are then empty). False on bad syntax.
+    bool resolve(std::string &line, std::istream *input);
+};
+
+#endif //SMASH_REDIRECTION_H_
@@ -0,0 +1,240 @@
+//
+// Created by Nikita Matrosov on 30/12/2025.
+//
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <cerrno>
+#include <cstdio>
+#include <algorithm>
+#include <vector>
+#include "Relay.h"
+#include "ResourceUsage.h"
+#include "Trace.h"
+
+namespace {
+
+/**
+ * Blocks until 'fd' is ready for 'events' and adds the time spent to 'waited'.
+ */
+void timedPoll(int fd, short events, double &waited) {
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = events;
+    double start = monotonicSeconds();
+    while (poll(&pfd, 1, -1) == -1 && errno == EINTR) {}
+    waited += monotonicSeconds() - start;
+}
+
+}
+
+#ifdef __linux__
+
+// ==================================================================================
+//                                Kernel Relay
+// ==================================================================================
+
+namespace {
+
+/**
+ * Splices 'len' bytes from the pipe 'from' to 'to', blocking while 'to' is full.
+ * False if 'to' is gone (EPIPE) or another error stops the transfer; 'len' is
+ * then what was not moved.
+ */
+bool pump(int from, int to, std::size_t &len) {
+    while (len > 0) {
+        ssize_t n = splice(from, nullptr, to, nullptr, len, SPLICE_F_MOVE);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        len -= n;
+    }
+    return true;
+}
+
+/**
+ * Throws away 'len' bytes at the front of a pipe, without reading them.
+ */
+void discard(int from, int devNull, std::size_t len) {
+    if (devNull == -1 || !pump(from, devNull, len)) {
+        char buf[4096];
+        while (len > 0) {
+            ssize_t n = read(from, buf, std::min(len, sizeof(buf)));
+            if (n == -1 && errno == EINTR) continue;
+            if (n <= 0) return;
+            len -= n;
+        }
+    }
+}
+
+/**
+ * Bytes waiting in the pipe 'in' after blocking until there are some.
+ * 0 at EOF (every writer closed its end) or on error.
+ */
+std::size_t waitForInput(int in) {
+    struct pollfd pfd;
+    pfd.fd = in;
+    pfd.events = POLLIN;
+    while (true) {
+        pfd.revents = 0;
+        if (poll(&pfd, 1, -1) == -1) {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        int avail = 0;
+        if (ioctl(in, FIONREAD, &avail) == -1) return 0;
+        if (avail > 0) return (std::size_t) avail;
+        if (pfd.revents & (POLLHUP | POLLERR)) return 0;
+    }
+}
+
+}
+
+void Relay::fanOut(int in, std::vector<int> outs) {
+    TRACE_SCOPE("fan-out");
+    if (outs.empty()) return;
+
+    // tee() into an empty pipe at least as large as the input never comes up short:
+    // a consumer that cannot take a whole round in one go is fed from such a copy
+    int scratch[2] = {-1, -1};
+    int inSize = fcntl(in, F_GETPIPE_SZ);
+    int devNull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+
+    while (!outs.empty()) {
+        std::size_t avail = waitForInput(in);
+        if (avail == 0) break;
+
+        // Every output but the last gets a duplicate of the round's pages
+        for (std::size_t i = 0; i + 1 < outs.size();) {
+            ssize_t sent = tee(in, outs[i], avail, SPLICE_F_NONBLOCK);
+            if (sent == (ssize_t) avail) {
+                ++i;
+                continue;
+            }
+            if (sent == -1 && errno != EAGAIN) {
+                outs.erase(outs.begin() + i); // the consumer exited
+                continue;
+            }
+            if (sent == -1) sent = 0;
+
+            // The consumer is behind: tee() cannot resume mid-round, so the rest goes
+            // through the scratch pipe, and we block here until the consumer takes it
+            if (scratch[0] == -1) {
+                if (pipe2(scratch, O_CLOEXEC) == -1) {
+                    perror("smash error: fan-out: pipe failed");
+                    outs.erase(outs.begin() + i);
+                    continue;
+                }
+                if (inSize > 0) fcntl(scratch[1], F_SETPIPE_SZ, inSize);
+            }
+            ssize_t copied;
+            do {
+                copied = tee(in, scratch[1], avail, 0);
+            } while (copied == -1 && errno == EINTR);
+            if (copied < sent) {
+                outs.erase(outs.begin() + i);
+                continue;
+            }
+            discard(scratch[0], devNull, sent);
+            std::size_t rest = (std::size_t) copied - sent;
+            if (!pump(scratch[0], outs[i], rest)) {
+                discard(scratch[0], devNull, rest); // the scratch pipe starts each round empty
+                outs.erase(outs.begin() + i);
+                continue;
+            }
+            ++i;
+        }
+
+        // The last output takes the pages themselves, which empties the input
+        if (!pump(in, outs.back(), avail)) {
+            discard(in, devNull, avail);
+            outs.pop_back();
+        }
+    }
+
+    if (scratch[0] != -1) {
+        close(scratch[0]);
+        close(scratch[1]);
+    }
+    if (devNull != -1) close(devNull);
+}
+
+void Relay::measure(int in, int out, EdgeStats &stats) {
+    TRACE_SCOPE("pipestat-relay");
+    double start = monotonicSeconds();
+    while (true) {
+        ssize_t n = splice(in, nullptr, out, nullptr, 1 << 20, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (n > 0) {
+            stats.bytes += n;
+            continue;
+        }
+        if (n == 0) break;                      // every writer closed the input
+        if (errno == EINTR) continue;
+        if (errno != EAGAIN) break;             // EPIPE: the reader exited
+
+        // Would block - on whichever side holds things up
+        int avail = 0;
+        if (ioctl(in, FIONREAD, &avail) == -1) break;
+        if (avail == 0) timedPoll(in, POLLIN, stats.emptySeconds);
+        else timedPoll(out, POLLOUT, stats.fullSeconds);
+    }
+    stats.wallSeconds = monotonicSeconds() - start;
+}
+
+#else
+
+// ==================================================================================
+//                                Copying Relay
+// ==================================================================================
+
+void Relay::fanOut(int in, std::vector<int> outs) {
+    TRACE_SCOPE("fan-out");
+    char buf[65536];
+    while (!outs.empty()) {
+        ssize_t n = read(in, buf, sizeof(buf));
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) break;
+
+        for (std::size_t i = 0; i < outs.size();) {
+            ssize_t done = 0;
+            while (done < n) {
+                ssize_t w = write(outs[i], buf + done, n - done);
+                if (w == -1 && errno == EINTR) continue;
+                if (w <= 0) break;
+                done += w;
+            }
+            if (done < n) outs.erase(outs.begin() + i);
+            else ++i;
+        }
+    }
+}
+
+void Relay::measure(int in, int out, EdgeStats &stats) {
+    TRACE_SCOPE("pipestat-relay");
+    double start = monotonicSeconds();
+    char buf[65536];
+    bool open = true;
+    while (open) {
+        timedPoll(in, POLLIN, stats.emptySeconds);
+        ssize_t n = read(in, buf, sizeof(buf));
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) break;
+
+        ssize_t done = 0;
+        while (done < n) {
+            timedPoll(out, POLLOUT, stats.fullSeconds);
+            ssize_t w = write(out, buf + done, n - done);
+            if (w == -1 && errno == EINTR) continue;
+            if (w <= 0) {
+                open = false;
+                break;
+            }
+            done += w;
+        }
+        stats.bytes += done;
+    }
+    stats.wallSeconds = monotonicSeconds() - start;
+}
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef SMASH_RELAY_H_
+#define SMASH_RELAY_H_
+
+#include <vector>
+
+// ==================================================================================
+//                                Class: Relay
+// ==================================================================================
+// Moves a stream between descriptors inside the kernel. fanOut() copies what a
+// producer writes into a pipe to several outputs at once. Each output is a pipe
+// (a consumer's stdin) or, as the last one only, a regular file. On Linux the
+// payload is never copied to user space:
+//  - tee(2) duplicates the input pipe's pages into every output but the last;
+//  - splice(2) then moves them into the last output, which consumes the input.
+//
+// A round handles the bytes that were in the input pipe when it started. The
+// next round starts only once every output has taken the current one. A slow
+// consumer therefore stalls the relay, the input pipe fills up, and the producer
+// blocks in write(): backpressure follows the slowest consumer. A consumer that
+// exits is dropped and the others keep going. Once no output is left, the input
+// is closed and the producer gets SIGPIPE, as it would in 'producer | consumer'.
+//
+// measure() is the one-edge form used by 'pipestat': it splices one pipe into the
+// next and times every wait. While the output pipe is full, the stage upstream is
+// blocked on its own full pipe soon after, because the downstream stage is too slow.
+// While the input pipe is empty, the stage downstream waits for the upstream one.
+//
+// Without tee/splice (macOS), the same loops read into a buffer and write it out.
+
+// What measure() saw on one edge of a pipeline
+struct EdgeStats {
+    unsigned long long bytes;
+    double fullSeconds;     // waiting for the downstream stage to make room
+    double emptySeconds;    // waiting for the upstream stage to write
+    double wallSeconds;     // from the relay's start until EOF (or the reader exiting)
+};
+
+class Relay {
+public:
+    // Copies 'in' to every fd in 'outs' until EOF on 'in' or until no output is
+    // left. A regular file may only be the last output. Closes nothing. The caller
+    // ignores SIGPIPE, so an output that went away shows up as EPIPE.
+    static void fanOut(int in, std::vector<int> outs);
+
+    // Moves 'in' to 'out' until EOF or until the reader of 'out' is gone, filling
+    // 'stats'. Same SIGPIPE rule as fanOut().
+    static void measure(int in, int out, EdgeStats &stats);
+};
+
+#endif //SMASH_RELAY_H_
@@ -0,0 +1,307 @@
+//
+// Created by Nikita Matrosov on 18/12/2025.
+//
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "ResourceLimits.h"
+
+// ==================================================================================
+//                                Static State
+// ==================================================================================
+
+namespace {
+
+bool g_cgroups = false;
+bool g_memoryController = false;
+bool g_cpuController = false;
+std::string g_root;             // <cgroup2 mount>/<our cgroup>/smash-<pid>
+pid_t g_ownerPid = 0;
+
+const JobLimits *g_pending = nullptr;
+
+const long long CPU_PERIOD_US = 100000;
+
+std::string jobCgroupOf(pid_t pid) {
+    return g_root + "/job-" + std::to_string(pid);
+}
+
+bool writeFile(const std::string &path, const std::string &data) {
+    int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd == -1) return false;
+    ssize_t n = write(fd, data.data(), data.size());
+    close(fd);
+    return n == (ssize_t) data.size();
+}
+
+bool readFirstLine(const std::string &path, std::string &line) {
+    std::ifstream in(path.c_str());
+    return in && std::getline(in, line);
+}
+
+bool hasWord(const std::string &line, const std::string &word) {
+    std::istringstream words(line);
+    std::string w;
+    while (words >> w)
+        if (w == word) return true;
+    return false;
+}
+
+/**
+ * Mount point of the cgroup v2 hierarchy (pure or hybrid layout), or "".
+ */
+std::string findCgroup2Mount() {
+    std::ifstream in("/proc/self/mountinfo");
+    std::string line;
+    while (std::getline(in, line)) {
+        // "<id> <parent> <dev> <root> <mount point> <opts> [tags] - <fstype> ..."
+        std::size_t sep = line.find(" - ");
+        if (sep == std::string::npos || line.compare(sep + 3, 8, "cgroup2 ") != 0) continue;
+
+        std::istringstream fields(line.substr(0, sep));
+        std::string skip, mountPoint;
+        fields >> skip >> skip >> skip >> skip >> mountPoint;
+        return mountPoint;
+    }
+    return "";
+}
+
+/**
+ * Our cgroup v2 path ("0::/path" in /proc/self/cgroup), or "" if there is none.
+ */
+std::string findOwnCgroup() {
+    std::ifstream in("/proc/self/cgroup");
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.compare(0, 3, "0::") == 0) return line.substr(3);
+    }
+    return "";
+}
+
+void removeCgroupRoot() {
+    if (!g_cgroups || getpid() != g_ownerPid) return;
+
+    // Jobs that are still running keep their cgroup (and therefore the root) alive
+    DIR *dir = opendir(g_root.c_str());
+    if (dir != nullptr) {
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != nullptr) {
+            if (strncmp(entry->d_name, "job-", 4) == 0) rmdir((g_root + "/" + entry->d_name).c_str());
+        }
+        closedir(dir);
+    }
+    rmdir(g_root.c_str());
+}
+
+/**
+ * Parses "512K", "2G", "100" (bytes) - binary multiples. -1 on bad input.
+ */
+long long parseSize(const std::string &text) {
+    char *end = nullptr;
+    errno = 0;
+    double value = strtod(text.c_str(), &end);
+    if (errno != 0 || end == text.c_str() || value < 0) return -1;
+
+    long long unit = 1;
+    std::string suffix(end);
+    if (!suffix.empty()) {
+        switch (toupper((unsigned char) suffix[0])) {
+            case 'K': unit = 1LL << 10; break;
+            case 'M': unit = 1LL << 20; break;
+            case 'G': unit = 1LL << 30; break;
+            case 'T': unit = 1LL << 40; break;
+            default: return -1;
+        }
+        std::string rest = suffix.substr(1);
+        if (!rest.empty() && rest != "B" && rest != "iB") return -1;
+    }
+    return (long long) (value * unit);
+}
+
+bool parseCount(const std::string &text, rlim_t &out) {
+    if (text.empty()) return false;
+    for (char c : text)
+        if (!isdigit((unsigned char) c)) return false;
+    out = (rlim_t) strtoull(text.c_str(), nullptr, 10);
+    return true;
+}
+
+std::string formatBytes(long long bytes) {
+    const char *units[] = {"B", "K", "M", "G", "T"};
+    double value = (double) bytes;
+    int unit = 0;
+    while (value >= 1024 && unit < 4) {
+        value /= 1024;
+        ++unit;
+    }
+    char buf[32];
+    snprintf(buf, sizeof(buf), unit == 0 ? "%.0f%s" : "%.1f%s", value, units[unit]);
+    return buf;
+}
+
+}
+
+// ==================================================================================
+//                                Class: ResourceLimits
+// ==================================================================================
+
+void ResourceLimits::init() {
+    const char *value = getenv("SMASH_CGROUP");
+    if (value == nullptr || *value == '\0') return;
+
+    std::string mount = findCgroup2Mount();
+    std::string own = findOwnCgroup();
+    if (mount.empty() || own.empty()) {
+        std::cerr << "smash error: cgroup: no cgroup v2 hierarchy, job cgroups disabled" << std::endl;
+        return;
+    }
+
+    std::string base = mount + (own == "/" ? "" : own);
+    g_root = base + "/smash-" + std::to_string(getpid());
+    if (mkdir(g_root.c_str(), 0755) == -1 && errno != EEXIST) {
+        perror("smash error: cgroup: mkdir failed (job cgroups disabled)");
+        return;
+    }
+
+    // Controllers have to be enabled on every level above the job cgroups. Our own
+    // cgroup usually refuses (it holds the shell itself) unless it already delegates
+    // them; whatever ends up available in the root is what the jobs get.
+    std::string enabled;
+    readFirstLine(base + "/cgroup.subtree_control", enabled);
+    if (!hasWord(enabled, "memory")) writeFile(base + "/cgroup.subtree_control", "+memory");
+    if (!hasWord(enabled, "cpu")) writeFile(base + "/cgroup.subtree_control", "+cpu");
+    writeFile(g_root + "/cgroup.subtree_control", "+memory");
+    writeFile(g_root + "/cgroup.subtree_control", "+cpu");
+
+    enabled.clear();
+    readFirstLine(g_root + "/cgroup.subtree_control", enabled);
+    g_memoryController = hasWord(enabled, "memory");
+    g_cpuController = hasWord(enabled, "cpu");
+
+    g_ownerPid = getpid();
+    g_cgroups = true;
+    atexit(removeCgroupRoot);
+}
+
+bool ResourceLimits::cgroupsEnabled() { return g_cgroups; }
+bool ResourceLimits::hasMemoryController() { return g_cgroups && g_memoryController; }
+bool ResourceLimits::hasCpuController() { return g_cgroups && g_cpuController; }
+
+bool ResourceLimits::parseOption(const std::string &option, const std::string &value, JobLimits &limits) {
+    rlim_t count;
+    if (option == "--mem") {
+        limits.memoryBytes = parseSize(value);
+        if (limits.memoryBytes > 0) return true;
+    } else if (option == "--cpu") {
+        if (!value.empty() && value[value.size() - 1] == '%') {
+            limits.cpuPercent = atoi(value.c_str());
+            if (limits.cpuPercent > 0 && parseCount(value.substr(0, value.size() - 1), count)) return true;
+        } else {
+            // Plain seconds: total CPU time, enforced by the kernel with SIGXCPU
+            std::string seconds = value;
+            if (!seconds.empty() && seconds[seconds.size() - 1] == 's') seconds.erase(seconds.size() - 1);
+            if (parseCount(seconds, count) && count > 0) {
+                limits.rlimits.push_back(std::make_pair((int) RLIMIT_CPU, count));
+                return true;
+            }
+        }
+    } else if (option == "--nofile" && parseCount(value, count)) {
+        limits.rlimits.push_back(std::make_pair((int) RLIMIT_NOFILE, count));
+        return true;
+    } else if (option == "--nproc" && parseCount(value, count)) {
+        limits.rlimits.push_back(std::make_pair((int) RLIMIT_NPROC, count));
+        return true;
+    }
+
+    std::cerr << "smash error: limit: invalid arguments" << std::endl;
+    return false;
+}
+
+void ResourceLimits::setPending(const JobLimits *limits) {
+    g_pending = limits;
+}
+
+bool ResourceLimits::hasPending() {
+    return g_pending != nullptr;
+}
+
+void ResourceLimits::releaseJob(pid_t pid) {
+    if (!g_cgroups) return;
+    rmdir(jobCgroupOf(pid).c_str()); // fails harmlessly if it never had one
+}
+
+std::string ResourceLimits::jobStats(pid_t pid) {
+    if (!g_cgroups) return "";
+    std::string dir = jobCgroupOf(pid);
+
+    std::string stats;
+    std::string line;
+    if (readFirstLine(dir + "/memory.current", line)) {
+        stats += "mem " + formatBytes(atoll(line.c_str()));
+    }
+
+    std::ifstream cpuStat((dir + "/cpu.stat").c_str());
+    while (std::getline(cpuStat, line)) {
+        if (line.compare(0, 11, "usage_usec ") != 0) continue;
+        char buf[32];
+        snprintf(buf, sizeof(buf), "cpu %.2fs", atoll(line.c_str() + 11) / 1e6);
+        stats += (stats.empty() ? "" : " ") + std::string(buf);
+        break;
+    }
+    return stats.empty() ? "" : " [" + stats + "]";
+}
+
+bool ResourceLimits::applyInChild(bool ownCgroup) {
+    const JobLimits *limits = g_pending;
+    g_pending = nullptr; // processes started from here inherit, they don't re-apply
+    bool limited = (limits != nullptr && !limits->empty());
+
+    bool memoryByCgroup = false;
+    if (g_cgroups && (ownCgroup || limited)) {
+        std::string dir = jobCgroupOf(getpid());
+        if (mkdir(dir.c_str(), 0755) == 0 || errno == EEXIST) {
+            // Limits go in before the process joins, so they hold from the first page
+            if (limited && limits->memoryBytes > 0 && g_memoryController) {
+                memoryByCgroup = writeFile(dir + "/memory.max", std::to_string(limits->memoryBytes));
+            }
+            if (limited && limits->cpuPercent > 0 && g_cpuController) {
+                writeFile(dir + "/cpu.max", std::to_string(limits->cpuPercent * CPU_PERIOD_US / 100) + " " +
+                                            std::to_string(CPU_PERIOD_US));
+            }
+            writeFile(dir + "/cgroup.procs", "0");
+        }
+    }
+    if (!limited) return true;
+
+    std::vector<std::pair<int, rlim_t> > rlimits = limits->rlimits;
+    if (limits->memoryBytes > 0 && !memoryByCgroup) {
+        rlimits.push_back(std::make_pair((int) RLIMIT_AS, (rlim_t) limits->memoryBytes));
+    }
+    for (const auto &limit : rlimits) {
+        // Never raise a hard limit (that needs privileges) - lower both instead
+        struct rlimit current;
+        if (getrlimit(limit.first, &current) == -1) {
+            perror("smash error: getrlimit failed");
+            return false;
+        }
+        struct rlimit wanted;
+        wanted.rlim_max = (current.rlim_max == RLIM_INFINITY || limit.second < current.rlim_max)
+                          ? limit.second : current.rlim_max;
+        wanted.rlim_cur = wanted.rlim_max;
+        if (setrlimit(limit.first, &wanted) == -1) {
+            perror("smash error: setrlimit failed");
+            return false;
+        }
+    }
+    return true;
+}
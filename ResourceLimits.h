@@ -0,0 +1,66 @@
+#ifndef SMASH_RESOURCE_LIMITS_H_
+#define SMASH_RESOURCE_LIMITS_H_
+
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+// ==================================================================================
+//                                Per-Job Limits
+// ==================================================================================
+// 'limit [--mem SIZE] [--cpu N%|SECONDS] [--nofile N] [--nproc N] cmd' runs one
+// command line under limits. LimitCommand publishes them as "pending" while the
+// inner line executes. The first child the shell forks for it (an external
+// command or a pipeline stage) applies them between fork() and exec() and clears
+// its copy, so the processes it starts inherit the limits instead of applying them
+// again. The shell itself is never limited.
+//
+// With SMASH_CGROUP set (any non-empty value) and a writable cgroup v2 hierarchy,
+// smash creates 'smash-<pid>' under its own cgroup. Each background job and each
+// limited command then runs in its own 'job-<pid>' cgroup there. --mem becomes
+// memory.max and --cpu N% becomes cpu.max, and 'jobs' shows memory.current and the
+// CPU time from cpu.stat. Without cgroups (or without the memory / cpu controller)
+// --mem falls back to RLIMIT_AS, and --cpu N% is ignored with a warning.
+
+struct JobLimits {
+    std::vector<std::pair<int, rlim_t> > rlimits;   // {RLIMIT_*, soft = hard value}
+    long long memoryBytes = -1;                     // --mem
+    int cpuPercent = -1;                            // --cpu N%
+
+    bool empty() const { return rlimits.empty() && memoryBytes < 0 && cpuPercent < 0; }
+};
+
+// ==================================================================================
+//                                Class: ResourceLimits
+// ==================================================================================
+class ResourceLimits {
+public:
+    // Sets up the job cgroup root if SMASH_CGROUP asks for it (called once from main)
+    static void init();
+    static bool cgroupsEnabled();
+    static bool hasMemoryController();
+    static bool hasCpuController();
+
+    // Parses one --option and its value into 'limits'; prints an error on failure
+    static bool parseOption(const std::string &option, const std::string &value, JobLimits &limits);
+
+    // ------------------------------ Shell Side ------------------------------------
+    // Limits for the children forked while the current command line runs (nullptr: none)
+    static void setPending(const JobLimits *limits);
+    static bool hasPending();
+
+    // Removes the cgroup of a finished job (no-op without cgroups)
+    static void releaseJob(pid_t pid);
+
+    // " [mem 12.5M cpu 0.42s]" for 'jobs', or "" when nothing can be read
+    static std::string jobStats(pid_t pid);
+
+    // ------------------------------ Child Side ------------------------------------
+    // Called right after fork(). Applies the pending limits and joins a cgroup of its
+    // own if there are limits or 'ownCgroup' is set. False (error printed) on failure.
+    static bool applyInChild(bool ownCgroup);
+};
+
+#endif //SMASH_RESOURCE_LIMITS_H_
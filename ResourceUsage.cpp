@@ -0,0 +1,84 @@
+//
+// Created by Nikita Matrosov on 02/12/2025.
+//
+
+#include <ctime>
+#include <cstdio>
+#include "ResourceUsage.h"
+
+// ==================================================================================
+//                                Global Helpers
+// ==================================================================================
+
+double monotonicSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+double timevalToSeconds(const struct timeval &tv) {
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/**
+ * Formats seconds as "XmY.YYYs", the same way bash prints 'time' output.
+ */
+static void printMinSec(std::ostream &os, double seconds) {
+    if (seconds < 0) seconds = 0;
+    long minutes = (long) (seconds / 60);
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%ldm%.3fs", minutes, seconds - minutes * 60.0);
+    os << buf;
+}
+
+// ==================================================================================
+//                            Struct: ResourceUsage
+// ==================================================================================
+
+void ResourceUsage::addChild(const struct rusage &ru) {
+    userSec += timevalToSeconds(ru.ru_utime);
+    sysSec += timevalToSeconds(ru.ru_stime);
+    if (ru.ru_maxrss > maxRssKb) maxRssKb = ru.ru_maxrss;
+    minorFaults += ru.ru_minflt;
+    majorFaults += ru.ru_majflt;
+    volCtxSwitches += ru.ru_nvcsw;
+    involCtxSwitches += ru.ru_nivcsw;
+    ++reapedChildren;
+}
+
+void ResourceUsage::addSelfDelta(const struct rusage &before, const struct rusage &after) {
+    userSec += timevalToSeconds(after.ru_utime) - timevalToSeconds(before.ru_utime);
+    sysSec += timevalToSeconds(after.ru_stime) - timevalToSeconds(before.ru_stime);
+    minorFaults += after.ru_minflt - before.ru_minflt;
+    majorFaults += after.ru_majflt - before.ru_majflt;
+    volCtxSwitches += after.ru_nvcsw - before.ru_nvcsw;
+    involCtxSwitches += after.ru_nivcsw - before.ru_nivcsw;
+
+    // A command that never forked ran inside the shell - report the shell's peak
+    if (reapedChildren == 0 && after.ru_maxrss > maxRssKb) maxRssKb = after.ru_maxrss;
+}
+
+void ResourceUsage::merge(const ResourceUsage &other) {
+    userSec += other.userSec;
+    sysSec += other.sysSec;
+    if (other.maxRssKb > maxRssKb) maxRssKb = other.maxRssKb;
+    minorFaults += other.minorFaults;
+    majorFaults += other.majorFaults;
+    volCtxSwitches += other.volCtxSwitches;
+    involCtxSwitches += other.involCtxSwitches;
+    reapedChildren += other.reapedChildren;
+}
+
+void ResourceUsage::print(std::ostream &os, bool verbose) const {
+    os << "\nreal\t"; printMinSec(os, wallSec);
+    os << "\nuser\t"; printMinSec(os, userSec);
+    os << "\nsys\t";  printMinSec(os, sysSec);
+    os << "\n";
+
+    if (!verbose) return;
+
+    os << "max rss\t" << maxRssKb << " KB\n"
+       << "faults\t" << minorFaults << " minor, " << majorFaults << " major\n"
+       << "ctxsw\t" << volCtxSwitches << " voluntary, " << involCtxSwitches << " involuntary\n"
+       << "allocs\t" << shellAllocs << " (shell heap)\n";
+}
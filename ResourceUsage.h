@@ -0,0 +1,44 @@
+#ifndef SMASH_RESOURCE_USAGE_H_
+#define SMASH_RESOURCE_USAGE_H_
+
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <iostream>
+
+// ==================================================================================
+//                                Struct: ResourceUsage
+// ==================================================================================
+// Accumulates wall clock time and rusage counters for one timed command.
+// Children are added as they are reaped (wait4), the shell itself is added as a
+// getrusage(RUSAGE_SELF) delta so in-process builtins are accounted for too.
+struct ResourceUsage {
+    double wallSec = 0.0;
+    double userSec = 0.0;
+    double sysSec = 0.0;
+    long maxRssKb = 0;          // maximum over all reaped children (or the shell)
+    long minorFaults = 0;
+    long majorFaults = 0;
+    long volCtxSwitches = 0;
+    long involCtxSwitches = 0;
+    int reapedChildren = 0;
+    unsigned long shellAllocs = 0;  // heap allocations made by the shell process itself
+
+    // Adds the usage of one reaped child (as returned by wait4)
+    void addChild(const struct rusage &ru);
+
+    // Adds the difference between two RUSAGE_SELF samples of the shell process
+    void addSelfDelta(const struct rusage &before, const struct rusage &after);
+
+    // Merges another accumulator into this one (used by nested collectors)
+    void merge(const ResourceUsage &other);
+
+    // Prints in the bash 'time' format; verbose adds memory/fault/switch lines
+    void print(std::ostream &os, bool verbose) const;
+};
+
+// Monotonic clock in seconds, used for wall time measurements
+double monotonicSeconds();
+
+double timevalToSeconds(const struct timeval &tv);
+
+#endif //SMASH_RESOURCE_USAGE_H_
@@ -0,0 +1,1218 @@
+//
+// Created by Nikita Matrosov on 22/12/2025.
+//
+
+#include <unistd.h>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+#include "Script.h"
+#include "Arithmetic.h"
+#include "Expansion.h"
+#include "Quoting.h"
+#include "Redirection.h"
+#include "SmallShell.h"
+#include "Trace.h"
+
+// ==================================================================================
+//                                Execution State
+// ==================================================================================
+
+namespace {
+
+const char *const BLANKS = " \t\r\f\v";
+
+// Calls nested deeper than this are stopped instead of overflowing the stack
+const int MAX_FUNCTION_DEPTH = 1000;
+
+class Node;
+
+// What a break / continue / return / ctrl-C asks the enclosing nodes to do
+enum Flow { FLOW_NONE, FLOW_BREAK, FLOW_CONTINUE, FLOW_RETURN, FLOW_INTERRUPT };
+
+Flow g_flow = FLOW_NONE;
+int g_flowLevels = 0;           // loops a break / continue still has to leave
+int g_loopDepth = 0;            // loops running in the current function (or at top level)
+int g_runDepth = 0;             // nested Script::run() calls
+
+// 'local' bookkeeping: one frame per running function call, holding the values
+// its local variables hid
+struct SavedVariable {
+    std::string name;
+    bool wasSet;
+    std::string value;
+};
+std::vector<std::vector<SavedVariable> > g_frames;
+
+// Function bodies are shared: a function that redefines itself keeps running
+std::unordered_map<std::string, std::shared_ptr<Node> > g_functions;
+
+const std::unordered_set<std::string> &reservedWords() {
+    static const std::unordered_set<std::string> words = {
+            "if", "then", "elif", "else", "fi", "while", "until", "do", "done", "for",
+            "function", "{", "}", "!"
+    };
+    return words;
+}
+
+bool isName(const std::string &word) {
+    if (word.empty() || !(isalpha((unsigned char) word[0]) || word[0] == '_')) return false;
+    for (char c : word)
+        if (!(isalnum((unsigned char) c) || c == '_')) return false;
+    return true;
+}
+
+/**
+ * Called by a loop after its body (or condition) ran. Consumes a break or
+ * continue meant for this loop; true if the loop goes on with the next iteration.
+ */
+bool nextIteration() {
+    if (g_flow == FLOW_NONE) return true;
+    if (g_flow != FLOW_BREAK && g_flow != FLOW_CONTINUE) return false;
+
+    bool isContinue = (g_flow == FLOW_CONTINUE);
+    if (--g_flowLevels > 0) return false; // meant for an enclosing loop
+    g_flow = FLOW_NONE;
+    return isContinue;
+}
+
+bool interrupted() {
+    if (!SmallShell::getInstance().isInterrupted()) return false;
+    g_flow = FLOW_INTERRUPT;
+    SmallShell::getInstance().setLastStatus(130);
+    return true;
+}
+
+// ==================================================================================
+//                                Syntax Tree
+// ==================================================================================
+
+/**
+ * A parsed piece of script. run() leaves its exit status in $? and may set g_flow.
+ */
+class Node {
+public:
+    virtual ~Node() {}
+    virtual void run() = 0;
+};
+
+// A simple command, run through SmallShell::runSimpleCommand()
+class SimpleNode : public Node {
+private:
+    std::string m_text;
+    std::string m_hereDocs;     // here-doc body lines read while parsing
+public:
+    SimpleNode(const std::string &text, const std::string &hereDocs) : m_text(text), m_hereDocs(hereDocs) {}
+
+    void run() override {
+        SmallShell &smash = SmallShell::getInstance();
+        smash.removeFinishedJobs();
+        if (m_hereDocs.empty()) {
+            smash.runSimpleCommand(m_text, nullptr);
+            return;
+        }
+        std::istringstream bodies(m_hereDocs);
+        smash.runSimpleCommand(m_text, &bodies);
+    }
+};
+
+// 'NAME=word' on its own: expanded and assigned without building a Command
+class AssignNode : public Node {
+private:
+    std::string m_name;
+    std::string m_word;
+public:
+    AssignNode(const std::string &name, const std::string &word) : m_name(name), m_word(word) {}
+
+    void run() override {
+        SmallShell &smash = SmallShell::getInstance();
+        std::string value;
+        if (!expandWord(m_word, value)) {
+            smash.setLastStatus(1);
+            return;
+        }
+        smash.assignVariable(m_name, value);
+        smash.setLastStatus(0);
+    }
+};
+
+// '(( expr ))': status 0 if the expression is non-zero
+class ArithNode : public Node {
+private:
+    std::string m_expr;
+public:
+    explicit ArithNode(const std::string &expr) : m_expr(expr) {}
+
+    void run() override {
+        SmallShell &smash = SmallShell::getInstance();
+        std::string expr;
+        long long result = 0;
+        bool ok = expandWord(m_expr, expr) && evaluateArithmetic(expr, result);
+        smash.setLastStatus(ok && result != 0 ? 0 : 1);
+    }
+};
+
+// break / continue / return / local - they act on the script state, not on the shell
+class ControlNode : public Node {
+public:
+    enum Kind { BREAK, CONTINUE, RETURN, LOCAL };
+
+private:
+    Kind m_kind;
+    std::string m_name;
+    std::string m_args;
+
+    bool readCount(const std::vector<std::string> &args, int &count) {
+        count = 1;
+        if (args.empty()) return true;
+        char *end = nullptr;
+        long value = strtol(args[0].c_str(), &end, 10);
+        if (*end != '\0' || end == args[0].c_str() || value < (m_kind == RETURN ? -255 : 1)) {
+            std::cerr << "smash error: " << m_name << ": " << args[0] << ": numeric argument required" << std::endl;
+            return false;
+        }
+        count = (int) value;
+        return true;
+    }
+
+    void local(const std::vector<std::string> &args) {
+        SmallShell &smash = SmallShell::getInstance();
+        std::vector<SavedVariable> &frame = g_frames.back();
+        for (const auto &arg : args) {
+            std::size_t eq = arg.find('=');
+            std::string name = arg.substr(0, eq);
+            if (!isName(name)) {
+                std::cerr << "smash error: local: '" << arg << "': not a valid identifier" << std::endl;
+                smash.setLastStatus(1);
+                continue;
+            }
+
+            // Only the first 'local' of a name in this call remembers the outer value
+            bool saved = false;
+            for (const auto &var : frame)
+                if (var.name == name) saved = true;
+            if (!saved) {
+                const std::string *outer = smash.findVariable(name);
+                SavedVariable var;
+                var.name = name;
+                var.wasSet = (outer != nullptr);
+                var.value = outer ? *outer : "";
+                frame.push_back(var);
+            }
+            smash.setVariable(name, eq == std::string::npos ? "" : arg.substr(eq + 1));
+        }
+    }
+
+public:
+    ControlNode(Kind kind, const std::string &name, const std::string &args)
+            : m_kind(kind), m_name(name), m_args(args) {}
+
+    void run() override {
+        SmallShell &smash = SmallShell::getInstance();
+        int previousStatus = smash.getLastStatus();
+
+        std::string line = m_args;
+        if (!expandCommandLine(line)) {
+            smash.setLastStatus(1);
+            return;
+        }
+        std::vector<std::string> args;
+        tokenizeCommandLine(line, args);
+        smash.setLastStatus(0);
+
+        int count;
+        switch (m_kind) {
+            case BREAK:
+            case CONTINUE:
+                if (g_loopDepth == 0) {
+                    std::cerr << "smash error: " << m_name << ": only meaningful in a loop" << std::endl;
+                    smash.setLastStatus(1);
+                    return;
+                }
+                if (!readCount(args, count)) {
+                    smash.setLastStatus(1);
+                    return;
+                }
+                g_flow = (m_kind == BREAK) ? FLOW_BREAK : FLOW_CONTINUE;
+                g_flowLevels = (count < g_loopDepth) ? count : g_loopDepth;
+                return;
+            case RETURN:
+                if (g_frames.empty()) {
+                    std::cerr << "smash error: return: can only return from a function" << std::endl;
+                    smash.setLastStatus(1);
+                    return;
+                }
+                if (args.empty()) {
+                    smash.setLastStatus(previousStatus);
+                } else if (readCount(args, count)) {
+                    smash.setLastStatus(count & 0xff);
+                } else {
+                    smash.setLastStatus(2);
+                }
+                g_flow = FLOW_RETURN;
+                return;
+            case LOCAL:
+                if (g_frames.empty()) {
+                    std::cerr << "smash error: local: can only be used in a function" << std::endl;
+                    smash.setLastStatus(1);
+                    return;
+                }
+                local(args);
+                return;
+        }
+    }
+};
+
+// Commands in sequence - stops early for a break / continue / return
+class ListNode : public Node {
+private:
+    std::vector<Node*> m_items;
+public:
+    ~ListNode() {
+        for (Node *item : m_items) delete item;
+    }
+
+    void add(Node *item) { m_items.push_back(item); }
+    bool empty() const { return m_items.empty(); }
+
+    void run() override {
+        for (Node *item : m_items) {
+            item->run();
+            if (g_flow != FLOW_NONE) return;
+        }
+    }
+};
+
+// 'left && right' / 'left || right'
+class AndOrNode : public Node {
+private:
+    Node *m_left;
+    Node *m_right;
+    bool m_and;
+public:
+    AndOrNode(Node *left, Node *right, bool isAnd) : m_left(left), m_right(right), m_and(isAnd) {}
+    ~AndOrNode() {
+        delete m_left;
+        delete m_right;
+    }
+
+    void run() override {
+        m_left->run();
+        if (g_flow != FLOW_NONE) return;
+        bool succeeded = (SmallShell::getInstance().getLastStatus() == 0);
+        if (succeeded == m_and) m_right->run();
+    }
+};
+
+// '! cmd'
+class NotNode : public Node {
+private:
+    Node *m_inner;
+public:
+    explicit NotNode(Node *inner) : m_inner(inner) {}
+    ~NotNode() { delete m_inner; }
+
+    void run() override {
+        m_inner->run();
+        if (g_flow != FLOW_NONE) return;
+        SmallShell &smash = SmallShell::getInstance();
+        smash.setLastStatus(smash.getLastStatus() == 0 ? 1 : 0);
+    }
+};
+
+// if / elif / else
+class IfNode : public Node {
+private:
+    std::vector<std::pair<Node*, Node*> > m_branches;   // {condition, body}
+    Node *m_else;
+public:
+    IfNode() : m_else(nullptr) {}
+    ~IfNode() {
+        for (auto &branch : m_branches) {
+            delete branch.first;
+            delete branch.second;
+        }
+        delete m_else;
+    }
+
+    void addBranch(Node *condition, Node *body) { m_branches.push_back(std::make_pair(condition, body)); }
+    void setElse(Node *body) { m_else = body; }
+
+    void run() override {
+        SmallShell &smash = SmallShell::getInstance();
+        for (auto &branch : m_branches) {
+            branch.first->run();
+            if (g_flow != FLOW_NONE) return;
+            if (smash.getLastStatus() == 0) {
+                branch.second->run();
+                return;
+            }
+        }
+        if (m_else != nullptr) m_else->run();
+        else smash.setLastStatus(0);
+    }
+};
+
+// while / until
+class LoopNode : public Node {
+private:
+    Node *m_condition;
+    Node *m_body;
+    bool m_until;
+public:
+    LoopNode(Node *condition, Node *body, bool until) : m_condition(condition), m_body(body), m_until(until) {}
+    ~LoopNode() {
+        delete m_condition;
+        delete m_body;
+    }
+
+    void run() override {
+        SmallShell &smash = SmallShell::getInstance();
+        int status = 0;
+        ++g_loopDepth;
+        while (!interrupted()) {
+            m_condition->run();
+            if (g_flow != FLOW_NONE) {
+                if (nextIteration()) continue;
+                break;
+            }
+            if ((smash.getLastStatus() == 0) == m_until) break;
+
+            m_body->run();
+            status = smash.getLastStatus();
+            if (!nextIteration()) break;
+        }
+        --g_loopDepth;
+        if (g_flow != FLOW_INTERRUPT) smash.setLastStatus(status);
+    }
+};
+
+// for NAME in WORDS
+class ForNode : public Node {
+private:
+    std::string m_name;
+    std::string m_words;
+    bool m_hasWords;            // false: iterate over "$@"
+    Node *m_body;
+public:
+    ForNode(const std::string &name, const std::string &words, bool hasWords, Node *body)
+            : m_name(name), m_words(words), m_hasWords(hasWords), m_body(body) {}
+    ~ForNode() { delete m_body; }
+
+    void run() override {
+        SmallShell &smash = SmallShell::getInstance();
+
+        // The word list is expanded once, before the first iteration
+        std::vector<std::string> words;
+        if (m_hasWords) {
+            std::string line = m_words;
+            if (!expandCommandLine(line)) {
+                smash.setLastStatus(1);
+                return;
+            }
+            tokenizeCommandLine(line, words);
+        } else {
+            words = smash.getPositional();
+        }
+
+        int status = 0;
+        ++g_loopDepth;
+        for (const auto &word : words) {
+            if (interrupted()) break;
+            smash.assignVariable(m_name, word);
+            m_body->run();
+            status = smash.getLastStatus();
+            if (!nextIteration()) break;
+        }
+        --g_loopDepth;
+        if (g_flow != FLOW_INTERRUPT) smash.setLastStatus(status);
+    }
+};
+
+// name() { ... } - running the definition only stores the body
+class FunctionDefNode : public Node {
+private:
+    std::string m_name;
+    std::shared_ptr<Node> m_body;
+public:
+    FunctionDefNode(const std::string &name, Node *body) : m_name(name), m_body(body) {}
+
+    void run() override {
+        g_functions[m_name] = m_body;
+        SmallShell::getInstance().setLastStatus(0);
+    }
+};
+
+// compound > file - the shell's descriptors are swapped around the whole body
+class RedirectNode : public Node {
+private:
+    Node *m_inner;
+    std::vector<FdOp> m_ops;
+public:
+    RedirectNode(Node *inner, const std::vector<FdOp> &ops) : m_inner(inner), m_ops(ops) {}
+    ~RedirectNode() { delete m_inner; }
+
+    void run() override {
+        FdSaver saver(m_ops);
+        if (!saver.apply()) {
+            SmallShell::getInstance().setLastStatus(1);
+            return;
+        }
+        m_inner->run();
+    }
+};
+
+// compound | cmd - the compound runs in a child, the right side in the shell
+class PipeNode : public Node {
+private:
+    Node *m_inner;
+    std::string m_right;
+    bool m_stderr;
+public:
+    PipeNode(Node *inner, const std::string &right, bool useStderr)
+            : m_inner(inner), m_right(right), m_stderr(useStderr) {}
+    ~PipeNode() { delete m_inner; }
+
+    void run() override {
+        SmallShell &smash = SmallShell::getInstance();
+        int fds[2];
+        if (pipe(fds) == -1) {
+            perror("smash error: pipe failed");
+            smash.setLastStatus(1);
+            return;
+        }
+
+        pid_t pid = TRACE_FORK();
+        if (pid == -1) {
+            perror("smash error: fork failed");
+            close(fds[0]);
+            close(fds[1]);
+            smash.setLastStatus(1);
+            return;
+        }
+        if (pid == 0) {
+            setpgrp();
+            if (dup2(fds[1], m_stderr ? STDERR_FILENO : STDOUT_FILENO) == -1) {
+                perror("smash error: dup2 failed");
+                _exit(EXIT_FAILURE);
+            }
+            close(fds[0]);
+            close(fds[1]);
+            m_inner->run();
+
+            // _exit, as for any pipeline stage: the shell's stdin stays where it is
+            std::cout.flush();
+            std::cerr.flush();
+            fflush(nullptr);
+            _exit(smash.getLastStatus());
+        }
+        close(fds[1]);
+
+        FdOp input;
+        input.kind = FdOp::DUP;
+        input.targetFd = STDIN_FILENO;
+        input.sourceFd = fds[0];
+        input.flags = 0;
+        std::vector<FdOp> ops(1, input);
+        {
+            FdSaver saver(ops);
+            if (saver.apply()) smash.executeCommand(m_right.c_str());
+            else smash.setLastStatus(1);
+        }
+        close(fds[0]);
+
+        int status = smash.getLastStatus();
+        smash.waitForChild(pid, nullptr, 0);
+        smash.setLastStatus(status);
+    }
+};
+
+// ==================================================================================
+//                                Lexer
+// ==================================================================================
+
+struct Token {
+    enum Kind { TEXT, KEYWORD, SEPARATOR, FUNCDEF, ARITH, END };
+
+    Kind kind;
+    std::string text;       // command text, keyword, operator, function name or expression
+    std::string hereDocs;   // TEXT: the here-doc body lines that followed its line
+};
+
+Token makeToken(Token::Kind kind, const std::string &text) {
+    Token token;
+    token.kind = kind;
+    token.text = text;
+    return token;
+}
+
+/**
+ * If a quoted, escaped or bracketed region starts at 'i' ('...', "...", \c, $(...),
+ * ${...}, <(...), >(...)), returns the index just past it, else 'i'. An unterminated
+ * one runs to the end of the line.
+ */
+std::size_t skipRegion(const std::string &line, std::size_t i) {
+    char c = line[i];
+    if (c == '\'' || c == '"' || c == '\\') {
+        QuoteScan scan;
+        std::size_t j = i;
+        if (scan.at(line, j) != QuoteScan::SYNTAX) return i; // a lone '\' at the end
+        for (++j; j < line.size(); ++j) {
+            QuoteScan::Kind kind = scan.at(line, j);
+            if (kind == QuoteScan::SYNTAX && !scan.inQuotes() && c != '\\') return j + 1;
+            if (kind == QuoteScan::LITERAL && c == '\\') return j + 1;
+        }
+        return line.size();
+    }
+    if (i + 1 < line.size() && line[i + 1] == '(' && (c == '$' || c == '<' || c == '>')) {
+        std::size_t close = findClosingParen(line, i + 1);
+        return (close == std::string::npos) ? line.size() : close + 1;
+    }
+    if (c == '$' && i + 1 < line.size() && line[i + 1] == '{') {
+        std::size_t close = findClosingBrace(line, i + 1);
+        return (close == std::string::npos) ? line.size() : close + 1;
+    }
+    return i;
+}
+
+bool isWordEnd(char c) {
+    return isspace((unsigned char) c) || strchr(";&|<>()", c) != nullptr;
+}
+
+/**
+ * Length of the unquoted control operator (';', '&&', '||') at 'i', or 0. A '#'
+ * that starts a word ends the line (-1).
+ */
+int controlOperatorAt(const std::string &line, std::size_t i) {
+    char c = line[i];
+    if (c == ';') return 1;
+    if ((c == '&' || c == '|') && i + 1 < line.size() && line[i + 1] == c) return 2;
+    if (c == '#' && (i == 0 || isspace((unsigned char) line[i - 1]))) return -1;
+    return 0;
+}
+
+class Lexer {
+private:
+    std::istream *m_input;
+
+    /**
+     * Reads the bodies of the here-docs in 'token' (the lines after its own).
+     */
+    void readHereDocs(Token &token) {
+        const std::string &text = token.text;
+        for (std::size_t i = 0; i < text.size(); ++i) {
+            std::size_t skipped = skipRegion(text, i);
+            if (skipped != i) {
+                i = skipped - 1;
+                continue;
+            }
+            if (text.compare(i, 2, "<<") != 0 || text.compare(i, 3, "<<<") == 0) continue;
+
+            i += 2;
+            bool stripTabs = (i < text.size() && text[i] == '-');
+            if (stripTabs) ++i;
+            while (i < text.size() && isspace((unsigned char) text[i])) ++i;
+
+            std::size_t start = i;
+            while (i < text.size() && !isWordEnd(text[i])) {
+                std::size_t skipped = skipRegion(text, i);
+                i = (skipped != i) ? skipped : i + 1;
+            }
+            std::string delimiter = removeQuotes(text.substr(start, i - start));
+            --i;
+
+            std::string line;
+            while (m_input != nullptr && std::getline(*m_input, line)) {
+                token.hereDocs += line + "\n";
+                std::size_t start = stripTabs ? line.find_first_not_of('\t') : 0;
+                if (start != std::string::npos && line.compare(start, std::string::npos, delimiter) == 0) break;
+                if (start == std::string::npos && delimiter.empty()) break;
+            }
+        }
+    }
+
+public:
+    explicit Lexer(std::istream *input) : m_input(input) {}
+
+    /**
+     * Splits one input line into tokens, ending with a newline separator.
+     */
+    void lexLine(const std::string &line, std::deque<Token> &tokens) {
+        std::size_t firstNew = tokens.size();
+        bool commandStart = true;
+        std::size_t pos = 0;
+
+        while (true) {
+            pos = line.find_first_not_of(BLANKS, pos);
+            if (pos == std::string::npos || line[pos] == '#') break;
+
+            int op = controlOperatorAt(line, pos);
+            if (op > 0) {
+                tokens.push_back(makeToken(Token::SEPARATOR, line.substr(pos, op)));
+                pos += op;
+                commandStart = true;
+                continue;
+            }
+
+            if (commandStart) {
+                // (( expr ))
+                if (line.compare(pos, 2, "((") == 0) {
+                    std::size_t close = findClosingParen(line, pos);
+                    if (close != std::string::npos && findClosingParen(line, pos + 1) == close - 1) {
+                        tokens.push_back(makeToken(Token::ARITH, line.substr(pos + 2, close - pos - 3)));
+                        pos = close + 1;
+                        commandStart = false;
+                        continue;
+                    }
+                }
+
+                std::size_t end = pos;
+                while (end < line.size() && !isWordEnd(line[end])) ++end;
+                std::string word = line.substr(pos, end - pos);
+
+                if (word == "function") {
+                    // function name [()]
+                    std::size_t nameStart = line.find_first_not_of(BLANKS, end);
+                    std::size_t nameEnd = nameStart;
+                    while (nameEnd < line.size() && !isWordEnd(line[nameEnd])) ++nameEnd;
+                    std::string name = (nameStart == std::string::npos) ? "" : line.substr(nameStart, nameEnd - nameStart);
+                    pos = nameEnd;
+                    std::size_t parens = line.find_first_not_of(BLANKS, pos);
+                    if (parens != std::string::npos && line.compare(parens, 2, "()") == 0) pos = parens + 2;
+                    tokens.push_back(makeToken(Token::FUNCDEF, name));
+                    continue;
+                }
+
+                if (reservedWords().count(word)) {
+                    tokens.push_back(makeToken(Token::KEYWORD, word));
+                    pos = end;
+                    commandStart = (word != "fi" && word != "done" && word != "}" && word != "for");
+                    continue;
+                }
+
+                // name() ...
+                std::size_t parens = line.find_first_not_of(BLANKS, end);
+                if (isName(word) && parens != std::string::npos && line.compare(parens, 2, "()") == 0) {
+                    tokens.push_back(makeToken(Token::FUNCDEF, word));
+                    pos = parens + 2;
+                    continue;
+                }
+            }
+
+            // Command text up to the next control operator
+            std::size_t end = pos;
+            while (end < line.size()) {
+                std::size_t skipped = skipRegion(line, end);
+                if (skipped != end) {
+                    end = skipped;
+                    continue;
+                }
+                if (controlOperatorAt(line, end) != 0) break;
+                ++end;
+            }
+            std::string text = line.substr(pos, end - pos);
+            text.erase(text.find_last_not_of(BLANKS) + 1);
+            tokens.push_back(makeToken(Token::TEXT, text));
+            pos = end;
+            commandStart = false;
+        }
+        tokens.push_back(makeToken(Token::SEPARATOR, "\n"));
+
+        for (std::size_t i = firstNew; i < tokens.size(); ++i) {
+            if (tokens[i].kind == Token::TEXT && tokens[i].text.find("<<") != std::string::npos) {
+                readHereDocs(tokens[i]);
+            }
+        }
+    }
+};
+
+// ==================================================================================
+//                                Parser
+// ==================================================================================
+
+// Words that end a list inside each construct
+const char *const THEN_STOPS[] = {"then", nullptr};
+const char *const IF_BODY_STOPS[] = {"elif", "else", "fi", nullptr};
+const char *const FI_STOPS[] = {"fi", nullptr};
+const char *const DO_STOPS[] = {"do", nullptr};
+const char *const DONE_STOPS[] = {"done", nullptr};
+const char *const BRACE_STOPS[] = {"}", nullptr};
+const char *const NO_STOPS[] = {nullptr};
+
+/**
+ * Recursive descent over the token stream. Nodes are built bottom-up; whatever
+ * was built is deleted when an error is found, and nullptr goes back up.
+ */
+class Parser {
+private:
+    Lexer m_lexer;
+    std::istream *m_input;
+    std::deque<Token> m_tokens;
+    int m_open;             // constructs waiting for more input - more lines may be read
+    bool m_failed;
+
+    Token &peek() {
+        while (m_tokens.empty()) {
+            std::string line;
+            if (m_open == 0 || m_failed || m_input == nullptr) {
+                m_tokens.push_back(makeToken(Token::END, ""));
+            } else {
+                if (m_input == &std::cin) std::cout << "> " << std::flush; // not for ~/.smashrc
+                if (std::getline(*m_input, line)) m_lexer.lexLine(line, m_tokens);
+                else m_tokens.push_back(makeToken(Token::END, ""));
+            }
+        }
+        return m_tokens.front();
+    }
+
+    Token next() {
+        Token token = peek();
+        if (token.kind != Token::END) m_tokens.pop_front();
+        return token;
+    }
+
+    Node *syntaxError(const Token &token) {
+        if (!m_failed) {
+            if (token.kind == Token::END) {
+                std::cerr << "smash error: syntax error: unexpected end of file" << std::endl;
+            } else {
+                std::string text = (token.text == "\n") ? "newline" : token.text;
+                std::cerr << "smash error: syntax error near unexpected token '" << text << "'" << std::endl;
+            }
+        }
+        m_failed = true;
+        return nullptr;
+    }
+
+    bool isKeyword(const Token &token, const char *word) {
+        return token.kind == Token::KEYWORD && token.text == word;
+    }
+
+    bool expect(const char *word) {
+        if (isKeyword(peek(), word)) {
+            next();
+            return true;
+        }
+        syntaxError(peek());
+        return false;
+    }
+
+    void skipNewlines() {
+        while (peek().kind == Token::SEPARATOR && peek().text == "\n") next();
+    }
+
+    /**
+     * Commands up to one of 'stops' (not consumed) or the end of the input.
+     * With 'nonEmpty', an empty list is a syntax error ('then fi').
+     */
+    ListNode *parseList(const char *const *stops, bool nonEmpty) {
+        ListNode *list = new ListNode();
+        while (true) {
+            while (peek().kind == Token::SEPARATOR && (peek().text == "\n" || peek().text == ";")) {
+                if (peek().text == ";" && list->empty()) break;
+                next();
+            }
+
+            const Token &token = peek();
+            bool stop = (token.kind == Token::END);
+            for (int i = 0; !stop && stops[i] != nullptr; ++i)
+                if (isKeyword(token, stops[i])) stop = true;
+            if (stop) break;
+
+            Node *item = parseAndOr();
+            if (item == nullptr) {
+                delete list;
+                return nullptr;
+            }
+            list->add(item);
+        }
+
+        if (nonEmpty && list->empty()) {
+            delete list;
+            return static_cast<ListNode*>(syntaxError(peek()));
+        }
+        return list;
+    }
+
+    Node *parseAndOr() {
+        Node *left = parsePipeline();
+        while (left != nullptr && peek().kind == Token::SEPARATOR && (peek().text == "&&" || peek().text == "||")) {
+            bool isAnd = (next().text == "&&");
+            ++m_open;
+            skipNewlines();
+            Node *right = parsePipeline();
+            --m_open;
+            if (right == nullptr) {
+                delete left;
+                return nullptr;
+            }
+            left = new AndOrNode(left, right, isAnd);
+        }
+        return left;
+    }
+
+    Node *parsePipeline() {
+        if (isKeyword(peek(), "!")) {
+            next();
+            Node *inner = parseCommand();
+            return inner ? new NotNode(inner) : nullptr;
+        }
+        return parseCommand();
+    }
+
+    Node *parseCommand() {
+        Token token = peek();
+        Node *node = nullptr;
+        switch (token.kind) {
+            case Token::TEXT:
+                next();
+                return makeSimple(token);
+            case Token::ARITH:
+                next();
+                node = new ArithNode(token.text);
+                break;
+            case Token::FUNCDEF:
+                return parseFunction();
+            case Token::KEYWORD:
+                if (token.text == "if") node = parseIf();
+                else if (token.text == "while" || token.text == "until") node = parseLoop();
+                else if (token.text == "for") node = parseFor();
+                else if (token.text == "{") node = parseGroup();
+                else return syntaxError(token);
+                break;
+            default:
+                return syntaxError(token);
+        }
+        return node ? parseSuffix(node) : nullptr;
+    }
+
+    /**
+     * Redirections and '| cmd' written right after a compound command.
+     */
+    Node *parseSuffix(Node *node) {
+        if (peek().kind != Token::TEXT) return node;
+        std::string text = next().text;
+
+        std::size_t bar = std::string::npos;
+        for (std::size_t i = 0; i < text.size(); ++i) {
+            std::size_t skipped = skipRegion(text, i);
+            if (skipped != i) {
+                i = skipped - 1;
+            } else if (text[i] == '|') {
+                bar = i;
+                break;
+            }
+        }
+
+        std::string redirections = (bar == std::string::npos) ? text : text.substr(0, bar);
+        if (redirections.find_first_not_of(BLANKS) != std::string::npos) {
+            std::string rest;
+            std::vector<FdOp> ops;
+            if (!parseRedirections(redirections, rest, ops)) {
+                m_failed = true;
+                delete node;
+                return nullptr;
+            }
+            rest = _trim(rest);
+            if (!rest.empty()) {
+                delete node;
+                return syntaxError(makeToken(Token::TEXT, rest.substr(0, rest.find_first_of(BLANKS))));
+            }
+            node = new RedirectNode(node, ops);
+        }
+
+        if (bar != std::string::npos) {
+            bool useStderr = (text.compare(bar, 2, "|&") == 0);
+            std::string right = _trim(text.substr(bar + (useStderr ? 2 : 1)));
+            if (right.empty()) {
+                delete node;
+                return syntaxError(makeToken(Token::TEXT, "|"));
+            }
+            node = new PipeNode(node, right, useStderr);
+        }
+        return node;
+    }
+
+    Node *makeSimple(const Token &token) {
+        const std::string &text = token.text;
+        std::size_t wordEnd = text.find_first_of(BLANKS);
+        std::string first = text.substr(0, wordEnd);
+        std::string rest = (wordEnd == std::string::npos) ? "" : text.substr(wordEnd);
+
+        if (first == "break") return new ControlNode(ControlNode::BREAK, first, rest);
+        if (first == "continue") return new ControlNode(ControlNode::CONTINUE, first, rest);
+        if (first == "return") return new ControlNode(ControlNode::RETURN, first, rest);
+        if (first == "local") return new ControlNode(ControlNode::LOCAL, first, rest);
+
+        // A lone NAME=word (quotes may hold blanks) skips the Command machinery
+        if (_isAssignmentWord(text) && token.hereDocs.empty()) {
+            bool single = true;
+            for (std::size_t i = 0; i < text.size() && single; ++i) {
+                std::size_t skipped = skipRegion(text, i);
+                if (skipped != i) i = skipped - 1;
+                else if (isspace((unsigned char) text[i]) || strchr("&|<>;()", text[i]) != nullptr) single = false;
+            }
+            if (single) {
+                std::size_t eq = text.find('=');
+                return new AssignNode(text.substr(0, eq), text.substr(eq + 1));
+            }
+        }
+        return new SimpleNode(text, token.hereDocs);
+    }
+
+    Node *parseIf() {
+        next();
+        ++m_open;
+        IfNode *node = new IfNode();
+        while (true) {
+            ListNode *condition = parseList(THEN_STOPS, true);
+            if (condition == nullptr || !expect("then")) {
+                delete condition;
+                delete node;
+                return nullptr;
+            }
+            ListNode *body = parseList(IF_BODY_STOPS, true);
+            if (body == nullptr) {
+                delete condition;
+                delete node;
+                return nullptr;
+            }
+            node->addBranch(condition, body);
+
+            Token token = next();
+            if (isKeyword(token, "elif")) continue;
+            if (isKeyword(token, "else")) {
+                ListNode *elseBody = parseList(FI_STOPS, true);
+                if (elseBody == nullptr) {
+                    delete node;
+                    return nullptr;
+                }
+                node->setElse(elseBody);
+                if (!expect("fi")) {
+                    delete node;
+                    return nullptr;
+                }
+            } else if (!isKeyword(token, "fi")) {
+                delete node;
+                return syntaxError(token);
+            }
+            break;
+        }
+        --m_open;
+        return node;
+    }
+
+    Node *parseLoop() {
+        bool until = (next().text == "until");
+        ++m_open;
+        ListNode *condition = parseList(DO_STOPS, true);
+        if (condition == nullptr || !expect("do")) {
+            delete condition;
+            return nullptr;
+        }
+        ListNode *body = parseList(DONE_STOPS, true);
+        if (body == nullptr || !expect("done")) {
+            delete condition;
+            delete body;
+            return nullptr;
+        }
+        --m_open;
+        return new LoopNode(condition, body, until);
+    }
+
+    Node *parseFor() {
+        next();
+        ++m_open;
+        Token clause = next();
+        if (clause.kind != Token::TEXT) return syntaxError(clause);
+
+        // "NAME" or "NAME in WORDS..."
+        std::string text = clause.text;
+        std::size_t nameEnd = text.find_first_of(BLANKS);
+        std::string name = text.substr(0, nameEnd);
+        std::string rest = (nameEnd == std::string::npos) ? "" : _trim(text.substr(nameEnd));
+        if (!isName(name)) {
+            std::cerr << "smash error: for: '" << name << "': not a valid identifier" << std::endl;
+            m_failed = true;
+            return nullptr;
+        }
+        bool hasWords = !rest.empty();
+        if (hasWords && !(rest.compare(0, 2, "in") == 0 && (rest.size() == 2 || isspace((unsigned char) rest[2])))) {
+            return syntaxError(makeToken(Token::TEXT, rest.substr(0, rest.find_first_of(BLANKS))));
+        }
+        std::string words = hasWords ? rest.substr(2) : "";
+
+        while (peek().kind == Token::SEPARATOR && (peek().text == "\n" || peek().text == ";")) next();
+        if (!expect("do")) return nullptr;
+        ListNode *body = parseList(DONE_STOPS, true);
+        if (body == nullptr || !expect("done")) {
+            delete body;
+            return nullptr;
+        }
+        --m_open;
+        return new ForNode(name, words, hasWords, body);
+    }
+
+    Node *parseGroup() {
+        next();
+        ++m_open;
+        ListNode *body = parseList(BRACE_STOPS, true);
+        if (body == nullptr || !expect("}")) {
+            delete body;
+            return nullptr;
+        }
+        --m_open;
+        return body;
+    }
+
+    Node *parseFunction() {
+        std::string name = next().text;
+        if (!isName(name) || reservedWords().count(name)) {
+            std::cerr << "smash error: '" << name << "': not a valid function name" << std::endl;
+            m_failed = true;
+            return nullptr;
+        }
+
+        ++m_open;
+        skipNewlines();
+        const Token &token = peek();
+        if (!(isKeyword(token, "{") || isKeyword(token, "if") || isKeyword(token, "while") ||
+              isKeyword(token, "until") || isKeyword(token, "for"))) {
+            return syntaxError(token);
+        }
+        Node *body = parseCommand();
+        if (body == nullptr) return nullptr;
+        --m_open;
+        return new FunctionDefNode(name, body);
+    }
+
+public:
+    explicit Parser(std::istream *input) : m_lexer(input), m_input(input), m_open(0), m_failed(false) {}
+
+    /**
+     * The whole program: 'line' and any lines its open constructs pull in.
+     */
+    Node *parse(const std::string &line) {
+        TRACE_SCOPE("script-parse");
+        m_lexer.lexLine(line, m_tokens);
+        ListNode *program = parseList(NO_STOPS, false);
+        if (program == nullptr) return nullptr;
+
+        // A stray closing word ('fi', 'done', '}') or operator ends up here
+        if (peek().kind != Token::END) {
+            delete program;
+            return syntaxError(peek());
+        }
+        return program;
+    }
+};
+
+}
+
+// ==================================================================================
+//                                Class: Script
+// ==================================================================================
+
+bool Script::isScript(const std::string &line) {
+    std::size_t start = line.find_first_not_of(" \n\t\r\f\v");
+    if (start == std::string::npos) return false;
+    if (line[start] == '#' || line.compare(start, 2, "((") == 0) return true;
+
+    std::size_t end = start;
+    while (end < line.size() && !isWordEnd(line[end])) ++end;
+
+    // Reserved words are short; a longer first word is not copied just to look it up
+    const std::size_t LONGEST_RESERVED = 8;
+    if (end - start <= LONGEST_RESERVED) {
+        std::string word = line.substr(start, end - start);
+        if (reservedWords().count(word) || word == "break" || word == "continue" ||
+            word == "return" || word == "local") {
+            return true;
+        }
+    }
+
+    std::size_t parens = line.find_first_not_of(BLANKS, end);
+    if (parens != std::string::npos && line.compare(parens, 2, "()") == 0 &&
+        isName(line.substr(start, end - start))) {
+        return true;
+    }
+
+    for (std::size_t i = start; i < line.size(); ++i) {
+        std::size_t skipped = skipRegion(line, i);
+        if (skipped != i) {
+            i = skipped - 1;
+            continue;
+        }
+        if (controlOperatorAt(line, i) != 0) return true;
+    }
+    return false;
+}
+
+void Script::run(const std::string &line, std::istream *input) {
+    TRACE_SCOPE("script");
+    SmallShell &smash = SmallShell::getInstance();
+
+    Parser parser(input);
+    Node *program = parser.parse(line);
+    if (program == nullptr) {
+        smash.setLastStatus(2);
+        return;
+    }
+
+    if (g_runDepth++ == 0) smash.setInterrupted(false);
+    smash.setLastStatus(0);
+    program->run();
+    if (--g_runDepth == 0) {
+        // A break outside any loop or a ctrl-C ends here
+        g_flow = FLOW_NONE;
+        g_flowLevels = 0;
+    }
+    delete program;
+}
+
+bool Script::hasFunction(const std::string &name) {
+    return !g_functions.empty() && g_functions.count(name) != 0;
+}
+
+void Script::callFunction(const ArgList &args) {
+    SmallShell &smash = SmallShell::getInstance();
+    auto it = g_functions.find(args[0].str());
+    if (it == g_functions.end()) return;
+
+    if ((int) g_frames.size() >= MAX_FUNCTION_DEPTH) {
+        std::cerr << "smash error: " << args[0] << ": maximum function nesting level exceeded ("
+                  << MAX_FUNCTION_DEPTH << ")" << std::endl;
+        smash.setLastStatus(1);
+        return;
+    }
+
+    // Keeps the body alive even if the function redefines or unsets itself
+    std::shared_ptr<Node> body = it->second;
+
+    std::vector<std::string> params(args.begin() + 1, args.end());
+    smash.swapPositional(params);
+    g_frames.push_back(std::vector<SavedVariable>());
+    int outerLoops = g_loopDepth;
+    g_loopDepth = 0;
+
+    smash.setLastStatus(0);
+    body->run();
+    if (g_flow == FLOW_RETURN) g_flow = FLOW_NONE;
+
+    // Local variables get their outer values back, last declared first
+    std::vector<SavedVariable> &frame = g_frames.back();
+    for (auto var = frame.rbegin(); var != frame.rend(); ++var) {
+        if (var->wasSet) smash.setVariable(var->name, var->value);
+        else smash.unsetVariable(var->name);
+    }
+    g_frames.pop_back();
+    g_loopDepth = outerLoops;
+    smash.swapPositional(params);
+}
@@ -0,0 +1,50 @@
+#ifndef SMASH_SCRIPT_H_
+#define SMASH_SCRIPT_H_
+
+#include <istream>
+#include <string>
+#include <vector>
+#include "Arena.h"
+
+// ==================================================================================
+//                                Class: Script
+// ==================================================================================
+// Control flow, lists and shell functions. A line that uses them is parsed once
+// into a tree of nodes, which is then run. Loop bodies are not parsed again on
+// each iteration. Supported syntax:
+//
+//   cmd1; cmd2    cmd1 && cmd2    cmd1 || cmd2    ! cmd    # comment
+//   if LIST; then LIST; [elif LIST; then LIST;]... [else LIST;] fi
+//   while LIST; do LIST; done       until LIST; do LIST; done
+//   for NAME [in WORDS]; do LIST; done      (without 'in': "$@")
+//   { LIST; }    (( expr ))    name() { LIST; }    function name { LIST; }
+//   break [n]    continue [n]    return [n]    local NAME[=value]...
+//
+// A compound command may be followed by redirections and by '| cmd'. If a
+// construct is not finished at the end of the line, the parser reads the next
+// input lines with a "> " prompt. Here-doc bodies inside a construct are read
+// right away, while parsing.
+//
+// Each simple command in the tree keeps its text. When it runs, the text goes
+// through SmallShell::runSimpleCommand(), so aliases, expansion, pipes and
+// redirections work as on a plain line. Assignments ('NAME=word') and '(( ))'
+// are evaluated directly, without creating a Command. Functions take their
+// arguments as $1..$N, and each call runs the body tree that was parsed when
+// the function was defined.
+class Script {
+public:
+    // True if 'line' needs the script engine: it starts with a reserved word, '((',
+    // a function definition or a comment, or it has an unquoted ';', '&&' or '||'
+    static bool isScript(const std::string &line);
+
+    // Parses 'line', plus further lines from 'input' while a construct is still
+    // open (nullptr: no continuation lines), then runs it. Syntax errors set $? to 2.
+    static void run(const std::string &line, std::istream *input);
+
+    static bool hasFunction(const std::string &name);
+
+    // Runs the function args[0] with args[1..] as $1..$N; its status ends up in $?
+    static void callFunction(const ArgList &args);
+};
+
+#endif //SMASH_SCRIPT_H_
@@ -0,0 +1,316 @@
+//
+// Created by Nikita Matrosov on 26/12/2025.
+//
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "Server.h"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+
+// ==================================================================================
+//                                Worker Pool
+// ==================================================================================
+
+namespace {
+
+struct Worker {
+    pid_t pid;
+    int channel;            // our end of the socketpair the client fd is sent on
+};
+
+struct ServerState {
+    int listenFd;
+    int epollFd;
+    int signalFd;
+    sigset_t oldMask;
+    std::vector<Worker> idle;
+    int sessions;           // workers that took a client and are still running
+    void (*prepare)();
+    void (*session)();
+};
+
+/**
+ * Blocks until the server sends a client fd on 'channel'. -1 if the server
+ * closed the channel instead (shutdown).
+ */
+int receiveClient(int channel) {
+    char byte;
+    struct iovec iov;
+    iov.iov_base = &byte;
+    iov.iov_len = 1;
+
+    union {
+        struct cmsghdr header;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    ssize_t n;
+    do {
+        n = recvmsg(channel, &msg, MSG_CMSG_CLOEXEC);
+    } while (n == -1 && errno == EINTR);
+    if (n <= 0) return -1;
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg == nullptr || cmsg->cmsg_type != SCM_RIGHTS) return -1;
+    int fd;
+    memcpy(&fd, CMSG_DATA(cmsg), sizeof(fd));
+    return fd;
+}
+
+bool sendClient(int channel, int fd) {
+    char byte = 'S';
+    struct iovec iov;
+    iov.iov_base = &byte;
+    iov.iov_len = 1;
+
+    union {
+        struct cmsghdr header;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    memset(&control, 0, sizeof(control));
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(fd));
+
+    // MSG_NOSIGNAL: a worker that died must not take the server down with SIGPIPE
+    return sendmsg(channel, &msg, MSG_NOSIGNAL) == 1;
+}
+
+/**
+ * Child side of a worker: drops the server's descriptors, runs the startup work,
+ * then waits for its client and runs the session on it. Never returns.
+ */
+void runWorker(ServerState &state, int channel) {
+    close(state.listenFd);
+    close(state.epollFd);
+    close(state.signalFd);
+    for (const auto &worker : state.idle) close(worker.channel);
+    sigprocmask(SIG_SETMASK, &state.oldMask, nullptr);
+    signal(SIGTERM, SIG_DFL);
+
+    state.prepare();
+    std::cout.flush();
+
+    int client = receiveClient(channel);
+    close(channel);
+    if (client == -1) _exit(0);
+
+    setsid(); // the session's jobs are no business of the server's process group
+    for (int fd = STDIN_FILENO; fd <= STDERR_FILENO; ++fd) {
+        if (dup2(client, fd) == -1) _exit(1);
+    }
+    if (client > STDERR_FILENO) close(client);
+
+    std::cin.clear();
+    state.session();
+    exit(0); // atexit handlers (journal, cgroups) run as for a normal shell
+}
+
+bool spawnWorker(ServerState &state) {
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) == -1) {
+        perror("smash error: --serve: socketpair failed");
+        return false;
+    }
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("smash error: --serve: fork failed");
+        close(sv[0]);
+        close(sv[1]);
+        return false;
+    }
+    if (pid == 0) {
+        close(sv[0]);
+        runWorker(state, sv[1]);
+    }
+    close(sv[1]);
+
+    Worker worker;
+    worker.pid = pid;
+    worker.channel = sv[0];
+    state.idle.push_back(worker);
+    return true;
+}
+
+/**
+ * Hands 'client' to an idle worker (forking one if the pool ran dry). The
+ * client fd is ours to close either way.
+ */
+void dispatch(ServerState &state, int client) {
+    while (true) {
+        if (state.idle.empty() && !spawnWorker(state)) break;
+
+        Worker worker = state.idle.back();
+        state.idle.pop_back();
+        bool sent = sendClient(worker.channel, client);
+        close(worker.channel);
+        if (sent) {
+            ++state.sessions;
+            break;
+        }
+        // The worker died before taking it; it is reaped on SIGCHLD. Try the next
+    }
+    close(client);
+}
+
+void reapChildren(ServerState &state) {
+    pid_t pid;
+    while ((pid = waitpid(-1, nullptr, WNOHANG)) > 0) {
+        bool wasIdle = false;
+        for (std::size_t i = 0; i < state.idle.size(); ++i) {
+            if (state.idle[i].pid != pid) continue;
+            close(state.idle[i].channel);
+            state.idle.erase(state.idle.begin() + i);
+            wasIdle = true;
+            break;
+        }
+        if (!wasIdle && state.sessions > 0) --state.sessions;
+    }
+}
+
+int openListener(const std::string &path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "smash error: --serve: socket path too long" << std::endl;
+        return -1;
+    }
+    strcpy(addr.sun_path, path.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        perror("smash error: --serve: socket failed");
+        return -1;
+    }
+    unlink(path.c_str()); // a socket left behind by an earlier server
+    if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) == -1 || listen(fd, SOMAXCONN) == -1) {
+        perror("smash error: --serve: bind failed");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+}
+
+// ==================================================================================
+//                                Class: Server
+// ==================================================================================
+
+int Server::run(const std::string &path, int workers, void (*prepare)(), void (*session)()) {
+    ServerState state;
+    state.sessions = 0;
+    state.prepare = prepare;
+    state.session = session;
+
+    state.listenFd = openListener(path);
+    if (state.listenFd == -1) return 1;
+
+    // SIGCHLD / SIGINT / SIGTERM arrive as epoll events instead of handlers
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigprocmask(SIG_BLOCK, &mask, &state.oldMask);
+    state.signalFd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    state.epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (state.signalFd == -1 || state.epollFd == -1) {
+        perror("smash error: --serve: epoll setup failed");
+        close(state.listenFd);
+        unlink(path.c_str());
+        return 1;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = state.listenFd;
+    epoll_ctl(state.epollFd, EPOLL_CTL_ADD, state.listenFd, &ev);
+    ev.data.fd = state.signalFd;
+    epoll_ctl(state.epollFd, EPOLL_CTL_ADD, state.signalFd, &ev);
+
+    std::cout << "smash: serving on " << path << " (" << workers << " workers)" << std::endl;
+    for (int i = 0; i < workers; ++i) spawnWorker(state);
+
+    bool running = true;
+    while (running) {
+        struct epoll_event events[2];
+        int n = epoll_wait(state.epollFd, events, 2, -1);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            perror("smash error: --serve: epoll_wait failed");
+            break;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            if (events[i].data.fd == state.signalFd) {
+                struct signalfd_siginfo info;
+                while (read(state.signalFd, &info, sizeof(info)) == (ssize_t) sizeof(info)) {
+                    if (info.ssi_signo != SIGCHLD) running = false;
+                }
+                reapChildren(state);
+                continue;
+            }
+
+            // Accept everything that is waiting; each client goes to its own worker
+            int client;
+            while ((client = accept4(state.listenFd, nullptr, nullptr, SOCK_CLOEXEC)) != -1) {
+                dispatch(state, client);
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                perror("smash error: --serve: accept failed");
+            }
+        }
+
+        // Keep the pool full, also after a worker died on its own
+        while (running && (int) state.idle.size() < workers && spawnWorker(state)) {}
+    }
+
+    // Idle workers see their channel close and exit; sessions keep running
+    for (const auto &worker : state.idle) close(worker.channel);
+    close(state.listenFd);
+    close(state.epollFd);
+    close(state.signalFd);
+    unlink(path.c_str());
+    std::cout << "smash: server stopped (" << state.sessions << " session(s) still running)" << std::endl;
+    return 0;
+}
+
+#else
+
+int Server::run(const std::string &, int, void (*)(), void (*)()) {
+    std::cerr << "smash error: --serve: only supported on Linux (epoll)" << std::endl;
+    return 1;
+}
+
+#endif
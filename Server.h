@@ -0,0 +1,33 @@
+#ifndef SMASH_SERVER_H_
+#define SMASH_SERVER_H_
+
+#include <string>
+
+// ==================================================================================
+//                                Class: Server
+// ==================================================================================
+// 'smash --serve <socket> [--workers N]': a long-lived daemon that serves shell
+// sessions over a Unix domain socket. Each connection is one session. Its lines
+// are read as commands and the output (prompts included) goes back on the same
+// socket, so 'socat - UNIX-CONNECT:<socket>' gives an interactive shell.
+//
+// Each session runs in its own process, so cwd, aliases, environment, variables
+// and jobs are separate per session. So is all other shell state: the SmallShell
+// singleton, du's counter, the job journal writer. The server keeps a pool of N
+// pre-forked workers. Each worker has already run the startup work ('prepare':
+// job table, journal, cgroups, ~/.smashrc) and waits on a socketpair. The server's
+// epoll loop accepts a connection and passes the client fd to an idle worker with
+// SCM_RIGHTS. That worker becomes the session, and a new worker is forked to
+// refill the pool. A session ends with 'quit' or when the client closes its end.
+//
+// SIGINT/SIGTERM stop the server: idle workers exit and the socket is removed.
+// Sessions still running finish on their own. Linux only (epoll, signalfd).
+class Server {
+public:
+    // Serves sessions on 'path' until SIGINT/SIGTERM; returns main()'s exit status.
+    // Each worker calls prepare() once when it is forked and session() with the
+    // client on stdin/stdout/stderr.
+    static int run(const std::string &path, int workers, void (*prepare)(), void (*session)());
+};
+
+#endif //SMASH_SERVER_H_
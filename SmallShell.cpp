@@ -3,13 +3,25 @@
 //
 
 #include "SmallShell.h"
+#include "Trace.h"
+#include "Metrics.h"
+#include "JobJournal.h"
+#include "Expansion.h"
+#include "Quoting.h"
+#include "ResourceLimits.h"
+#include "Script.h"
+#include "Output.h"
+#include "Arena.h"
 #include <unistd.h>
+#include <sys/wait.h>
 #include <iostream>
 #include <vector>
 #include <csignal>
 #include <climits>
 #include <algorithm>
 
+extern char** environ;
+
 // ==================================================================================
 //                                Static Helper Functions
 // ==================================================================================
@@ -34,19 +46,73 @@ static void _removeBackgroundSignString(std::string &s)
 }
 
 /**
- * Finds a character in a string, ignoring instances inside single quotes.
- * Critical for parsing pipes (|) and redirections (>) correctly.
+ * Finds a character in a string, ignoring instances inside single or double quotes.
+ * Critical for parsing pipes (|) and redirections (>, <) correctly.
  */
-static std::size_t findOutsideQuotes(const std::string& s, char ch)
+static std::size_t findOutsideQuotes(const char *s, char ch)
 {
-    bool inSingle = false;
-    for (std::size_t i = 0; i < s.size(); ++i) {
-        if (s[i] == '\'')  inSingle = !inSingle;
-        else if (!inSingle && s[i] == ch)  return i;
+    QuoteScan scan;
+    for (std::size_t i = 0; s[i] != '\0'; ++i) {
+        if (scan.at(s, i) == QuoteScan::PLAIN && s[i] == ch)  return i;
     }
     return std::string::npos;
 }
 
+/**
+ * Finds the fan-out operator '|>' outside quotes.
+ */
+static std::size_t findFanOut(const char *s)
+{
+    QuoteScan scan;
+    for (std::size_t i = 0; s[i] != '\0' && s[i + 1] != '\0'; ++i) {
+        if (scan.at(s, i) == QuoteScan::PLAIN && s[i] == '|' && s[i + 1] == '>')  return i;
+    }
+    return std::string::npos;
+}
+
+/**
+ * A string from a pool kept for the life of the shell, for the copies a line goes
+ * through while it runs. One is in use per nesting level (time, functions and
+ * redirections run lines from inside a line). assign() keeps the capacity of earlier
+ * lines, so a line costs no allocation once the buffers have grown to its length.
+ */
+class LineBuffer {
+private:
+    static std::deque<std::string> s_pool;  // a deque: growing it moves nothing
+    static std::size_t s_inUse;
+    std::string &m_text;
+
+    static std::string &take() {
+        if (s_inUse == s_pool.size()) s_pool.emplace_back();
+        return s_pool[s_inUse++];
+    }
+
+public:
+    explicit LineBuffer(const std::string &text) : m_text(take()) { m_text.assign(text); }
+    explicit LineBuffer(const char *text) : m_text(take()) { m_text.assign(text); }
+    LineBuffer() : m_text(take()) { m_text.clear(); }
+    ~LineBuffer() { --s_inUse; }
+
+    LineBuffer(LineBuffer const &) = delete;
+    void operator=(LineBuffer const &) = delete;
+
+    std::string &str() { return m_text; }
+};
+
+std::deque<std::string> LineBuffer::s_pool;
+std::size_t LineBuffer::s_inUse = 0;
+
+/**
+ * True for lines made only of NAME=value words (plain variable assignments).
+ */
+static bool isAssignmentOnly(const ArgList &args)
+{
+    for (const ArgRef &arg : args) {
+        if (!_isAssignmentWord(arg.data(), arg.size())) return false;
+    }
+    return !args.empty();
+}
+
 // ==================================================================================
 //                                Lifecycle & Constructor
 // ==================================================================================
@@ -56,7 +122,10 @@ SmallShell::SmallShell():
         m_promptMsg("smash> ")
 {
     m_reservedWordsSet = {
-            "chprompt", "showpid", "pwd", "cd", "jobs", "fg", "quit", "kill", "alias", "unalias", "whoami", "netinfo"
+            "chprompt", "showpid", "pwd", "cd", "jobs", "fg", "quit", "kill", "alias", "unalias", "whoami", "netinfo",
+            "time", "bench", "joblog", "pipestat", "perfstat", "submit", "unsetenv", "setenv", "export", "env", "limit", "ulimit",
+            "if", "then", "elif", "else", "fi", "while", "until", "do", "done", "for", "function",
+            "break", "continue", "return", "local"
     };
     char cwd[PATH_MAX];
     if (getcwd(cwd, sizeof(cwd)) == nullptr) {throw std::runtime_error("getcwd() error");}
@@ -68,6 +137,14 @@ SmallShell::SmallShell():
     m_cJCommandLine = "";
     m_cJisStopped = false;
     m_cJinsertionTime = 0;
+    m_usageCollector = nullptr;
+    m_interrupted = 0;
+    m_commandDepth = 0;
+    m_input = &std::cin;
+    m_lastStatus = 0;
+    m_lastBgPid = -1;
+    m_shellPid = getpid();
+    m_environment.load(environ);
 }
 
 // ==================================================================================
@@ -80,31 +157,67 @@ SmallShell::SmallShell():
  */
 Command* SmallShell::CreateCommand(const char *cmd_line)
 {
+    TRACE_SCOPE("CreateCommand");
+
     // check if the input line is empty or null
     if (!cmd_line) return nullptr;
-    std::string trimmed = _trim(cmd_line);
-    if (trimmed.empty()) return nullptr;
+    const char *text = cmd_line + strspn(cmd_line, " \n\r\t\f\v");
+    if (*text == '\0') return nullptr;
+
+    // 'time' prefixes a whole command line, so it binds looser than pipes and redirections
+    std::size_t headLen = strcspn(text, " \n\r\t\f\v");
+    auto headIs = [text, headLen](const char *word) {
+        return strlen(word) == headLen && strncmp(text, word, headLen) == 0;
+    };
+    if (headIs("time"))
+        return new TimeCommand(cmd_line);
+    if (headIs("limit"))
+        return new LimitCommand(cmd_line);
+    if (headIs("pipestat"))
+        return new PipeStatCommand(cmd_line);
+    if (headIs("perfstat"))
+        return new PerfStatCommand(cmd_line);
+    if (headIs("submit"))
+        return new SubmitCommand(cmd_line);
+
+    // fan-out ('|>') binds loosest of all: its producer may itself be a pipeline
+    if (findFanOut(text) != std::string::npos) {
+        Metrics::countCommand(Metrics::CMD_PIPE);
+        return new FanOutCommand(cmd_line);
+    }
 
     // check for pipe command ('|') - must be outside quotes
-    if (findOutsideQuotes(trimmed, '|') != std::string::npos)
+    if (findOutsideQuotes(text, '|') != std::string::npos) {
+        Metrics::countCommand(Metrics::CMD_PIPE);
         return new PipeCommand(cmd_line);
+    }
 
-    // check for redirection command ('>') - must be outside quotes
-    if (findOutsideQuotes(trimmed, '>') != std::string::npos)
+    // check for redirection command ('>' or '<') - must be outside quotes
+    if (findOutsideQuotes(text, '>') != std::string::npos ||
+        findOutsideQuotes(text, '<') != std::string::npos) {
+        Metrics::countCommand(Metrics::CMD_REDIRECTION);
         return new RedirectionCommand(cmd_line);
+    }
 
 
-    // parse command into a vector of strings
-    std::vector<std::string> args = splitCommandLine(trimmed);
+    // parse command into words, in an arena on the stack
+    alignas(std::max_align_t) char scratch[512];
+    Arena arena(scratch, sizeof(scratch));
+    ArgList args = tokenizeCommandLine(arena, text, strlen(text));
 
     if (args.empty()) return nullptr; // safety check
 
-    std::string firstWord = args[0];
+    const ArgRef &firstWord = args[0];
+    bool background = _isBackgroundComamnd(text);
+    bool inProcess = !background && !ResourceLimits::hasPending();
 
     Command *cmd = nullptr;
 
+    // shell functions come before the builtins they may be named after
+    if (Script::hasFunction(firstWord)) cmd = new FunctionCommand(cmd_line);
+
     // check against all built-in commands and create the right object
-    if (firstWord == "chprompt")       cmd = new ChpromtCommand(cmd_line);
+    else if (firstWord == "chprompt")  cmd = new ChpromtCommand(cmd_line);
     else if (firstWord == "showpid")   cmd = new ShowPidCommand(cmd_line);
     else if (firstWord == "pwd")       cmd = new GetCurrDirCommand(cmd_line);
     else if (firstWord == "cd")        cmd = new ChangeDirCommand(cmd_line);
@@ -115,14 +228,38 @@ Command* SmallShell::CreateCommand(const char *cmd_line)
     else if (firstWord == "alias")     cmd = new AliasCommand(cmd_line);
     else if (firstWord == "unalias")   cmd = new UnAliasCommand(cmd_line);
     else if (firstWord == "unsetenv")  cmd = new UnSetEnvCommand(cmd_line);
+    else if (firstWord == "setenv")    cmd = new SetEnvCommand(cmd_line);
+    else if (firstWord == "ulimit")    cmd = new UlimitCommand(cmd_line);
+    else if (firstWord == "export")    cmd = new ExportCommand(cmd_line);
+    else if (firstWord == "env" && args.size() == 1) cmd = new EnvCommand(cmd_line); // 'env cmd' is external
     else if (firstWord == "watchproc") cmd = new WatchProcCommand(cmd_line);
     else if (firstWord == "du")        cmd = new DiskUsageCommand(cmd_line);
     else if (firstWord == "whoami")    cmd = new WhoAmICommand(cmd_line);
     else if (firstWord == "netinfo")   cmd = new NetInfo(cmd_line);
+    else if (firstWord == "bench")     cmd = new BenchCommand(cmd_line);
+    else if (firstWord == "joblog")    cmd = new JobLogCommand(cmd_line);
+    else if (isAssignmentOnly(args))   cmd = new AssignmentCommand(cmd_line);
+
+        // fork-free versions of common utilities - with '&' the real programs run as jobs,
+        // and under 'limit' too (only a forked process can be limited)
+    else if (inProcess && firstWord == "echo")   cmd = new EchoCommand(cmd_line);
+    else if (inProcess && firstWord == "printf") cmd = new PrintfCommand(cmd_line);
+    else if (inProcess && (firstWord == "test" || firstWord == "[")) cmd = new TestCommand(cmd_line);
+    else if (inProcess && (firstWord == "true" || firstWord == ":")) cmd = new StatusCommand(cmd_line, 0);
+    else if (inProcess && firstWord == "false")  cmd = new StatusCommand(cmd_line, 1);
+    else if (inProcess && firstWord == "sleep")  cmd = new SleepCommand(cmd_line);
+    else if (inProcess && firstWord == "wc" && WcCommand::handles(args))     cmd = new WcCommand(cmd_line);
+    else if (inProcess && firstWord == "grep" && GrepCommand::handles(args)) cmd = new GrepCommand(cmd_line);
+    else if (inProcess && firstWord == "head" && HeadCommand::handles(args)) cmd = new HeadCommand(cmd_line);
+    else if (inProcess && firstWord == "tail" && TailCommand::handles(args)) cmd = new TailCommand(cmd_line);
 
         // if it's not a built-in command, treat it as an external command
-    else                               cmd = new ExternalCommand(cmd_line);
+    else {
+        Metrics::countCommand(Metrics::CMD_EXTERNAL);
+        return new ExternalCommand(cmd_line);
+    }
 
+    Metrics::countCommand(Metrics::CMD_BUILTIN);
 
     return cmd;
 }
@@ -135,21 +272,72 @@ Command* SmallShell::CreateCommand(const char *cmd_line)
  */
 void SmallShell::executeCommand(const char *org_cmd_line) {
     if (org_cmd_line == nullptr) return;
-    if (_trim(string(org_cmd_line)).empty()) return;
+    if (org_cmd_line[strspn(org_cmd_line, " \n\r\t\f\v")] == '\0') return;
+    TRACE_SCOPE("executeCommand");
+    LineBuffer line(org_cmd_line);
 
     SmallShell &smash = SmallShell::getInstance();
 
     // clean up finished jobs (zombies) before starting a new one
     smash.m_joblist.removeFinishedJobs();
 
-    // check if command is an alias and replace it
-    string procceced_cmd_line = smash.reproduceWithAlias(org_cmd_line);
+    // if/while/for, functions, (( )) and ';' / '&&' / '||' lists: parsed once, then run
+    // by the script engine. Only a top-level line may continue on further input lines.
+    if (Script::isScript(line.str())) {
+        bool topLevel = (m_commandDepth++ == 0);
+        double start = topLevel ? monotonicSeconds() : 0.0;
+        Script::run(line.str(), topLevel ? m_input : nullptr);
+        if (topLevel) Metrics::observeForegroundDuration(monotonicSeconds() - start);
+        --m_commandDepth;
+        return;
+    }
+
+    runSimpleCommand(line.str(), m_input);
+}
+
+void SmallShell::runSimpleCommand(const string &org_cmd_line, std::istream *hereDocInput) {
+    SmallShell &smash = SmallShell::getInstance();
+
+    // Builtin output is written once, when the command is done
+    ShellOutput::Batch batch;
+
+    // here-docs/here-strings become '<&N' on descriptors that live until we return
+    InlineInputs inlineInputs;
+    LineBuffer resolved(org_cmd_line);
+    string &cmd_line = resolved.str();
+    if (!inlineInputs.resolve(cmd_line, hereDocInput)) return;
+
+    // <(cmd) / >(cmd) start their children now and become /dev/fd/N arguments
+    ProcessSubstitutions substitutions;
+    if (!substitutions.resolve(cmd_line)) return;
+
+    // check if command is an alias and replace it - an alias may stand for a whole list
+    LineBuffer processed;
+    string &procceced_cmd_line = processed.str();
+    if (smash.reproduceWithAlias(cmd_line, procceced_cmd_line) && Script::isScript(procceced_cmd_line)) {
+        Script::run(procceced_cmd_line, nullptr);
+        return;
+    }
+
+    // $VAR, ${...}, $?, $$, $!, $(...) - one pass, after aliases and before parsing
+    if (!expandCommandLine(procceced_cmd_line)) {
+        m_lastStatus = 1;
+        return;
+    }
+
+    // $? was consumed above; commands only set it when they fail or wait for a child
+    m_lastStatus = 0;
 
     // foreground command - run and wait
     if (!_isBackgroundComamnd(procceced_cmd_line.c_str())) {
         Command *cmd = CreateCommand(procceced_cmd_line.c_str());
         if (cmd) {
+            // only top-level lines count - redirections and 'time' re-enter here
+            bool topLevel = (m_commandDepth++ == 0);
+            double start = topLevel ? monotonicSeconds() : 0.0;
             cmd->execute();
+            if (topLevel) Metrics::observeForegroundDuration(monotonicSeconds() - start);
+            --m_commandDepth;
             delete cmd;
         }
         return;
@@ -174,40 +362,123 @@ void SmallShell::executeCommand(const char *org_cmd_line) {
     }
 
     // external command in background - save cmd string for jobs list
-    smash.setNextBGPrint(std::string(org_cmd_line));
+    smash.setNextBGPrint(org_cmd_line);
     cmd->execute();
     delete cmd;
 }
 
 // ==================================================================================
-//                                Alias Management
+//                            Child Reaping & Accounting
 // ==================================================================================
 
-string  SmallShell::reproduceWithAlias(const char *cmd_line) {
-    char* args[COMMAND_MAX_ARGS];
-    int argsNum = _parseCommandLine(cmd_line, args);
+pid_t SmallShell::waitForChild(pid_t pid, int *status, int options) {
+    TRACE_SCOPE("wait");
+    if (!(options & WNOHANG)) ShellOutput::flush(); // e.g. 'fg' printed the command line
+    int localStatus;
+    struct rusage ru;
+    pid_t res = wait4(pid, &localStatus, options, &ru);
+    if (res <= 0) return res;
+
+    if (status) *status = localStatus;
+    bool ended = WIFEXITED(localStatus) || WIFSIGNALED(localStatus);
 
-    if (argsNum == 0) {
-        string  str = string(cmd_line);
-        return str;
+    // A stopped child's rusage is cumulative and comes again, in full, when it is reaped
+    if (m_usageCollector != nullptr && ended) {
+        m_usageCollector->addChild(ru);
     }
 
-    string result;
+    if (WIFSTOPPED(localStatus)) JobJournal::jobStopped(res);
+    else if (ended) JobJournal::jobFinished(res, localStatus, &ru);
+    return res;
+}
 
-    if (this->isAlias(string(args[0]))) {
-        result = this->getAliasMeaning(string(args[0]));
-        for (int i = 1; i < argsNum; i++) {
-            result += " " + string(args[i]);
-        }
+ResourceUsage *SmallShell::setUsageCollector(ResourceUsage *collector) {
+    ResourceUsage *prev = m_usageCollector;
+    m_usageCollector = collector;
+    return prev;
+}
+
+ResourceUsage SmallShell::executeMeasured(const char *cmd_line) {
+    ResourceUsage usage;
+    struct rusage selfBefore, selfAfter;
+
+    // Collect everything reaped while the command line runs
+    ResourceUsage *outer = setUsageCollector(&usage);
+    getrusage(RUSAGE_SELF, &selfBefore);
+    unsigned long allocsBefore = heapAllocations();
+    double start = monotonicSeconds();
+
+    executeCommand(cmd_line);
+
+    usage.wallSec = monotonicSeconds() - start;
+    usage.shellAllocs = heapAllocations() - allocsBefore;
+    getrusage(RUSAGE_SELF, &selfAfter);
+    setUsageCollector(outer);
+
+    // Nested measurement: the outer collector sees our children, but measures the shell itself
+    if (outer != nullptr) outer->merge(usage);
+
+    usage.addSelfDelta(selfBefore, selfAfter);
+    return usage;
+}
+
+// ==================================================================================
+//                          Variables & Special Parameters
+// ==================================================================================
+
+const string *SmallShell::findVariable(const string &name) const {
+    auto it = m_variables.find(name);
+    return (it == m_variables.end()) ? nullptr : &it->second;
+}
+
+void SmallShell::setVariable(const string &name, const string &value) {
+    m_variables[name] = value;
+}
+
+void SmallShell::unsetVariable(const string &name) {
+    m_variables.erase(name);
+}
+
+const string *SmallShell::lookupVariable(const string &name) const {
+    const string *value = findVariable(name);
+    return (value != nullptr) ? value : m_environment.find(name);
+}
+
+void SmallShell::assignVariable(const string &name, const string &value) {
+    if (m_environment.find(name) != nullptr) {
+        m_environment.set(name, value);
     } else {
-        result = string(cmd_line);
+        setVariable(name, value);
     }
+}
 
-    for (int i = 0; i < argsNum; ++i) {
-        free(args[i]);
-    }
+// ==================================================================================
+//                                Alias Management
+// ==================================================================================
+
+string  SmallShell::reproduceWithAlias(const char *cmd_line) {
+    string out;
+    reproduceWithAlias(string(cmd_line), out);
+    return out;
+}
+
+bool SmallShell::reproduceWithAlias(const string &line, string &out) {
+    TRACE_SCOPE("alias-expansion");
+    out.assign(line);
+    if (m_aliasesMap.empty()) return false;
+
+    // Only the command word is replaced - the rest of the line keeps its quoting
+    std::size_t start = line.find_first_not_of(" \n\r\t\f\v");
+    if (start == std::string::npos) return false;
+    std::size_t end = line.find_first_of(" \n\r\t\f\v", start);
+    if (end == std::string::npos) end = line.size();
+
+    auto alias = m_aliasesMap.find(line.substr(start, end - start));
+    if (alias == m_aliasesMap.end()) return false;
 
-    return result;
+    out.assign(alias->second);
+    out.append(line, end, std::string::npos);
+    return true;
 }
 
 bool SmallShell::isReservedWord(const string &word) {
@@ -300,6 +571,7 @@ bool SmallShell::isFGrunning() const {
 }
 
 void SmallShell::updateSmashAfterCjFinished(){
+    if (m_cJPid != -1) ResourceLimits::releaseJob(m_cJPid);
     this->setJobIdFree(m_cJobId);
     m_cJobId = -1;
     m_cJPid = -1;
@@ -343,8 +615,9 @@ void SmallShell::setCJinsertionTime(time_t mCJinsertionTime){ m_cJinsertionTime
 //                          Background Jobs List Wrappers
 // ==================================================================================
 
-void SmallShell::addBGJob(pid_t pid, const string& proccesed_cmd_line, bool isStopped, int jobId,const string & print_cmd_line) {
-    m_joblist.addJob(pid, proccesed_cmd_line, isStopped,jobId, ((print_cmd_line=="")? proccesed_cmd_line :print_cmd_line));
+void SmallShell::addBGJob(pid_t pid, const string& proccesed_cmd_line, bool isStopped, int jobId,const string & print_cmd_line,
+                          const std::vector<pid_t> &helperPids) {
+    m_joblist.addJob(pid, proccesed_cmd_line, isStopped,jobId, ((print_cmd_line=="")? proccesed_cmd_line :print_cmd_line), helperPids);
 }
 
 void SmallShell::printJobsList() { m_joblist.printJobsList(); }
@@ -7,9 +7,13 @@
 #include <deque>
 #include <map>
 #include <set>
+#include <unordered_map>
 #include <iostream>
+#include <csignal>
 #include "JobList.h"
+#include "Environment.h"
 #include "Commands.h"
+#include "ResourceUsage.h"
 
 #define COMMAND_MAX_LENGTH (200)
 #define COMMAND_MAX_ARGS (20)
@@ -27,6 +31,28 @@ void _removeBackgroundSign(char *cmd_line);
 int _parseCommandLine(const char *cmd_line, char **args);
 std::vector<std::string> splitCommandLine(const std::string &cmd_line);
 
+// Where a word of tokenizeCommandLine() starts in the line, and whether any of it was quoted
+struct WordSpan {
+    std::size_t start;
+    bool quoted;
+};
+
+// Splits on unquoted whitespace and removes the quotes ('a b' is one word). 'spans',
+// if given, receives one entry per word
+void tokenizeCommandLine(const std::string &cmd_line, std::vector<std::string> &words,
+                         std::vector<WordSpan> *spans = nullptr);
+
+// The same words as NUL-terminated copies in 'arena' - no heap allocation when the
+// arena has room
+ArgList tokenizeCommandLine(Arena &arena, const char *cmd_line, std::size_t len);
+
+// $? value of a wait status: exit code, or 128 + signal number
+int _waitStatusToExitStatus(int status);
+
+// NAME=value with a valid variable name
+bool _isAssignmentWord(const std::string &word);
+bool _isAssignmentWord(const char *word, std::size_t len);
+
 
 // ==================================================================================
 //                                Class: SmallShell
@@ -63,6 +89,30 @@ private:
 
     // -------------------------- Background Job Management -------------------------
     std::string m_nextBGPrintCmdLine;
+    std::vector<pid_t> m_nextJobHelpers;
+
+    // ---------------------------- Resource Accounting -----------------------------
+    // Active 'time' accumulator (nullptr when nothing is being timed)
+    ResourceUsage *m_usageCollector;
+
+    // Set by the ctrl-C handler so long-running builtins (bench) can stop early
+    volatile sig_atomic_t m_interrupted;
+
+    // executeCommand() nesting level (redirections and 'time' re-enter it)
+    int m_commandDepth;
+
+    // Where here-document bodies are read from (the REPL's input)
+    std::istream *m_input;
+
+    // ------------------------------ Parameters ------------------------------------
+    // Shell variables (NAME=value); exported ones live in m_environment instead
+    std::unordered_map<string, string> m_variables;
+    Environment m_environment;
+
+    std::vector<string> m_positional;   // $1 $2 ... - the arguments of the running function
+    int m_lastStatus;     // $?
+    pid_t m_lastBgPid;    // $! (-1 until a background job is started)
+    pid_t m_shellPid;     // $$ - stays the shell's pid inside forked pipeline stages
 
     // ==============================================================================
     //                                Private Methods
@@ -95,9 +145,64 @@ public:
     // Main entry point: Parses, handles aliases, and executes a command line
     void executeCommand(const char *procceced_cmd_line);
 
+    // One simple command (no ';', '&&', '||' or compound commands): here-docs,
+    // process substitutions, aliases, expansion, then CreateCommand(). The script
+    // engine calls this directly, with here-doc bodies it read at parse time.
+    void runSimpleCommand(const string &cmd_line, std::istream *hereDocInput);
+
     // Factory method: Creates a specific Command object based on the first word
     Command *CreateCommand(const char *cmd_line);
 
+    // ==============================================================================
+    //                          Child Reaping & Accounting
+    // ==============================================================================
+
+    // waitpid() replacement: reaps with wait4() and feeds the active usage collector
+    pid_t waitForChild(pid_t pid, int *status, int options);
+
+    // Installs a collector for reaped children; returns the previous one
+    ResourceUsage *setUsageCollector(ResourceUsage *collector);
+
+    // Runs a command line through executeCommand() and returns its wall/rusage totals
+    ResourceUsage executeMeasured(const char *cmd_line);
+
+    // Input stream that here-documents continue on
+    void setInputStream(std::istream *input) { m_input = input; }
+    std::istream *getInputStream() const { return m_input; }
+
+    // Ctrl-C bookkeeping for builtins that loop
+    void setInterrupted(bool interrupted) { m_interrupted = interrupted ? 1 : 0; }
+    bool isInterrupted() const { return m_interrupted != 0; }
+
+    // ==============================================================================
+    //                          Variables & Special Parameters
+    // ==============================================================================
+
+    // Shell variable value, or nullptr if unset (the environment is not consulted)
+    const string *findVariable(const string &name) const;
+    void setVariable(const string &name, const string &value);
+    void unsetVariable(const string &name);
+
+    // What '$NAME' sees: the shell variable, else the environment variable, else nullptr
+    const string *lookupVariable(const string &name) const;
+    // NAME=value: updates the environment if NAME is exported, else the shell variable
+    void assignVariable(const string &name, const string &value);
+
+    const std::unordered_map<string, string> &getVariables() const { return m_variables; }
+    Environment &getEnvironment() { return m_environment; }
+
+    int getLastStatus() const { return m_lastStatus; }
+    void setLastStatus(int status) { m_lastStatus = status; }
+
+    pid_t getLastBgPid() const { return m_lastBgPid; }
+    void setLastBgPid(pid_t pid) { m_lastBgPid = pid; }
+
+    pid_t getShellPid() const { return m_shellPid; }
+
+    // $1 ... $N; swap in a function's arguments and put the caller's back afterwards
+    const std::vector<string> &getPositional() const { return m_positional; }
+    void swapPositional(std::vector<string> &params) { m_positional.swap(params); }
+
     // ==============================================================================
     //                         Foreground Job Getters/Setters
     // ==============================================================================
@@ -148,7 +253,8 @@ public:
     // ==============================================================================
     //                        Background Jobs Management
     // ==============================================================================
-    void addBGJob(pid_t pid, const string& proccesed_cmd_line, bool isStopped = false, int jobId = -1, const string & print_cmd_line = "");
+    void addBGJob(pid_t pid, const string& proccesed_cmd_line, bool isStopped = false, int jobId = -1, const string & print_cmd_line = "",
+                  const std::vector<pid_t> &helperPids = std::vector<pid_t>());
     void printJobsList();
     int getLastJobJId();
     pid_t getLastJobPid();
@@ -158,6 +264,13 @@ public:
     bool isContainsBGJob(int jobId);
     void removeBGjobByJID(int jobId);
 
+    // 'submit': job 'jobId' waits behind its gate until the limits admit it (JobQueue.h)
+    bool queueBGJob(int jobId, const int gate[2], const SubmitLimits &limits) {
+        return m_joblist.queueJob(jobId, gate, limits);
+    }
+    bool isSubmitQueueFull() const { return m_joblist.isSubmitQueueFull(); }
+    void closeSubmitGatesInChild() { m_joblist.closeSubmitGatesInChild(); }
+
     // Iterates over jobs and removes those that have finished (waitpid with WNOHANG)
     void removeFinishedJobs() { m_joblist.removeFinishedJobs(); }
 
@@ -172,6 +285,15 @@ public:
         return tmp;
     }
 
+    // same for the process substitution children of the command being launched:
+    // they go to its job if it becomes one (background or stopped)
+    void setNextJobHelpers(const std::vector<pid_t>& pids) { m_nextJobHelpers = pids; }
+    std::vector<pid_t> takeNextJobHelpers() {
+        std::vector<pid_t> tmp;
+        tmp.swap(m_nextJobHelpers);
+        return tmp;
+    }
+
     // ==============================================================================
     //                             Alias Management
     // ==============================================================================
@@ -180,9 +302,13 @@ public:
     void addAlias(const string &alias, const string &commandStr);
     void removeAlias(const string &alias);
     string getAliasMeaning(const string &alias);
+    const std::vector<string> &getAliasOrder() const { return m_aliasOrder; }
 
     // Replaces the command word with its alias value if it exists in the map
     string reproduceWithAlias(const char* cmd_line);
+
+    // Same, written into 'out' (its capacity is reused); true if an alias was replaced
+    bool reproduceWithAlias(const string &cmd_line, string &out);
     void printAllAliases();
 };
 
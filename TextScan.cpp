@@ -0,0 +1,393 @@
+//
+// Created by Nikita Matrosov on 01/01/2026.
+//
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "TextScan.h"
+#include "Output.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TEXT_SCAN_X86
+#include <immintrin.h>
+// The Makefile builds without -O; the kernels are worth optimizing regardless
+#define TARGET_SSE2 __attribute__((target("sse2"), optimize("O2")))
+#define TARGET_AVX2 __attribute__((target("avx2,popcnt"), optimize("O2")))
+#endif
+
+// ==================================================================================
+//                                Scalar Kernels
+// ==================================================================================
+
+namespace {
+
+inline bool isBlank(unsigned char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+std::size_t countLinesScalar(const char *data, std::size_t len) {
+    std::size_t count = 0;
+    const char *end = data + len;
+    const char *p = data;
+    while (p < end && (p = static_cast<const char*>(memchr(p, '\n', end - p))) != nullptr) {
+        ++count;
+        ++p;
+    }
+    return count;
+}
+
+std::size_t countWordsScalar(const char *data, std::size_t len, bool &inWord) {
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < len; ++i) {
+        if (isBlank((unsigned char) data[i])) {
+            inWord = false;
+        } else if (!inWord) {
+            inWord = true;
+            ++count;
+        }
+    }
+    return count;
+}
+
+const char *findFixedScalar(const char *data, std::size_t len, const std::string &needle) {
+    if (needle.empty()) return data;
+    if (needle.size() > len) return nullptr;
+    if (needle.size() == 1) return static_cast<const char*>(memchr(data, needle[0], len));
+    return static_cast<const char*>(memmem(data, len, needle.data(), needle.size()));
+}
+
+// ==================================================================================
+//                                x86 Kernels
+// ==================================================================================
+
+#ifdef TEXT_SCAN_X86
+
+TARGET_SSE2 std::size_t countLinesSse2(const char *data, std::size_t len) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i zero = _mm_setzero_si128();
+    __m128i total = zero;
+    std::size_t i = 0;
+    while (i + 16 <= len) {
+        // A byte lane counts up to 255 matches before it has to be folded into 'total'
+        __m128i lanes = zero;
+        std::size_t blocks = std::min<std::size_t>((len - i) / 16, 255);
+        for (std::size_t b = 0; b < blocks; ++b, i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            lanes = _mm_sub_epi8(lanes, _mm_cmpeq_epi8(v, newline));
+        }
+        total = _mm_add_epi64(total, _mm_sad_epu8(lanes, zero));
+    }
+    uint64_t sums[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(sums), total);
+    return sums[0] + sums[1] + countLinesScalar(data + i, len - i);
+}
+
+TARGET_AVX2 std::size_t countLinesAvx2(const char *data, std::size_t len) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i total = zero;
+    std::size_t i = 0;
+    while (i + 32 <= len) {
+        __m256i lanes = zero;
+        std::size_t blocks = std::min<std::size_t>((len - i) / 32, 255);
+        for (std::size_t b = 0; b < blocks; ++b, i += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            lanes = _mm256_sub_epi8(lanes, _mm256_cmpeq_epi8(v, newline));
+        }
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(lanes, zero));
+    }
+    uint64_t sums[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(sums), total);
+    return sums[0] + sums[1] + sums[2] + sums[3] + countLinesScalar(data + i, len - i);
+}
+
+TARGET_SSE2 std::size_t countWordsSse2(const char *data, std::size_t len, bool &inWord) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i four = _mm_set1_epi8(4);
+    std::size_t count = 0;
+    std::size_t i = 0;
+    unsigned carry = inWord ? 0 : 1;    // 1: the byte before this block was blank
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i control = _mm_sub_epi8(v, tab);     // '\t'..'\r' become 0..4
+        __m128i isControl = _mm_cmpeq_epi8(_mm_min_epu8(control, four), control);
+        unsigned blank = (unsigned) _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, space), isControl));
+        unsigned starts = ~blank & ((blank << 1) | carry) & 0xFFFFu;
+        count += __builtin_popcount(starts);
+        carry = (blank >> 15) & 1u;
+    }
+    inWord = (carry == 0);
+    return count + countWordsScalar(data + i, len - i, inWord);
+}
+
+TARGET_AVX2 std::size_t countWordsAvx2(const char *data, std::size_t len, bool &inWord) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i four = _mm256_set1_epi8(4);
+    std::size_t count = 0;
+    std::size_t i = 0;
+    uint32_t carry = inWord ? 0 : 1;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i control = _mm256_sub_epi8(v, tab);
+        __m256i isControl = _mm256_cmpeq_epi8(_mm256_min_epu8(control, four), control);
+        uint32_t blank = (uint32_t) _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, space), isControl));
+        uint32_t starts = ~blank & ((blank << 1) | carry);
+        count += __builtin_popcount(starts);
+        carry = blank >> 31;
+    }
+    inWord = (carry == 0);
+    return count + countWordsScalar(data + i, len - i, inWord);
+}
+
+TARGET_SSE2 const char *findFixedSse2(const char *data, std::size_t len, const std::string &needle) {
+    std::size_t k = needle.size();
+    if (k < 2 || k > len) return findFixedScalar(data, len, needle); // memchr is vectorized already
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[k - 1]);
+    std::size_t i = 0;
+    for (; i + k - 1 + 16 <= len; i += 16) {
+        __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + k - 1));
+        unsigned mask = (unsigned) _mm_movemask_epi8(
+                _mm_and_si128(_mm_cmpeq_epi8(blockFirst, first), _mm_cmpeq_epi8(blockLast, last)));
+        while (mask != 0) {
+            unsigned bit = __builtin_ctz(mask);
+            if (memcmp(data + i + bit + 1, needle.data() + 1, k - 2) == 0) return data + i + bit;
+            mask &= mask - 1;
+        }
+    }
+    return findFixedScalar(data + i, len - i, needle);
+}
+
+TARGET_AVX2 const char *findFixedAvx2(const char *data, std::size_t len, const std::string &needle) {
+    std::size_t k = needle.size();
+    if (k < 2 || k > len) return findFixedScalar(data, len, needle);
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[k - 1]);
+    std::size_t i = 0;
+    for (; i + k - 1 + 32 <= len; i += 32) {
+        __m256i blockFirst = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i blockLast = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + k - 1));
+        uint32_t mask = (uint32_t) _mm256_movemask_epi8(
+                _mm256_and_si256(_mm256_cmpeq_epi8(blockFirst, first), _mm256_cmpeq_epi8(blockLast, last)));
+        while (mask != 0) {
+            unsigned bit = __builtin_ctz(mask);
+            if (memcmp(data + i + bit + 1, needle.data() + 1, k - 2) == 0) return data + i + bit;
+            mask &= mask - 1;
+        }
+    }
+    return findFixedScalar(data + i, len - i, needle);
+}
+
+#endif
+
+// ==================================================================================
+//                                Dispatch
+// ==================================================================================
+
+struct Kernels {
+    const char *name;
+    std::size_t (*countLines)(const char *, std::size_t);
+    std::size_t (*countWords)(const char *, std::size_t, bool &);
+    const char *(*findFixed)(const char *, std::size_t, const std::string &);
+};
+
+/**
+ * The widest kernels the CPU runs. SMASH_SIMD=sse2 or =scalar caps the choice
+ * (for comparing them, and for checking the fallbacks on a newer machine).
+ */
+Kernels selectKernels() {
+    const char *env = getenv("SMASH_SIMD");
+    std::string cap = (env != nullptr) ? env : "";
+#ifdef TEXT_SCAN_X86
+    __builtin_cpu_init();
+    if (cap != "scalar" && cap != "sse2" && __builtin_cpu_supports("avx2")) {
+        Kernels avx2 = {"avx2", countLinesAvx2, countWordsAvx2, findFixedAvx2};
+        return avx2;
+    }
+    if (cap != "scalar" && __builtin_cpu_supports("sse2")) {
+        Kernels sse2 = {"sse2", countLinesSse2, countWordsSse2, findFixedSse2};
+        return sse2;
+    }
+#endif
+    Kernels scalar = {"scalar", countLinesScalar, countWordsScalar, findFixedScalar};
+    return scalar;
+}
+
+const Kernels &kernels() {
+    static const Kernels chosen = selectKernels();
+    return chosen;
+}
+
+}
+
+// ==================================================================================
+//                                Class: TextScan
+// ==================================================================================
+
+const char *TextScan::kernel() {
+    return kernels().name;
+}
+
+std::size_t TextScan::countLines(const char *data, std::size_t len) {
+    return kernels().countLines(data, len);
+}
+
+std::size_t TextScan::countWords(const char *data, std::size_t len, bool &inWord) {
+    return kernels().countWords(data, len, inWord);
+}
+
+const char *TextScan::findFixed(const char *data, std::size_t len, const std::string &needle) {
+    return kernels().findFixed(data, len, needle);
+}
+
+const char *TextScan::findLastNewline(const char *data, std::size_t len) {
+#ifdef __linux__
+    return static_cast<const char*>(memrchr(data, '\n', len));
+#else
+    for (std::size_t i = len; i > 0; --i) {
+        if (data[i - 1] == '\n') return data + i - 1;
+    }
+    return nullptr;
+#endif
+}
+
+// ==================================================================================
+//                                Class: TextInput
+// ==================================================================================
+
+namespace {
+
+const std::size_t BUFFER_SIZE = 1 << 20;
+
+// Reused by every filter; heap-allocated once and never freed, like the output chunks
+std::vector<char> *g_buffer = nullptr;
+bool g_bufferInUse = false;
+
+// The shell itself; 0 until init()
+pid_t g_shellPid = 0;
+
+}
+
+void TextInput::init() {
+    g_shellPid = getpid();
+}
+
+TextInput::TextInput(const std::string &cmd, const std::string &path)
+        : m_fd(-1), m_ownsFd(false), m_failed(false), m_done(false), m_map(nullptr), m_mapLen(0),
+          m_regularSize(-1), m_buffer(nullptr), m_block(nullptr), m_blockLen(0), m_cmd(cmd), m_name(path)
+{
+    if (path == "-") {
+        m_fd = STDIN_FILENO;
+    } else {
+        m_fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (m_fd == -1) {
+            std::cerr << "smash error: " << cmd << ": " << path << ": " << strerror(errno) << std::endl;
+            m_failed = true;
+            return;
+        }
+        m_ownsFd = true;
+    }
+
+    // A regular file (stdin included) is mapped from its current offset to its end
+    struct stat st;
+    if (fstat(m_fd, &st) == -1 || !S_ISREG(st.st_mode)) return;
+    off_t offset = lseek(m_fd, 0, SEEK_CUR);
+    if (offset == -1 || offset > st.st_size) return;
+    m_regularSize = st.st_size - offset;
+    if (m_regularSize == 0) {
+        m_done = true;
+        return;
+    }
+
+    // A file truncated under the mapping faults with SIGBUS, which would take the shell
+    // down: only a forked stage maps, the shell reads through the buffer
+    if (g_shellPid == 0 || getpid() == g_shellPid) return;
+
+    void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+    if (map == MAP_FAILED) return; // e.g. /proc files: read them instead
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    m_map = map;
+    m_mapLen = st.st_size;
+    m_block = static_cast<const char*>(map) + offset;
+    m_blockLen = st.st_size - offset;
+}
+
+TextInput::~TextInput() {
+    if (m_map != nullptr) munmap(m_map, m_mapLen);
+    if (m_buffer == g_buffer && m_buffer != nullptr) g_bufferInUse = false;
+    else delete m_buffer;
+    if (m_ownsFd) close(m_fd);
+}
+
+bool TextInput::next(const char *&data, std::size_t &len, std::size_t keep) {
+    if (m_failed || m_done) return false;
+
+    if (m_map != nullptr) {
+        // The whole mapped file is one block; the offset moves past it as read() would
+        m_done = true;
+        lseek(m_fd, 0, SEEK_END);
+        data = m_block;
+        len = m_blockLen;
+        return true;
+    }
+
+    if (m_buffer == nullptr) {
+        if (g_buffer == nullptr) g_buffer = new std::vector<char>(BUFFER_SIZE);
+        if (!g_bufferInUse) {
+            g_bufferInUse = true;
+            m_buffer = g_buffer;
+        } else {
+            m_buffer = new std::vector<char>(BUFFER_SIZE);
+        }
+    }
+
+    // Kept bytes move to the front; a line longer than the buffer makes it grow
+    std::vector<char> &buffer = *m_buffer;
+    keep = std::min(keep, m_blockLen);
+    if (keep > 0) memmove(&buffer[0], m_block + m_blockLen - keep, keep);
+    if (buffer.size() - keep < BUFFER_SIZE / 2) buffer.resize(buffer.size() * 2);
+
+    // A pipe or terminal may block: what the filter printed so far goes out first,
+    // so 'grep -F x | head -n 1' streams instead of waiting for the end of its input
+    if (m_regularSize < 0) {
+        std::cout.flush();
+        ShellOutput::flush();
+    }
+
+    ssize_t n;
+    do {
+        n = read(m_fd, &buffer[keep], buffer.size() - keep);
+    } while (n == -1 && errno == EINTR);
+    if (n == -1) {
+        std::cerr << "smash error: " << m_cmd << ": " << m_name << ": " << strerror(errno) << std::endl;
+        m_failed = true;
+        return false;
+    }
+    if (n == 0) {
+        m_done = true;
+        if (keep == 0) return false;
+    }
+
+    m_block = &buffer[0];
+    m_blockLen = keep + n;
+    data = m_block;
+    len = m_blockLen;
+    return true;
+}
+
+void TextInput::unread(std::size_t len) {
+    if (len > 0) lseek(m_fd, -(off_t) len, SEEK_CUR); // fails harmlessly on a pipe
+}
@@ -0,0 +1,92 @@
+#ifndef SMASH_TEXT_SCAN_H_
+#define SMASH_TEXT_SCAN_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// ==================================================================================
+//                                Class: TextScan
+// ==================================================================================
+// Byte-scanning kernels for the in-process text filters (wc, grep -F, head, tail).
+// On x86 each kernel has an SSE2 and an AVX2 version, picked once at startup with
+// __builtin_cpu_supports(). Everywhere else the scalar versions run (memchr/memmem).
+//  - countLines: compares 32 (16) bytes at a time against '\n' and sums the
+//    compare masks in byte lanes, folded with _mm256_sad_epu8 every 255 blocks;
+//  - countWords: one whitespace mask per block; a word starts at every non-blank
+//    byte whose previous byte was blank (the mask shifted by one, plus a carry);
+//  - findFixed: first/last-byte filter. Every position where both the needle's
+//    first byte and its last byte line up is a candidate, checked with memcmp.
+class TextScan {
+public:
+    // "avx2", "sse2" or "scalar"
+    static const char *kernel();
+
+    // Number of '\n' bytes in [data, data + len)
+    static std::size_t countLines(const char *data, std::size_t len);
+
+    // Number of words (runs of non-blank bytes) that start in the block. 'inWord'
+    // says whether the previous block ended inside a word, and is updated
+    static std::size_t countWords(const char *data, std::size_t len, bool &inWord);
+
+    // First occurrence of 'needle' in the block, or nullptr. An empty needle matches at 'data'
+    static const char *findFixed(const char *data, std::size_t len, const std::string &needle);
+
+    // Last '\n' in [data, data + len), or nullptr
+    static const char *findLastNewline(const char *data, std::size_t len);
+};
+
+// ==================================================================================
+//                                Class: TextInput
+// ==================================================================================
+// One input of a text filter. In a forked stage a regular file is mmapped and comes
+// back as a single block. In the shell itself, and for anything else (pipe, terminal,
+// socket), input is read into one large buffer that is kept between commands, so a
+// filter allocates nothing per chunk.
+class TextInput {
+private:
+    int m_fd;
+    bool m_ownsFd;
+    bool m_failed;
+    bool m_done;
+    void *m_map;
+    std::size_t m_mapLen;
+    long long m_regularSize;
+    std::vector<char> *m_buffer;    // the shared buffer, or a private one if it is in use
+    const char *m_block;
+    std::size_t m_blockLen;
+    std::string m_cmd;
+    std::string m_name;
+
+public:
+    // Records the shell's process (each server worker's, too); its forked copies map files
+    static void init();
+
+    // 'path' "-" is stdin. Prints "smash error: <cmd>: <path>: ..." if it cannot be opened
+    TextInput(const std::string &cmd, const std::string &path);
+    ~TextInput();
+
+    TextInput(TextInput const &) = delete;
+    void operator=(TextInput const &) = delete;
+
+    // False if the input could not be opened or a read failed
+    bool ok() const { return !m_failed; }
+
+    // Next block of input; false once nothing is left or on error. The first 'keep'
+    // bytes of the block are the last 'keep' bytes of the previous one, e.g. a line
+    // that was cut off. A mapped file is a single block
+    bool next(const char *&data, std::size_t &len, std::size_t keep = 0);
+
+    // True once the block next() returned is the last one (the kept bytes, at least,
+    // get a final block of their own)
+    bool atEnd() const { return m_done; }
+
+    // Gives the last 'len' bytes of the current block back to a seekable input, so
+    // 'head -n 1' on a file descriptor leaves it after the first line
+    void unread(std::size_t len);
+
+    // For wc's column width: what is left of a regular file, else -1
+    long long regularSize() const { return m_regularSize; }
+};
+
+#endif //SMASH_TEXT_SCAN_H_
@@ -0,0 +1,149 @@
+//
+// Created by Nikita Matrosov on 04/12/2025.
+//
+
+#include "Trace.h"
+
+#ifdef SMASH_TRACE_ENABLED
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+// ==================================================================================
+//                                Static State
+// ==================================================================================
+
+namespace {
+
+struct TraceEvent {
+    const char *name;
+    uint64_t ts;
+    uint64_t dur;
+};
+
+const int TRACE_BUFFER_EVENTS = 4096;
+
+TraceEvent g_events[TRACE_BUFFER_EVENTS];
+int g_eventCount = 0;
+int g_traceFd = -1;
+pid_t g_pid = 0;
+
+// Open fork->exec span of a forked child (0 when none)
+uint64_t g_childSpanStart = 0;
+
+}
+
+bool Tracer::s_enabled = false;
+
+// ==================================================================================
+//                                Class: Tracer
+// ==================================================================================
+
+void Tracer::init() {
+    const char *path = getenv("SMASH_TRACE");
+    if (path == nullptr || *path == '\0') return;
+
+    // O_CLOEXEC: exec'ed programs must not inherit the trace file
+    g_traceFd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0666);
+    if (g_traceFd == -1) {
+        perror("smash error: trace: open failed");
+        return;
+    }
+
+    // Chrome's JSON array format tolerates a missing closing bracket, which lets
+    // every process append its own events without coordination
+    if (write(g_traceFd, "[\n", 2) != 2) {
+        close(g_traceFd);
+        g_traceFd = -1;
+        return;
+    }
+
+    g_pid = getpid();
+    s_enabled = true;
+    atexit(Tracer::flush);
+}
+
+uint64_t Tracer::nowMicros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void Tracer::record(const char *name, uint64_t startUs, uint64_t endUs) {
+    if (!s_enabled) return;
+    if (g_eventCount == TRACE_BUFFER_EVENTS) flush();
+
+    TraceEvent &ev = g_events[g_eventCount++];
+    ev.name = name;
+    ev.ts = startUs;
+    ev.dur = endUs - startUs;
+}
+
+void Tracer::flush() {
+    if (!s_enabled || g_eventCount == 0) return;
+
+    char out[16384];
+    std::size_t used = 0;
+
+    for (int i = 0; i < g_eventCount; ++i) {
+        const TraceEvent &ev = g_events[i];
+        int n = snprintf(out + used, sizeof(out) - used,
+                         "{\"name\":\"%s\",\"cat\":\"smash\",\"ph\":\"X\",\"ts\":%llu,"
+                         "\"dur\":%llu,\"pid\":%d,\"tid\":%d},\n",
+                         ev.name, (unsigned long long) ev.ts, (unsigned long long) ev.dur,
+                         (int) g_pid, (int) g_pid);
+        if (n < 0) break;
+
+        // Out of room: write what we have and format this event again
+        if ((std::size_t) n >= sizeof(out) - used) {
+            if (used == 0) continue; // a single oversized event is dropped
+            if (write(g_traceFd, out, used) == -1) break;
+            used = 0;
+            --i;
+            continue;
+        }
+        used += n;
+    }
+
+    if (used > 0 && write(g_traceFd, out, used) == -1) {
+        // nothing sensible to do - tracing must never disturb the shell
+    }
+    g_eventCount = 0;
+}
+
+void Tracer::onForkChild() {
+    if (!s_enabled) return;
+    g_eventCount = 0;       // the parent will flush these itself
+    g_pid = getpid();
+    g_childSpanStart = nowMicros();
+}
+
+void Tracer::beforeExec() {
+    if (!s_enabled) return;
+    if (g_childSpanStart) {
+        record("fork->exec", g_childSpanStart, nowMicros());
+        g_childSpanStart = 0;
+    }
+    flush();
+}
+
+// ==================================================================================
+//                                Global Helpers
+// ==================================================================================
+
+pid_t tracedFork() {
+    uint64_t start = Tracer::isEnabled() ? Tracer::nowMicros() : 0;
+    pid_t pid = fork();
+
+    if (pid == 0) {
+        Tracer::onForkChild();
+    } else if (start) {
+        Tracer::record("fork", start, Tracer::nowMicros());
+    }
+    return pid;
+}
+
+#endif // SMASH_TRACE_ENABLED
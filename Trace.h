@@ -0,0 +1,84 @@
+#ifndef SMASH_TRACE_H_
+#define SMASH_TRACE_H_
+
+// ==================================================================================
+//                                Scoped Tracing
+// ==================================================================================
+// Build with 'make TRACE=1' to compile the tracer in; without it every macro below
+// expands to nothing (or to the plain syscall) and no tracing code is emitted.
+// At runtime, tracing is active only when SMASH_TRACE=<file> is set. Events are kept
+// in a per-process buffer and appended to <file> as Chrome trace JSON (array format,
+// open it in chrome://tracing or ui.perfetto.dev). Forked children drop the events
+// inherited from the parent and record their own fork->exec span.
+
+#ifdef SMASH_TRACE_ENABLED
+
+#include <sys/types.h>
+#include <cstdint>
+
+class Tracer {
+private:
+    static bool s_enabled;
+
+public:
+    // Reads SMASH_TRACE and opens the output file (called once from main)
+    static void init();
+
+    static bool isEnabled() { return s_enabled; }
+    static uint64_t nowMicros();
+
+    // Appends one complete ('X') event; 'name' must have static storage duration
+    static void record(const char *name, uint64_t startUs, uint64_t endUs);
+
+    // Writes buffered events to the trace file
+    static void flush();
+
+    // Child side of fork(): drops the parent's events and opens the fork->exec span
+    static void onForkChild();
+
+    // Closes the fork->exec span and flushes - exec() discards the buffer otherwise
+    static void beforeExec();
+};
+
+class TraceScope {
+private:
+    const char *m_name;
+    uint64_t m_start;
+public:
+    explicit TraceScope(const char *name)
+            : m_name(name), m_start(Tracer::isEnabled() ? Tracer::nowMicros() : 0) {}
+    ~TraceScope() {
+        if (m_start) Tracer::record(m_name, m_start, Tracer::nowMicros());
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    void operator=(const TraceScope &) = delete;
+};
+
+// fork() that times the call in the parent and starts the fork->exec span in the child
+pid_t tracedFork();
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#define TRACE_INIT()          Tracer::init()
+#define TRACE_SCOPE(name)     TraceScope TRACE_CONCAT(_traceScope_, __LINE__)(name)
+#define TRACE_FORK()          tracedFork()
+#define TRACE_BEFORE_EXEC()   Tracer::beforeExec()
+#define TRACE_FLUSH()         Tracer::flush()
+
+#else
+
+#define TRACE_INIT()
+#define TRACE_SCOPE(name)
+#define TRACE_FORK()          fork()
+#define TRACE_BEFORE_EXEC()
+#define TRACE_FLUSH()
+
+#endif // SMASH_TRACE_ENABLED
+
+// Function-level spans; the scope closes itself, FUNC_EXIT() is kept for symmetry
+#define FUNC_ENTRY()  TRACE_SCOPE(__func__);
+#define FUNC_EXIT()
+
+#endif //SMASH_TRACE_H_
@@ -0,0 +1,67 @@
+//
+// Created by Nikita Matrosov on 08/12/2025.
+//
+// smash-jobs: prints the job table a smash process publishes with SMASH_JOBS_SHM.
+// Usage: smash-jobs <table file> [interval-ms]
+//
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include "JobTableShm.h"
+
+static void printSnapshot(const ShmJobTable *table) {
+    ShmJobRecord records[SHM_JOBS_CAPACITY];
+    uint32_t count = readJobTableSnapshot(table, records);
+    time_t now = time(nullptr);
+
+    printf("smash pid %d: %u job(s)\n", table->shellPid, count);
+    for (uint32_t i = 0; i < count; ++i) {
+        const ShmJobRecord &r = records[i];
+        printf("[%d] %d %s %lds %s\n", r.jobId, r.pid,
+               r.state == SHM_JOB_STOPPED ? "stopped" : "running",
+               (long) (now - r.startTime), r.command);
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "usage: %s <table file> [interval-ms]\n", argv[0]);
+        return 2;
+    }
+
+    int fd = open(argv[1], O_RDONLY);
+    if (fd == -1) {
+        perror("smash-jobs: open failed");
+        return 1;
+    }
+    void *mem = mmap(nullptr, sizeof(ShmJobTable), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        perror("smash-jobs: mmap failed");
+        return 1;
+    }
+
+    const ShmJobTable *table = static_cast<const ShmJobTable *>(mem);
+    if (memcmp(table->magic, SHM_JOBS_MAGIC, sizeof(table->magic)) != 0 ||
+        table->version != SHM_JOBS_VERSION) {
+        fprintf(stderr, "smash-jobs: %s is not a smash job table\n", argv[1]);
+        return 1;
+    }
+
+    // One snapshot, or a stream of them every interval-ms
+    if (argc == 2) {
+        printSnapshot(table);
+        return 0;
+    }
+    long intervalMs = atol(argv[2]);
+    while (true) {
+        printSnapshot(table);
+        usleep(intervalMs * 1000);
+    }
+}
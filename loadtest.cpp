@@ -0,0 +1,111 @@
+//
+// Created by Nikita Matrosov on 26/12/2025.
+//
+// smash-load: load test for 'smash --serve'. For each session count, opens that
+// many concurrent sessions, sends each one N commands plus 'quit', and reports
+// commands per second until every session has closed.
+// Usage: smash-load <socket> [-n commands] [-c command] [sessions...]
+//
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+static double monotonicSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int connectTo(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) return -1;
+    if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) == -1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * One session: a writer thread sends the script while this thread drains the
+ * output, so neither side can block on a full socket buffer.
+ */
+static bool runSession(const char *path, const std::string &script) {
+    int fd = connectTo(path);
+    if (fd == -1) return false;
+
+    std::thread writer([fd, &script]() {
+        std::size_t done = 0;
+        while (done < script.size()) {
+            ssize_t n = send(fd, script.data() + done, script.size() - done, MSG_NOSIGNAL);
+            if (n <= 0) break;
+            done += n;
+        }
+        shutdown(fd, SHUT_WR);
+    });
+
+    char buf[65536];
+    while (read(fd, buf, sizeof(buf)) > 0) {}
+    writer.join();
+    close(fd);
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: smash-load <socket> [-n commands] [-c command] [sessions...]\n");
+        return 1;
+    }
+    const char *path = argv[1];
+    int commands = 1000;
+    std::string command = "true";
+    std::vector<int> counts;
+    for (int i = 2; i < argc; ++i) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) commands = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) command = argv[++i];
+        else counts.push_back(atoi(argv[i]));
+    }
+    if (counts.empty()) counts = {1, 2, 4, 8, 16, 32};
+
+    std::string script;
+    for (int i = 0; i < commands; ++i) script += command + "\n";
+    script += "quit\n";
+
+    printf("%8s %10s %12s %10s\n", "sessions", "commands", "commands/s", "wall");
+    for (int sessions : counts) {
+        if (sessions <= 0) continue;
+        std::vector<std::thread> clients;
+        std::vector<char> ok(sessions, 0);
+
+        double start = monotonicSeconds();
+        for (int s = 0; s < sessions; ++s) {
+            clients.push_back(std::thread([&, s]() { ok[s] = runSession(path, script) ? 1 : 0; }));
+        }
+        for (auto &client : clients) client.join();
+        double wall = monotonicSeconds() - start;
+
+        int failed = 0;
+        for (char c : ok) failed += (c == 0);
+        if (failed > 0) {
+            fprintf(stderr, "smash-load: %d of %d sessions could not connect to %s\n", failed, sessions, path);
+            return 1;
+        }
+        long total = (long) sessions * commands;
+        printf("%8d %10ld %12.0f %8.3fs\n", sessions, total, total / wall, wall);
+        fflush(stdout);
+    }
+    return 0;
+}
@@ -1,28 +1,59 @@
-
-#include <iostream>
+#include <unistd.h>
+#include <cerrno>
 #include <csignal>
+#include <cstring>
 #include "SmallShell.h"
 
 using namespace std;
 
+// The handler can interrupt cout mid-flush: its messages go straight to the fd, never
+// through the batched streams (write() is async-signal-safe, the stream buffers are not)
+static void writeOut(int fd, const char *text) {
+    size_t len = strlen(text);
+    while (len > 0) {
+        ssize_t n = write(fd, text, len);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) return;
+        text += n;
+        len -= (size_t) n;
+    }
+}
 
 void ctrlCHandler(int)
 {
-    cout << "smash: got ctrl-C" << endl;
+    int savedErrno = errno;
+    writeOut(STDOUT_FILENO, "smash: got ctrl-C\n");
 
     SmallShell &smash = SmallShell::getInstance();
+    smash.setInterrupted(true);
 
-    if (!smash.isFGrunning())
+    if (!smash.isFGrunning()) {
+        errno = savedErrno;
         return;
+    }
 
     pid_t fg_pid = smash.getCJPid();
 
     if (kill(fg_pid, SIGKILL) == -1) {
-        perror("smash error: kill failed");
+        writeOut(STDERR_FILENO, "smash error: kill failed\n");
+        errno = savedErrno;
         return;
     }
 
-    cout << "smash: process " << fg_pid << " was killed" << endl;
+    // The pid in decimal, without the stream's formatting
+    char digits[24];
+    char *p = digits + sizeof(digits);
+    *--p = '\0';
+    long value = (long) fg_pid;
+    do {
+        *--p = (char) ('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+
+    writeOut(STDOUT_FILENO, "smash: process ");
+    writeOut(STDOUT_FILENO, p);
+    writeOut(STDOUT_FILENO, " was killed\n");
 
     smash.updateSmashAfterCjFinished();
+    errno = savedErrno;
 }
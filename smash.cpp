@@ -1,13 +1,35 @@
 #include <iostream>
+#include <cstdlib>
+#include <cstring>
 #include <signal.h>
 #include "Commands.h"
 #include "signals.h"
 #include "SmallShell.h"
+#include "Trace.h"
+#include "Metrics.h"
+#include "JobTableShm.h"
+#include "JobJournal.h"
+#include "ResourceLimits.h"
+#include "RcFile.h"
+#include "Server.h"
+#include "Output.h"
+#include "TextScan.h"
 
-int main(int argc, char *argv[]) {
+// Startup work of a shell (or of a pre-forked server worker)
+static void prepareShell() {
+    ShellOutput::init();
+    JobTableShm::init();
+    JobJournal::init();
+    ResourceLimits::init();
+    TextInput::init();
     if (signal(SIGINT, ctrlCHandler) == SIG_ERR) {
         perror("smash error: failed to set ctrl-C handler");
     }
+    SmallShell::getInstance();
+    RcFile::load();
+}
+
+static void runShell() {
     SmallShell &smash = SmallShell::getInstance();
     while (true) {
         std::cout << smash.getPrompt();
@@ -17,6 +39,25 @@ int main(int argc, char *argv[]) {
         }
         smash.executeCommand(cmd_line.c_str());
     }
+}
+
+int main(int argc, char *argv[]) {
+    TRACE_INIT();
+
+    // smash --serve <socket> [--workers N]
+    if (argc >= 2 && strcmp(argv[1], "--serve") == 0) {
+        int workers = 4;
+        if (argc == 5 && strcmp(argv[3], "--workers") == 0) workers = atoi(argv[4]);
+        if ((argc != 3 && argc != 5) || workers <= 0) {
+            std::cerr << "usage: smash --serve <socket> [--workers N]" << std::endl;
+            return 1;
+        }
+        return Server::run(argv[2], workers, prepareShell, runShell);
+    }
+
+    Metrics::init();
+    prepareShell();
+    runShell();
 
     return 0;
-}
\ No newline at end of file
+}